@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT += core gui opengl xml svg widgets printsupport concurrent #webkit webkitwidgets
+QT += core gui network opengl xml svg widgets printsupport concurrent #webkit webkitwidgets
 
 TARGET = Clip
 TEMPLATE = app
@@ -59,6 +59,7 @@ QMAKE_LFLAGS_DEBUG += -pg
 
 SOURCES += main.cpp\
         ui/clip.cpp \
+    batch/batchprocessor.cpp \
     config/colorbutton.cpp \
     config/colorconfigitem.cpp \
     config/configstore.cpp \
@@ -77,14 +78,19 @@ SOURCES += main.cpp\
     image/brukerprovider.cpp \
     image/dataprovider.cpp \
     image/dataproviderfactory.cpp \
+    image/framecache.cpp \
     image/datascaler.cpp \
     image/datascalerfactory.cpp \
     image/imagedatastore.cpp \
+    image/imagepyramid.cpp \
     image/laueimage.cpp \
     image/mwdataprovider.cpp \
     image/qimagedataprovider.cpp \
     image/simplemonochromscaler.cpp \
     image/simplergbscaler.cpp \
+    image/tiffdataprovider.cpp \
+    image/tiledimagestore.cpp \
+    image/watcheddirectoryprovider.cpp \
     image/xyzdataprovider.cpp \
     indexing/candidategenerator.cpp \
     indexing/indexer.cpp \
@@ -98,16 +104,21 @@ SOURCES += main.cpp\
     refinement/fitparametertreeitem.cpp \
     refinement/neldermead.cpp \
     refinement/neldermead_worker.cpp \
+    server/queryserver.cpp \
     tools/abstractmarkeritem.cpp \
+    tools/abstractprojectormarkeritem.cpp \
+    tools/autosaver.cpp \
     tools/circleitem.cpp \
     tools/colortextitem.cpp \
     tools/combolineedit.cpp \
     tools/cropmarker.cpp \
     tools/diagramgv.cpp \
     tools/histogramitem.cpp \
+    tools/hkllabelitem.cpp \
     tools/indexparser.cpp \
     tools/itemstore.cpp \
     tools/mat3D.cpp \
+    tools/memoryaccounting.cpp \
     tools/numberedit.cpp \
     tools/objectstore.cpp \
     tools/optimalrotation.cpp \
@@ -117,9 +128,14 @@ SOURCES += main.cpp\
     tools/rulermodel.cpp \
     tools/spotindicatorgraphicsitem.cpp \
     tools/spotitem.cpp \
+    tools/startuptiming.cpp \
     tools/tools.cpp \
+    tools/trace.cpp \
+    tools/guitools.cpp \
+    tools/updatescheduler.cpp \
     tools/vec3D.cpp \
 #    tools/webkittextobject.cpp \
+    tools/workspacefile.cpp \
     tools/xmllistiterators.cpp \
     tools/xmltools.cpp \
     tools/zipiterator.cpp \
@@ -132,6 +148,7 @@ SOURCES += main.cpp\
     ui/imagetoolbox.cpp \
     ui/indexdisplay.cpp \
     ui/laueplanecfg.cpp \
+    ui/memorydisplay.cpp \
     ui/mouseinfodisplay.cpp \
 #    ui/printdialog.cpp \
     ui/projectiongraphicsview.cpp \
@@ -145,6 +162,7 @@ SOURCES += main.cpp\
     ui/monoscalercfg.cpp
 
 HEADERS  += ui/clip.h \
+    batch/batchprocessor.h \
     config/colorbutton.h \
     config/colorconfigitem.h \
     config/configstore.h \
@@ -162,14 +180,19 @@ HEADERS  += ui/clip.h \
     image/brukerprovider.h \
     image/dataprovider.h \
     image/dataproviderfactory.h \
+    image/framecache.h \
     image/datascaler.h \
     image/datascalerfactory.h \
     image/imagedatastore.h \
+    image/imagepyramid.h \
     image/laueimage.h \
     image/mwdataprovider.h \
     image/qimagedataprovider.h \
     image/simplemonochromscaler.h \
     image/simplergbscaler.h \
+    image/tiffdataprovider.h \
+    image/tiledimagestore.h \
+    image/watcheddirectoryprovider.h \
     image/xyzdataprovider.h \
     indexing/candidategenerator.h \
     indexing/indexer.h \
@@ -183,7 +206,9 @@ HEADERS  += ui/clip.h \
     refinement/fitparametertreeitem.h \
     refinement/neldermead.h \
     refinement/neldermead_worker.h \
+    server/queryserver.h \
     tools/abstractmarkeritem.h \
+    tools/autosaver.h \
     tools/circleitem.h \
     tools/colortextitem.h \
     tools/combolineedit.h \
@@ -191,10 +216,12 @@ HEADERS  += ui/clip.h \
     tools/debug.h \
     tools/diagramgv.h \
     tools/histogramitem.h \
+    tools/hkllabelitem.h \
     tools/indexparser.h \
     tools/init3D.h \
     tools/itemstore.h \
     tools/mat3D.h \
+    tools/memoryaccounting.h \
     tools/mousepositioninfo.h \
     tools/numberedit.h \
     tools/objectstore.h \
@@ -205,9 +232,14 @@ HEADERS  += ui/clip.h \
     tools/rulermodel.h \
     tools/spotindicatorgraphicsitem.h \
     tools/spotitem.h \
+    tools/startuptiming.h \
     tools/tools.h \
+    tools/trace.h \
+    tools/guitools.h \
+    tools/updatescheduler.h \
     tools/vec3D.h \
 #    tools/webkittextobject.h \
+    tools/workspacefile.h \
     tools/xmllistiterators.h \
     tools/xmltools.h \
     tools/zipiterator.h \
@@ -220,6 +252,7 @@ HEADERS  += ui/clip.h \
     ui/imagetoolbox.h \
     ui/indexdisplay.h \
     ui/laueplanecfg.h \
+    ui/memorydisplay.h \
     ui/mouseinfodisplay.h \
 #    ui/printdialog.h \
     ui/projectiongraphicsview.h \
@@ -242,6 +275,7 @@ FORMS    += ui/clip.ui \
     ui/imagetoolbox.ui \
     ui/indexdisplay.ui \
     ui/laueplanecfg.ui \
+    ui/memorydisplay.ui \
     ui/mouseinfodisplay.ui \
 #    ui/printdialog.ui \
     ui/projectionplane.ui \
@@ -0,0 +1,623 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "batch/batchprocessor.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QDomDocument>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QColor>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "core/crystal.h"
+#include "core/projector.h"
+#include "core/projectorfactory.h"
+#include "core/spacegroup.h"
+#include "indexing/indexer.h"
+#include "indexing/solution.h"
+#include "refinement/neldermead.h"
+#include "refinement/fitparameter.h"
+#include "image/dataprovider.h"
+#include "image/dataproviderfactory.h"
+#include "image/imagedatastore.h"
+#include "image/laueimage.h"
+#include "image/tiledimagestore.h"
+#include "config/configstore.h"
+#include "tools/threadrunner.h"
+#include "tools/updatescheduler.h"
+#include "tools/workspacefile.h"
+
+class BatchJob: public QRunnable {
+public:
+  BatchJob(BatchProcessor* _processor, const QString& _filename): processor(_processor), filename(_filename) {}
+  virtual void run() {
+    BatchProcessor::Result r = processor->process(filename);
+    processor->writeResult(r);
+  }
+private:
+  BatchProcessor* processor;
+  QString filename;
+};
+
+BatchProcessor::Options::Options():
+    workspaceFile(),
+    cellFile(),
+    outputFile(),
+    csv(false),
+    jobs(QThread::idealThreadCount()),
+    maxIndex(10),
+    maxAngularDeviation(3.0),
+    maxIndexDeviation(10.0),
+    timeLimit(60.0),
+    maxSpots(30),
+    spotThreshold(5.0),
+    fitCell(false)
+{
+}
+
+BatchProcessor::Result::Result():
+    file(),
+    error(),
+    markers(0),
+    solutions(0),
+    orientation(),
+    eulerAngles(),
+    cell(),
+    indexDeviation(-1.0),
+    indexRMS(-1.0),
+    fitScore(-1.0),
+    loadTime(0),
+    spotTime(0),
+    indexTime(0),
+    fitTime(0),
+    totalTime(0)
+{
+}
+
+BatchProcessor::BatchProcessor():
+    options(),
+    workspaceTemplate(),
+    cellTemplate(),
+    outputMutex(),
+    outputFile(),
+    output(),
+    resultsWritten(0),
+    failures(0)
+{
+}
+
+BatchProcessor::~BatchProcessor() {
+}
+
+bool BatchProcessor::isBatchCall(int argc, char* argv[]) {
+  for (int i=1; i<argc; i++)
+    if (std::strcmp(argv[i], "--batch")==0) return true;
+  return false;
+}
+
+bool BatchProcessor::parseArguments(const QStringList& arguments, QStringList& inputs) {
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Indexes and refines Laue images and workspaces without user interaction.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("inputs", "Workspaces (*.cws, *.cwb), images or directories containing them.", "inputs...");
+  QCommandLineOption batchOption("batch", "Run without user interface.");
+  QCommandLineOption workspaceOption("workspace", "Workspace with the projector geometry used for images.", "file");
+  QCommandLineOption cellOption("cell", "Cell file (*.cell), overrides the cell of the workspaces.", "file");
+  QCommandLineOption outputOption("output", "Write the results to file instead of standard output.", "file");
+  QCommandLineOption formatOption("format", "Output format, json or csv.", "format", "json");
+  QCommandLineOption jobsOption("jobs", "Number of inputs processed in parallel.", "n", QString::number(options.jobs));
+  QCommandLineOption maxIndexOption("max-index", "Largest index searched by the indexer.", "n", QString::number(options.maxIndex));
+  QCommandLineOption angularOption("angular-deviation", "Maximal angular deviation in degrees.", "deg", QString::number(options.maxAngularDeviation));
+  QCommandLineOption indexDevOption("index-deviation", "Maximal index deviation in percent.", "percent", QString::number(options.maxIndexDeviation));
+  QCommandLineOption timeOption("time-limit", "Time limit of the indexer per input in seconds, 0 for none.", "s", QString::number(options.timeLimit));
+  QCommandLineOption spotsOption("spots", "Number of spots searched in images without markers.", "n", QString::number(options.maxSpots));
+  QCommandLineOption thresholdOption("spot-threshold", "Spot threshold in standard deviations of the background.", "sigma", QString::number(options.spotThreshold));
+  QCommandLineOption fitCellOption("fit-cell", "Refine the cell in addition to the orientation.");
+  // Handled by StartupTiming::init() for all modes, accepted here as well
+  QCommandLineOption startupTimingOption("startup-timing", "Print the duration of the startup phases.");
+  startupTimingOption.setFlags(QCommandLineOption::HiddenFromHelp);
+  parser.addOptions(QList<QCommandLineOption>() << batchOption << workspaceOption << cellOption << outputOption << formatOption
+                    << jobsOption << maxIndexOption << angularOption << indexDevOption << timeOption << spotsOption
+                    << thresholdOption << fitCellOption << startupTimingOption);
+  if (!parser.parse(arguments)) {
+    QTextStream(stderr) << parser.errorText() << endl;
+    return false;
+  }
+  if (parser.isSet("help")) {
+    QTextStream(stdout) << parser.helpText();
+    return false;
+  }
+
+  bool ok = true;
+  bool b;
+  options.workspaceFile = parser.value(workspaceOption);
+  options.cellFile = parser.value(cellOption);
+  options.outputFile = parser.value(outputOption);
+  options.csv = (parser.value(formatOption).toLower()=="csv");
+  options.jobs = parser.value(jobsOption).toInt(&b); ok = ok && b && options.jobs>0;
+  options.maxIndex = parser.value(maxIndexOption).toInt(&b); ok = ok && b && options.maxIndex>0;
+  options.maxAngularDeviation = parser.value(angularOption).toDouble(&b); ok = ok && b;
+  options.maxIndexDeviation = parser.value(indexDevOption).toDouble(&b); ok = ok && b;
+  options.timeLimit = parser.value(timeOption).toDouble(&b); ok = ok && b;
+  options.maxSpots = parser.value(spotsOption).toInt(&b); ok = ok && b;
+  options.spotThreshold = parser.value(thresholdOption).toDouble(&b); ok = ok && b;
+  options.fitCell = parser.isSet(fitCellOption);
+  if (!ok) {
+    QTextStream(stderr) << "Invalid numeric option" << endl;
+    return false;
+  }
+  QString format = parser.value(formatOption).toLower();
+  if (format!="json" && format!="csv") {
+    QTextStream(stderr) << "Unknown output format " << format << endl;
+    return false;
+  }
+  inputs = parser.positionalArguments();
+  return true;
+}
+
+QStringList BatchProcessor::expandInputs(const QStringList& inputs) {
+  QStringList filters;
+  filters << "*.cws" << "*.cwb";
+  foreach (QString suffix, DataProviderFactory::getInstance().registeredImageFormats())
+    filters << "*."+suffix;
+
+  QStringList files;
+  foreach (QString input, inputs) {
+    QFileInfo info(input);
+    if (info.isDir()) {
+      QDir dir(input);
+      foreach (QString f, dir.entryList(filters, QDir::Files|QDir::Readable, QDir::Name))
+        files << dir.filePath(f);
+    } else {
+      files << input;
+    }
+  }
+  return files;
+}
+
+int BatchProcessor::run(const QStringList& arguments) {
+  QStringList inputs;
+  if (!parseArguments(arguments, inputs)) return 1;
+
+  if (!options.workspaceFile.isEmpty()) {
+    QFile f(options.workspaceFile);
+    if (!f.open(QIODevice::ReadOnly)) {
+      QTextStream(stderr) << "Could not read workspace " << options.workspaceFile << endl;
+      return 1;
+    }
+    workspaceTemplate = f.readAll();
+  }
+  if (!options.cellFile.isEmpty()) {
+    QFile f(options.cellFile);
+    if (!f.open(QIODevice::ReadOnly)) {
+      QTextStream(stderr) << "Could not read cell " << options.cellFile << endl;
+      return 1;
+    }
+    cellTemplate = f.readAll();
+  }
+
+  QStringList files = expandInputs(inputs);
+  if (files.isEmpty()) {
+    QTextStream(stderr) << "No inputs" << endl;
+    return 1;
+  }
+
+  if (options.outputFile.isEmpty()) {
+    outputFile.open(stdout, QIODevice::WriteOnly);
+  } else {
+    outputFile.setFileName(options.outputFile);
+    if (!outputFile.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+      QTextStream(stderr) << "Could not write " << options.outputFile << endl;
+      return 1;
+    }
+  }
+  output.setDevice(&outputFile);
+
+  // Shared instances are created here, not concurrently by the jobs
+  ConfigStore::getInstance();
+  UpdateScheduler::getInstance();
+  ProjectorFactory::getInstance();
+
+  // The jobs share the cores, instead of each starting a worker per core
+  ThreadRunner::setMaxThreadCount(std::max(1, QThread::idealThreadCount()/options.jobs));
+
+  writeHeader();
+  // Every job holds at most one image, so the memory is bounded by the job count
+  QThreadPool pool;
+  pool.setMaxThreadCount(options.jobs);
+  foreach (QString f, files)
+    pool.start(new BatchJob(this, f));
+  pool.waitForDone();
+  writeFooter();
+
+  output.flush();
+  outputFile.close();
+  return (failures>0) ? 2 : 0;
+}
+
+BatchProcessor::Result BatchProcessor::process(const QString& filename) {
+  QElapsedTimer timer;
+  timer.start();
+  Result r;
+  r.file = filename;
+
+  Crystal* crystal = new Crystal();
+  QList<Projector*> projectors;
+  if (!runPipeline(filename, crystal, projectors, r) && r.error.isEmpty())
+    r.error = "Failed";
+  qDeleteAll(projectors);
+  delete crystal;
+
+  r.totalTime = timer.elapsed();
+  return r;
+}
+
+bool BatchProcessor::runPipeline(const QString& filename, Crystal* crystal, QList<Projector*>& projectors, Result& r) {
+  QElapsedTimer timer;
+  timer.start();
+
+  bool isWorkspace = WorkspaceFile::isWorkspaceFile(filename);
+  QByteArray workspace = workspaceTemplate;
+  if (isWorkspace) {
+    QFile f(filename);
+    if (!f.open(QIODevice::ReadOnly)) {
+      r.error = "Could not read workspace";
+      return false;
+    }
+    workspace = f.readAll();
+  }
+
+  QString imageFile;
+  if (!workspace.isEmpty()) {
+    if (!loadWorkspace(workspace, crystal, projectors, imageFile)) {
+      r.error = "Invalid workspace";
+      return false;
+    }
+  }
+  if (projectors.isEmpty()) {
+    Projector* p = ProjectorFactory::getInstance().getProjector("LauePlaneProjector");
+    if (!p) return false;
+    projectors << p;
+    p->connectToCrystal(crystal);
+  }
+  if (!isWorkspace) {
+    imageFile = filename;
+    // markers of the template belong to another frame
+    foreach (Projector* p, projectors) {
+      p->spotMarkers().clear();
+      p->zoneMarkers().clear();
+    }
+  }
+  if (!cellTemplate.isEmpty()) {
+    QDomDocument doc;
+    if (doc.setContent(cellTemplate)) crystal->loadFromXML(doc.documentElement());
+  }
+  foreach (Projector* p, projectors)
+    p->enableProjection(false);
+  r.loadTime = timer.restart();
+
+  if (crystal->getMarkers().isEmpty()) {
+    if (imageFile.isEmpty()) {
+      r.error = "No markers and no image";
+      return false;
+    }
+    ImageDataStore store;
+    DataProvider* dp = DataProviderFactory::getInstance().loadImage(imageFile, &store);
+    if (!dp) {
+      r.error = "Could not load image";
+      return false;
+    }
+    r.loadTime += timer.restart();
+    Projector* p = projectors.first();
+    foreach (QPointF s, findSpots(dp, options.maxSpots, options.spotThreshold))
+      p->addSpotMarker(p->img2det.map(s));
+    delete dp;
+    r.spotTime = timer.restart();
+  }
+
+  r.markers = crystal->getMarkers().size();
+  if (r.markers<2) {
+    r.error = "Less than two markers";
+    return false;
+  }
+
+  indexMarkers(crystal, r);
+  r.indexTime = timer.restart();
+  if (r.solutions==0) {
+    r.error = "No solution";
+    return false;
+  }
+
+  if (options.fitCell) {
+    foreach (FitParameter* p, crystal->allParameters())
+      if (p->isChangeable()) p->setEnabled(true);
+  }
+  NelderMead fitter(crystal);
+  r.fitScore = fitter.fit();
+  r.fitTime = timer.restart();
+
+  r.orientation = crystal->getRotationMatrix();
+  r.eulerAngles = crystal->calcEulerAngles(true);
+  r.cell = crystal->getCell();
+  return true;
+}
+
+bool BatchProcessor::loadWorkspace(const QByteArray& content, Crystal* crystal, QList<Projector*>& projectors, QString& imageFile) {
+  WorkspaceFile workspace;
+  if (!workspace.read(content) || workspace.connections().isEmpty()) return false;
+  WorkspaceFile::Connection connection = workspace.connections().first();
+  if (!crystal->loadFromXML(connection.crystal.element())) return false;
+
+  foreach (WorkspaceFile::Section projector, connection.projectors) {
+    QDomElement e = projector.element();
+    Projector* p = ProjectorFactory::getInstance().getProjector(e.attribute("projectortype"));
+    if (!p) continue;
+    // The image is loaded on demand, projectors would open it asynchronously
+    QDomNodeList images = e.elementsByTagName(XML_LaueImage_element);
+    QList<QDomNode> imageNodes;
+    for (int i=0; i<images.size(); i++)
+      imageNodes << images.at(i);
+    foreach (QDomNode n, imageNodes) {
+      if (imageFile.isEmpty()) imageFile = n.toElement().attribute(XML_LaueImage_element_fn);
+      n.parentNode().removeChild(n);
+    }
+    p->loadFromXML(e);
+    p->connectToCrystal(crystal);
+    projectors << p;
+  }
+  return true;
+}
+
+void BatchProcessor::indexMarkers(Crystal* crystal, Result& r) {
+  Indexer indexer(crystal->getMarkers(),
+                  crystal->getRealOrientationMatrix(),
+                  crystal->getReziprocalOrientationMatrix(),
+                  M_PI/180.0*options.maxAngularDeviation,
+                  0.01*options.maxIndexDeviation,
+                  options.maxIndex,
+                  crystal->getSpacegroup()->getLauegroup(),
+                  nullptr);
+  BatchIndexLimit limit(&indexer, options.maxIndex, options.timeLimit);
+  QObject::connect(&indexer, SIGNAL(nextMajorIndex(int)), &limit, SLOT(checkMajorIndex(int)), Qt::DirectConnection);
+  QObject::connect(&indexer, SIGNAL(progressInfo(int)), &limit, SLOT(checkTime()), Qt::DirectConnection);
+  // Inputs are processed in parallel, so each indexer runs in one thread
+  indexer.run();
+
+  QList<Solution> solutions = indexer.solutions();
+  r.solutions = solutions.size();
+  if (solutions.isEmpty()) return;
+  int best = 0;
+  for (int i=1; i<solutions.size(); i++)
+    if (solutions.at(i).hklDeviationSqSum()<solutions.at(best).hklDeviationSqSum()) best = i;
+  r.indexDeviation = 100.0*solutions.at(best).hklDeviationSqSum();
+  r.indexRMS = solutions.at(best).allIndexRMS();
+  crystal->setRotation(solutions.at(best).bestRotation);
+}
+
+static void convertRow(const uchar* src, float* dst, int n, DataProvider::Format format) {
+  for (int i=0; i<n; i++) {
+    switch (format) {
+    case DataProvider::RGB8Bit: dst[i] = qGray(reinterpret_cast<const QRgb*>(src)[i]); break;
+    case DataProvider::Float32: dst[i] = reinterpret_cast<const float*>(src)[i]; break;
+    case DataProvider::Float64: dst[i] = reinterpret_cast<const double*>(src)[i]; break;
+    case DataProvider::UInt8: dst[i] = src[i]; break;
+    case DataProvider::UInt16: dst[i] = reinterpret_cast<const quint16*>(src)[i]; break;
+    case DataProvider::UInt32: dst[i] = reinterpret_cast<const quint32*>(src)[i]; break;
+    case DataProvider::Int16: dst[i] = reinterpret_cast<const qint16*>(src)[i]; break;
+    case DataProvider::Int32: dst[i] = reinterpret_cast<const qint32*>(src)[i]; break;
+    }
+  }
+}
+
+QList<QPointF> BatchProcessor::findSpots(DataProvider* dp, int maxSpots, double threshold) {
+  QList<QPointF> spots;
+  QSize size = dp->size();
+  TiledImageStore* store = dp->tiles();
+  if (size.isEmpty() || !store || !store->isValid() || maxSpots<=0) return spots;
+
+  // Sum into bins, large detectors are searched at about 512x512
+  int bin = std::max(1, (std::max(size.width(), size.height())+511)/512);
+  int bw = (size.width()+bin-1)/bin;
+  int bh = (size.height()+bin-1)/bin;
+  QVector<double> binned(bw*bh, 0.0);
+  QByteArray row(size.width()*store->bytesPerPixel(), 0);
+  QVector<float> values(size.width());
+  for (int y=0; y<size.height(); y++) {
+    store->readRow(y, row.data());
+    convertRow(reinterpret_cast<const uchar*>(row.constData()), values.data(), size.width(), dp->format());
+    double* dst = binned.data()+(y/bin)*bw;
+    for (int x=0; x<size.width(); x++)
+      dst[x/bin] += values[x];
+  }
+
+  // Subtract the mean of the surrounding box as local background
+  const int r = 4;
+  const int iw = bw+1;
+  QVector<double> integral(iw*(bh+1), 0.0);
+  for (int y=0; y<bh; y++)
+    for (int x=0; x<bw; x++)
+      integral[(y+1)*iw+x+1] = binned[y*bw+x]+integral[y*iw+x+1]+integral[(y+1)*iw+x]-integral[y*iw+x];
+
+  QVector<double> signal(bw*bh);
+  double sum = 0.0;
+  double sqSum = 0.0;
+  for (int y=0; y<bh; y++) {
+    int y0 = std::max(0, y-r);
+    int y1 = std::min(bh, y+r+1);
+    for (int x=0; x<bw; x++) {
+      int x0 = std::max(0, x-r);
+      int x1 = std::min(bw, x+r+1);
+      double box = integral[y1*iw+x1]-integral[y0*iw+x1]-integral[y1*iw+x0]+integral[y0*iw+x0];
+      double s = binned[y*bw+x]-box/((x1-x0)*(y1-y0));
+      signal[y*bw+x] = s;
+      sum += s;
+      sqSum += s*s;
+    }
+  }
+  double n = bw*bh;
+  double mean = sum/n;
+  double limit = mean+threshold*std::sqrt(std::max(0.0, sqSum/n-mean*mean));
+
+  // Local maxima in a 5x5 neighbourhood, ties go to the first pixel
+  QList<QPair<double, int> > peaks;
+  for (int y=0; y<bh; y++) {
+    for (int x=0; x<bw; x++) {
+      int idx = y*bw+x;
+      double v = signal[idx];
+      if (v<=limit) continue;
+      bool isMax = true;
+      for (int dy=std::max(0, y-2); isMax && dy<=std::min(bh-1, y+2); dy++) {
+        for (int dx=std::max(0, x-2); isMax && dx<=std::min(bw-1, x+2); dx++) {
+          int o = dy*bw+dx;
+          if (o!=idx && (signal[o]>v || (signal[o]==v && o<idx))) isMax = false;
+        }
+      }
+      if (isMax) peaks << qMakePair(-v, idx);
+    }
+  }
+  std::sort(peaks.begin(), peaks.end());
+
+  for (int i=0; i<std::min(maxSpots, peaks.size()); i++) {
+    int px = peaks[i].second%bw;
+    int py = peaks[i].second/bw;
+    // Centroid of the positive signal in the 3x3 neighbourhood
+    double w = 0.0, cx = 0.0, cy = 0.0;
+    for (int y=std::max(0, py-1); y<=std::min(bh-1, py+1); y++) {
+      for (int x=std::max(0, px-1); x<=std::min(bw-1, px+1); x++) {
+        double s = std::max(0.0, signal[y*bw+x]);
+        w += s;
+        cx += s*(x+0.5);
+        cy += s*(y+0.5);
+      }
+    }
+    if (w<=0.0) continue;
+    double x = bin*cx/w;
+    double y = bin*cy/w;
+    // Image coordinates have their origin in the bottom left corner
+    spots << QPointF(x/size.width(), 1.0-y/size.height());
+  }
+  return spots;
+}
+
+static QString csvQuote(QString s) {
+  return "\""+s.replace("\"", "\"\"")+"\"";
+}
+
+void BatchProcessor::writeHeader() {
+  if (options.csv) {
+    output << "file,status,markers,solutions,omega,chi,phi,a,b,c,alpha,beta,gamma,"
+           << "r11,r12,r13,r21,r22,r23,r31,r32,r33,"
+           << "index_deviation,index_rms,fit_score,load_ms,spot_ms,index_ms,fit_ms,total_ms,error\n";
+  } else {
+    output << "[\n";
+  }
+  output.flush();
+}
+
+void BatchProcessor::writeResult(const Result& r) {
+  QMutexLocker lock(&outputMutex);
+  bool ok = r.error.isEmpty();
+  if (!ok) failures++;
+  if (options.csv) {
+    QStringList fields;
+    fields << csvQuote(r.file) << (ok ? "ok" : "failed") << QString::number(r.markers) << QString::number(r.solutions);
+    for (int i=0; i<3; i++) fields << (ok ? QString::number(r.eulerAngles.value(i), 'g', 10) : QString());
+    for (int i=0; i<6; i++) fields << (ok ? QString::number(r.cell.value(i), 'g', 10) : QString());
+    for (int i=0; i<3; i++)
+      for (int j=0; j<3; j++)
+        fields << (ok ? QString::number(r.orientation(i, j), 'g', 12) : QString());
+    fields << QString::number(r.indexDeviation) << QString::number(r.indexRMS) << QString::number(r.fitScore);
+    fields << QString::number(r.loadTime) << QString::number(r.spotTime) << QString::number(r.indexTime);
+    fields << QString::number(r.fitTime) << QString::number(r.totalTime) << csvQuote(r.error);
+    output << fields.join(",") << "\n";
+  } else {
+    QJsonObject o;
+    o.insert("file", r.file);
+    o.insert("status", ok ? "ok" : "failed");
+    if (!ok) o.insert("error", r.error);
+    o.insert("markers", r.markers);
+    o.insert("solutions", r.solutions);
+    if (ok) {
+      QJsonArray euler;
+      foreach (double d, r.eulerAngles) euler << d;
+      o.insert("euler", euler);
+      QJsonArray cell;
+      foreach (double d, r.cell) cell << d;
+      o.insert("cell", cell);
+      QJsonArray rotation;
+      for (int i=0; i<3; i++) {
+        QJsonArray line;
+        for (int j=0; j<3; j++) line << r.orientation(i, j);
+        rotation << line;
+      }
+      o.insert("orientation", rotation);
+      o.insert("indexDeviation", r.indexDeviation);
+      o.insert("indexRMS", r.indexRMS);
+      o.insert("fitScore", r.fitScore);
+    }
+    QJsonObject t;
+    t.insert("load", r.loadTime);
+    t.insert("spots", r.spotTime);
+    t.insert("index", r.indexTime);
+    t.insert("fit", r.fitTime);
+    t.insert("total", r.totalTime);
+    o.insert("timing_ms", t);
+    if (resultsWritten>0) output << ",\n";
+    output << QString::fromUtf8(QJsonDocument(o).toJson(QJsonDocument::Compact));
+  }
+  resultsWritten++;
+  // Results of long runs survive an interruption
+  output.flush();
+}
+
+void BatchProcessor::writeFooter() {
+  if (!options.csv) output << "\n]\n";
+}
+
+BatchIndexLimit::BatchIndexLimit(Indexer* _indexer, int _maxIndex, double _timeLimit):
+    QObject(),
+    indexer(_indexer),
+    maxIndex(_maxIndex),
+    timeLimit(static_cast<qint64>(1000.0*_timeLimit)),
+    timer()
+{
+  timer.start();
+}
+
+void BatchIndexLimit::checkMajorIndex(int n) {
+  if (n>maxIndex) indexer->stop();
+}
+
+void BatchIndexLimit::checkTime() {
+  if (timeLimit>0 && timer.elapsed()>timeLimit) indexer->stop();
+}
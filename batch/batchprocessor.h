@@ -0,0 +1,138 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QPointF>
+#include <QMutex>
+#include <QFile>
+#include <QTextStream>
+#include <QElapsedTimer>
+
+#include "tools/mat3D.h"
+
+class Crystal;
+class Projector;
+class DataProvider;
+class Indexer;
+
+// Headless index and refine pipeline, started with "Clip --batch". Every
+// input is either a workspace or an image. Images use the geometry of the
+// --workspace template and the cell of --cell. If an input has no markers,
+// spots are searched in its image. The markers are indexed, the best
+// solution is refined and one result per input is written as JSON or CSV.
+class BatchProcessor {
+public:
+  struct Options {
+    Options();
+    QString workspaceFile;
+    QString cellFile;
+    QString outputFile;
+    bool csv;
+    int jobs;
+    int maxIndex;
+    double maxAngularDeviation;
+    double maxIndexDeviation;
+    double timeLimit;
+    int maxSpots;
+    double spotThreshold;
+    bool fitCell;
+  };
+
+  struct Result {
+    Result();
+    QString file;
+    QString error;
+    int markers;
+    int solutions;
+    Mat3D orientation;
+    QList<double> eulerAngles;
+    QList<double> cell;
+    double indexDeviation;
+    double indexRMS;
+    double fitScore;
+    qint64 loadTime;
+    qint64 spotTime;
+    qint64 indexTime;
+    qint64 fitTime;
+    qint64 totalTime;
+  };
+
+  BatchProcessor();
+  ~BatchProcessor();
+
+  static bool isBatchCall(int argc, char* argv[]);
+  // Returns the exit code
+  int run(const QStringList& arguments);
+
+  // Runs one input, safe to call from several threads
+  Result process(const QString& filename);
+
+  // Local maxima of the background corrected image in image coordinates
+  static QList<QPointF> findSpots(DataProvider* dp, int maxSpots, double threshold);
+private:
+  friend class BatchJob;
+  BatchProcessor(const BatchProcessor&);
+  BatchProcessor& operator=(const BatchProcessor&);
+
+  bool parseArguments(const QStringList& arguments, QStringList& inputs);
+  QStringList expandInputs(const QStringList& inputs);
+  bool loadWorkspace(const QByteArray& content, Crystal* crystal, QList<Projector*>& projectors, QString& imageFile);
+  bool runPipeline(const QString& filename, Crystal* crystal, QList<Projector*>& projectors, Result& r);
+  void indexMarkers(Crystal* crystal, Result& r);
+  void writeHeader();
+  void writeResult(const Result& r);
+  void writeFooter();
+
+  Options options;
+  QByteArray workspaceTemplate;
+  QByteArray cellTemplate;
+
+  QMutex outputMutex;
+  QFile outputFile;
+  QTextStream output;
+  int resultsWritten;
+  int failures;
+};
+
+// Stops an Indexer at the maximal index or after the time limit
+class BatchIndexLimit: public QObject {
+  Q_OBJECT
+public:
+  BatchIndexLimit(Indexer* indexer, int maxIndex, double timeLimit);
+public slots:
+  void checkMajorIndex(int);
+  void checkTime();
+private:
+  Indexer* indexer;
+  int maxIndex;
+  qint64 timeLimit;
+  QElapsedTimer timer;
+};
+
+#endif // BATCHPROCESSOR_H
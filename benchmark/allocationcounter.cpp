@@ -0,0 +1,129 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "benchmark/allocationcounter.h"
+
+#include <QtTest/QtTest>
+#include <cstdlib>
+#include <new>
+
+// Per thread, so allocations of ThreadRunner and QThreadPool workers are
+// not counted. Counting costs one TLS load while no AllocationCounter exists.
+static thread_local qint64 allocationCount = 0;
+static thread_local int activeCounters = 0;
+
+static inline void countAllocation() {
+  if (activeCounters>0)
+    allocationCount++;
+}
+
+#ifdef __GLIBC__
+// Replaces the C allocation functions of clipbench. QVector, QByteArray and
+// QString allocate with malloc and realloc, operator new ends up in malloc.
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t n, std::size_t size);
+void* __libc_realloc(void* p, std::size_t size);
+
+void* malloc(std::size_t size) noexcept {
+  countAllocation();
+  return __libc_malloc(size);
+}
+
+void* calloc(std::size_t n, std::size_t size) noexcept {
+  countAllocation();
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, std::size_t size) noexcept {
+  countAllocation();
+  return __libc_realloc(p, size);
+}
+}
+#else
+// Replaces the global allocation functions of clipbench
+static void* countedAlloc(std::size_t size) {
+  countAllocation();
+  return std::malloc(size ? size : 1);
+}
+
+void* operator new(std::size_t size) {
+  if (void* p = countedAlloc(size)) return p;
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+  if (void* p = countedAlloc(size)) return p;
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return countedAlloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return countedAlloc(size);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  std::free(p);
+}
+#endif
+
+static QMap<QString, double>& resultStore() {
+  static QMap<QString, double> store;
+  return store;
+}
+
+AllocationCounter::AllocationCounter():
+    start(0),
+    iterations(0)
+{
+  activeCounters++;
+  start = allocationCount;
+}
+
+AllocationCounter::~AllocationCounter() {
+  qint64 count = allocationCount-start;
+  activeCounters--;
+  if (iterations==0) return;
+  QString name = QTest::currentTestFunction();
+  if (QTest::currentDataTag()!=nullptr)
+    name += QString("/")+QTest::currentDataTag();
+  resultStore().insert(name, double(count)/iterations);
+}
+
+QMap<QString, double> AllocationCounter::results() {
+  return resultStore();
+}
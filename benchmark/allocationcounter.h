@@ -0,0 +1,52 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QString>
+#include <QMap>
+
+// Counts the heap allocations of the benchmark thread while a benchmark runs,
+// worker threads are not included. With glibc malloc, calloc and realloc are
+// counted, so the growth of Qt containers shows up, elsewhere only operator
+// new. Create one before QBENCHMARK and call iteration() in its body; the
+// destructor stores the allocations per iteration for the current test
+// function and data tag.
+class AllocationCounter {
+public:
+  AllocationCounter();
+  ~AllocationCounter();
+
+  void iteration() { iterations++; }
+
+  // Allocations per iteration, keyed like BenchmarkReport::Result::name
+  static QMap<QString, double> results();
+private:
+  AllocationCounter(const AllocationCounter&);
+  AllocationCounter& operator=(const AllocationCounter&);
+
+  qint64 start;
+  qint64 iterations;
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,278 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "benchmark/benchmarkreport.h"
+#include "benchmark/allocationcounter.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QXmlStreamReader>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonValue>
+#include <QTextStream>
+#include <QDateTime>
+#include <QSysInfo>
+#include <QMap>
+#include <algorithm>
+
+BenchmarkReport::BenchmarkReport():
+    jsonFile(),
+    baselineFile(),
+    budgetsFile(),
+    initBaseline(false),
+    tolerance(-1.0),
+    toleranceGiven(false),
+    allocationTolerance(-1.0),
+    budgets(),
+    testLog(),
+    benchmarkResults()
+{
+}
+
+QStringList BenchmarkReport::parseArguments(const QStringList& arguments) {
+  QStringList r;
+  bool hasOutput = false;
+  for (int i=0; i<arguments.size(); i++) {
+    QString a = arguments.at(i);
+    bool hasValue = i+1<arguments.size();
+    if (a=="--json" && hasValue) {
+      jsonFile = arguments.at(++i);
+    } else if (a=="--baseline" && hasValue) {
+      baselineFile = arguments.at(++i);
+    } else if (a=="--init-baseline") {
+      initBaseline = true;
+    } else if (a=="--tolerance" && hasValue) {
+      tolerance = 0.01*arguments.at(++i).toDouble();
+      toleranceGiven = true;
+    } else if (a=="--budgets" && hasValue) {
+      budgetsFile = arguments.at(++i);
+    } else {
+      if (a=="-o") hasOutput = true;
+      r << a;
+    }
+  }
+  if (r.isEmpty()) r << "clipbench";
+
+  // The results are read back from an additional xml log. Without an
+  // explicit -o, QtTest would stop printing to the console.
+  if (testLog.open()) {
+    testLog.close();
+    r << "-o" << testLog.fileName()+",xml";
+    if (!hasOutput) r << "-o" << "-,txt";
+  }
+  return r;
+}
+
+int BenchmarkReport::finish(int testResult) {
+  QTextStream err(stderr);
+  int failures = 0;
+  if (!budgetsFile.isEmpty() && !readBudgets(budgetsFile)) {
+    err << "Could not read budgets " << budgetsFile << endl;
+    failures++;
+  }
+  if (tolerance<0.0)
+    tolerance = 0.01*budgets.value("timeTolerance").toDouble(20.0);
+  if (allocationTolerance<0.0)
+    allocationTolerance = 0.01*budgets.value("allocationTolerance").toDouble(10.0);
+
+  bool reportRequested = !jsonFile.isEmpty() || !baselineFile.isEmpty() || !budgetsFile.isEmpty();
+  if (!readTestLog()) {
+    err << "Could not read the benchmark results" << endl;
+    return (testResult==0 && reportRequested) ? 1 : testResult;
+  }
+  if (!jsonFile.isEmpty() && !writeJson(jsonFile)) {
+    err << "Could not write " << jsonFile << endl;
+    failures++;
+  }
+  failures += checkLimits();
+  if (!baselineFile.isEmpty() && compareWithBaseline(baselineFile)!=0)
+    failures++;
+  if (testResult==0 && failures>0) testResult = 1;
+  return testResult;
+}
+
+bool BenchmarkReport::readTestLog() {
+  benchmarkResults.clear();
+  QFile f(testLog.fileName());
+  if (testLog.fileName().isEmpty() || !f.open(QIODevice::ReadOnly)) return false;
+
+  QMap<QString, double> allocations = AllocationCounter::results();
+  QXmlStreamReader xml(&f);
+  QString function;
+  while (!xml.atEnd()) {
+    xml.readNext();
+    if (!xml.isStartElement()) continue;
+    QXmlStreamAttributes a = xml.attributes();
+    if (xml.name()==QLatin1String("TestFunction")) {
+      function = a.value("name").toString();
+    } else if (xml.name()==QLatin1String("BenchmarkResult")) {
+      Result r;
+      QString tag = a.value("tag").toString();
+      r.name = tag.isEmpty() ? function : function+"/"+tag;
+      r.metric = a.value("metric").toString();
+      r.value = a.value("value").toDouble();
+      r.iterations = a.value("iterations").toInt();
+      r.allocations = allocations.value(r.name, -1.0);
+      benchmarkResults << r;
+    }
+  }
+  return !xml.hasError();
+}
+
+QJsonObject BenchmarkReport::toJson() const {
+  QJsonArray results;
+  foreach (const Result& r, benchmarkResults) {
+    QJsonObject o;
+    o["name"] = r.name;
+    o["metric"] = r.metric;
+    o["value"] = r.value;
+    o["iterations"] = r.iterations;
+    if (r.allocations>=0.0)
+      o["allocations"] = r.allocations;
+    results.append(o);
+  }
+  QJsonObject o;
+  o["qtVersion"] = QString(qVersion());
+  o["cpu"] = QSysInfo::currentCpuArchitecture();
+  o["host"] = QSysInfo::machineHostName();
+  o["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+  o["results"] = results;
+  return o;
+}
+
+bool BenchmarkReport::writeJson(const QString& filename) const {
+  QByteArray data = QJsonDocument(toJson()).toJson();
+  if (filename=="-") {
+    QTextStream(stdout) << data;
+    return true;
+  }
+  QDir().mkpath(QFileInfo(filename).absolutePath());
+  QFile f(filename);
+  if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+  return f.write(data)==data.size();
+}
+
+bool BenchmarkReport::readBudgets(const QString& filename) {
+  QFile f(filename);
+  if (!f.open(QIODevice::ReadOnly)) return false;
+  QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
+  if (!doc.isObject()) return false;
+  budgets = doc.object();
+  return true;
+}
+
+// Budget of a benchmark, or of its test function if there is none for the data tag
+QJsonObject BenchmarkReport::budget(const QString& name) const {
+  QJsonObject benchmarks = budgets.value("benchmarks").toObject();
+  if (benchmarks.contains(name))
+    return benchmarks.value(name).toObject();
+  return benchmarks.value(name.section('/', 0, 0)).toObject();
+}
+
+// Checks the absolute limits of the budgets, returns the number of violations
+int BenchmarkReport::checkLimits() const {
+  QTextStream out(stdout);
+  int violations = 0;
+  foreach (const Result& r, benchmarkResults) {
+    QJsonObject b = budget(r.name);
+    if (b.contains("maxAllocations") && r.allocations>b.value("maxAllocations").toDouble()) {
+      out << "  OVER BUDGET " << r.name << ": " << r.allocations << " allocations, budget " << b.value("maxAllocations").toDouble() << endl;
+      violations++;
+    }
+    if (b.contains("maxMilliseconds") && r.metric=="WalltimeMilliseconds" && r.value>b.value("maxMilliseconds").toDouble()) {
+      out << "  OVER BUDGET " << r.name << ": " << r.value << " ms, budget " << b.value("maxMilliseconds").toDouble() << endl;
+      violations++;
+    }
+  }
+  return violations;
+}
+
+// Prints a comparison table, returns the number of regressions or -1 if the
+// baseline could not be read
+int BenchmarkReport::compareWithBaseline(const QString& filename) const {
+  QTextStream err(stderr);
+  QTextStream out(stdout);
+  if (initBaseline && !QFile::exists(filename)) {
+    if (!writeJson(filename)) {
+      err << "Could not write baseline " << filename << endl;
+      return -1;
+    }
+    out << "Recorded baseline " << filename << endl;
+    return 0;
+  }
+  QFile f(filename);
+  if (!f.open(QIODevice::ReadOnly)) {
+    err << "Could not read baseline " << filename << endl;
+    return -1;
+  }
+  QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
+  if (!doc.isObject()) {
+    err << "Invalid baseline " << filename << endl;
+    return -1;
+  }
+  QMap<QString, QJsonObject> baseline;
+  foreach (QJsonValue v, doc.object().value("results").toArray())
+    baseline.insert(v.toObject().value("name").toString(), v.toObject());
+
+  out << "Comparison with " << filename << endl;
+  int regressions = 0;
+  foreach (const Result& r, benchmarkResults) {
+    if (!baseline.contains(r.name)) {
+      out << "  new         " << r.name << endl;
+      continue;
+    }
+    QJsonObject b = baseline.take(r.name);
+    if (b.value("metric").toString()!=r.metric) {
+      out << "  metric      " << r.name << ": " << b.value("metric").toString() << " -> " << r.metric << endl;
+      continue;
+    }
+    QJsonObject limits = budget(r.name);
+    double timeTolerance = toleranceGiven ? tolerance : 0.01*limits.value("timeTolerance").toDouble(100.0*tolerance);
+    double allocTolerance = 0.01*limits.value("allocationTolerance").toDouble(100.0*allocationTolerance);
+
+    double ref = b.value("value").toDouble();
+    double change = (ref>0.0) ? r.value/ref-1.0 : 0.0;
+    QString status = "  ok          ";
+    if (change>timeTolerance) {
+      status = "  REGRESSION  ";
+      regressions++;
+    } else if (change<-timeTolerance) {
+      status = "  faster      ";
+    }
+    out << status << r.name << ": " << ref << " -> " << r.value << " " << r.metric;
+    out << QString(" (%1%2%, tolerance %3%)").arg(change>=0.0 ? "+" : "").arg(100.0*change, 0, 'f', 1).arg(100.0*timeTolerance) << endl;
+
+    if (r.allocations>=0.0 && b.contains("allocations")) {
+      double refAllocations = b.value("allocations").toDouble();
+      if (r.allocations-refAllocations>allocTolerance*std::max(refAllocations, 1.0)) {
+        out << "  ALLOCATIONS " << r.name << ": " << refAllocations << " -> " << r.allocations << " per iteration" << endl;
+        regressions++;
+      }
+    }
+  }
+  foreach (QString name, baseline.keys())
+    out << "  missing     " << name << endl;
+  out << regressions << " regression(s)" << endl;
+  return regressions;
+}
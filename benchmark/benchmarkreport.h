@@ -0,0 +1,84 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef BENCHMARKREPORT_H
+#define BENCHMARKREPORT_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QJsonObject>
+#include <QTemporaryFile>
+
+// Collects the QBENCHMARK results of a test run as JSON and compares them
+// with a saved baseline. Takes these options off the QtTest command line:
+//   --json <file>        write the results, "-" for stdout
+//   --baseline <file>    compare with results written by --json
+//   --init-baseline      write the baseline if it does not exist yet
+//   --tolerance <pct>    allowed slowdown against the baseline, default 20,
+//                        takes precedence over the budgets
+//   --budgets <file>     per benchmark tolerances and limits, see
+//                        benchmark/budgets.json
+class BenchmarkReport {
+public:
+  struct Result {
+    QString name;
+    QString metric;
+    double value;
+    int iterations;
+    // Heap allocations per iteration, -1 if not counted
+    double allocations;
+  };
+
+  BenchmarkReport();
+
+  // Returns the arguments for QTest::qExec
+  QStringList parseArguments(const QStringList& arguments);
+  // Returns the exit code, testResult unless a benchmark regressed
+  int finish(int testResult);
+
+  QList<Result> results() const { return benchmarkResults; }
+private:
+  BenchmarkReport(const BenchmarkReport&);
+  BenchmarkReport& operator=(const BenchmarkReport&);
+
+  bool readTestLog();
+  QJsonObject toJson() const;
+  bool writeJson(const QString& filename) const;
+  int compareWithBaseline(const QString& filename) const;
+  bool readBudgets(const QString& filename);
+  QJsonObject budget(const QString& name) const;
+  int checkLimits() const;
+
+  QString jsonFile;
+  QString baselineFile;
+  QString budgetsFile;
+  bool initBaseline;
+  double tolerance;
+  bool toleranceGiven;
+  double allocationTolerance;
+  QJsonObject budgets;
+  QTemporaryFile testLog;
+  QList<Result> benchmarkResults;
+};
+
+#endif // BENCHMARKREPORT_H
@@ -0,0 +1,377 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include <QApplication>
+#include <QtTest/QtTest>
+#include <QDir>
+#include <QFileInfo>
+#include <QSignalSpy>
+#include <cmath>
+#include <algorithm>
+
+#include "benchmark/allocationcounter.h"
+#include "benchmark/benchmarkreport.h"
+#include "batch/batchprocessor.h"
+#include "config/configstore.h"
+#include "core/crystal.h"
+#include "core/projector.h"
+#include "core/projectorfactory.h"
+#include "core/reflection.h"
+#include "image/dataprovider.h"
+#include "image/dataproviderfactory.h"
+#include "image/datascaler.h"
+#include "image/datascalerfactory.h"
+#include "image/imagedatastore.h"
+#include "image/laueimage.h"
+#include "indexing/indexer.h"
+#include "indexing/solution.h"
+#include "refinement/fitparameter.h"
+#include "refinement/neldermead.h"
+#include "tools/autosaver.h"
+#include "ui/clip.h"
+
+#ifndef CLIP_TESTDATA_DIR
+#define CLIP_TESTDATA_DIR "testdata"
+#endif
+
+// Reproducible benchmarks: fixed cells, orientations and marker sets, and the
+// frames in testdata. Run with --json/--baseline, see BenchmarkReport. Each
+// benchmark also counts its allocations per iteration.
+class ClipBenchmark: public QObject {
+  Q_OBJECT
+public:
+  ClipBenchmark();
+private slots:
+  void initTestCase();
+  void cleanupTestCase();
+
+  void reflectionGeneration_data();
+  void reflectionGeneration();
+  void updateRotation_data();
+  void updateRotation();
+  void projection_data();
+  void projection();
+  void imageDecode_data();
+  void imageDecode();
+  void scalerRendering_data();
+  void scalerRendering();
+  void indexing_data();
+  void indexing();
+  void refinement();
+  void firstWindow();
+  void firstImage_data();
+  void firstImage();
+private:
+  void addCrystalColumns();
+  void setupCrystal(Crystal& c);
+  void addMarkers(Crystal& c, Projector* p, int n);
+  QString testdataDir() const;
+
+  Mat3D orientation;
+};
+
+ClipBenchmark::ClipBenchmark():
+    QObject(),
+    orientation(Mat3D(Vec3D(1, 2, 3).normalized(), 0.4))
+{
+}
+
+void ClipBenchmark::initTestCase() {
+  // Decoding has to hit the providers, not the cache of decoded frames
+  ConfigStore::getInstance()->setFrameCacheEnabled(false);
+}
+
+void ClipBenchmark::cleanupTestCase() {
+  ConfigStore::clearInstance();
+}
+
+QString ClipBenchmark::testdataDir() const {
+  QString dir = QString::fromLocal8Bit(qgetenv("CLIP_TESTDATA"));
+  return dir.isEmpty() ? QString(CLIP_TESTDATA_DIR) : dir;
+}
+
+void ClipBenchmark::addCrystalColumns() {
+  QTest::addColumn<QString>("spacegroup");
+  QTest::addColumn<QList<double> >("cell");
+
+  QTest::newRow("P1 small") << "P1" << (QList<double>() << 4.1 << 5.2 << 6.3 << 81.0 << 95.0 << 102.0);
+  QTest::newRow("P21/c") << "P21/c" << (QList<double>() << 7.5 << 9.1 << 11.8 << 90.0 << 104.0 << 90.0);
+  QTest::newRow("P212121") << "P212121" << (QList<double>() << 10.2 << 12.4 << 15.6 << 90.0 << 90.0 << 90.0);
+  QTest::newRow("P63/mmc") << "P63/mmc" << (QList<double>() << 5.8 << 5.8 << 10.4 << 90.0 << 90.0 << 120.0);
+  QTest::newRow("Fm-3m") << "Fm-3m" << (QList<double>() << 5.43 << 5.43 << 5.43 << 90.0 << 90.0 << 90.0);
+  QTest::newRow("P1 large") << "P1" << (QList<double>() << 18.3 << 22.6 << 27.9 << 84.0 << 97.0 << 106.0);
+}
+
+void ClipBenchmark::setupCrystal(Crystal& c) {
+  QFETCH(QString, spacegroup);
+  QFETCH(QList<double>, cell);
+  c.synchronUpdate(true);
+  QVERIFY(c.getSpacegroup()->setGroupSymbol(spacegroup));
+  c.setCell(cell);
+  c.setRotation(orientation);
+}
+
+void ClipBenchmark::reflectionGeneration_data() {
+  addCrystalColumns();
+}
+
+void ClipBenchmark::reflectionGeneration() {
+  Crystal c;
+  setupCrystal(c);
+  c.setWavevectors(0.0, 2.0*M_PI);
+  QVERIFY(c.reflectionCount()>0);
+  AllocationCounter allocations;
+  QBENCHMARK {
+    allocations.iteration();
+    c.generateReflections();
+  }
+}
+
+void ClipBenchmark::updateRotation_data() {
+  addCrystalColumns();
+}
+
+void ClipBenchmark::updateRotation() {
+  Crystal c;
+  setupCrystal(c);
+  c.setWavevectors(0.0, 2.0*M_PI);
+  Vec3D axis(Vec3D(3, -1, 2).normalized());
+  AllocationCounter allocations;
+  QBENCHMARK {
+    allocations.iteration();
+    c.addRotation(axis, 0.01);
+    c.getReflectionList();
+  }
+}
+
+void ClipBenchmark::projection_data() {
+  QTest::addColumn<QString>("projector");
+  QTest::newRow("LauePlaneProjector") << "LauePlaneProjector";
+  QTest::newRow("StereoProjector") << "StereoProjector";
+  QTest::newRow("DiffractingStereoProjector") << "DiffractingStereoProjector";
+}
+
+void ClipBenchmark::projection() {
+  QFETCH(QString, projector);
+  Crystal c;
+  c.synchronUpdate(true);
+  QVERIFY(c.getSpacegroup()->setGroupSymbol("P212121"));
+  c.setCell(10.2, 12.4, 15.6, 90.0, 90.0, 90.0);
+  c.setRotation(orientation);
+  Projector* p = ProjectorFactory::getInstance().getProjector(projector);
+  QVERIFY(p!=nullptr);
+  p->connectToCrystal(&c);
+  AllocationCounter allocations;
+  QBENCHMARK {
+    allocations.iteration();
+    p->doProjection();
+  }
+  delete p;
+}
+
+void ClipBenchmark::imageDecode_data() {
+  QTest::addColumn<QString>("file");
+  QStringList patterns;
+  foreach (QString suffix, DataProviderFactory::getInstance().registeredImageFormats())
+    patterns << "*."+suffix;
+  QDir dir(testdataDir());
+  QStringList files;
+  foreach (QFileInfo f, dir.entryInfoList(patterns, QDir::Files, QDir::Name))
+    files << f.absoluteFilePath();
+  foreach (QFileInfo f, QDir(dir.filePath("apexframes")).entryInfoList(patterns, QDir::Files, QDir::Name))
+    files << f.absoluteFilePath();
+  foreach (QString f, files)
+    QTest::newRow(qPrintable(dir.relativeFilePath(f))) << f;
+}
+
+void ClipBenchmark::imageDecode() {
+  QFETCH(QString, file);
+  AllocationCounter allocations;
+  QBENCHMARK {
+    allocations.iteration();
+    ImageDataStore store;
+    DataProvider* dp = DataProviderFactory::getInstance().loadImage(file, &store);
+    QVERIFY(dp!=nullptr);
+    delete dp;
+  }
+}
+
+void ClipBenchmark::scalerRendering_data() {
+  imageDecode_data();
+}
+
+void ClipBenchmark::scalerRendering() {
+  QFETCH(QString, file);
+  ImageDataStore store;
+  DataProvider* dp = DataProviderFactory::getInstance().loadImage(file, &store);
+  QVERIFY(dp!=nullptr);
+  DataScaler* scaler = DataScalerFactory::getInstance().getScaler(dp);
+  QVERIFY(scaler!=nullptr);
+
+  // The scaler caches its image, so alternate between two source rects
+  QPolygonF rects[2] = { QPolygonF(QRectF(0.0, 0.0, 1.0, 1.0)), QPolygonF(QRectF(0.001, 0.0, 0.999, 1.0)) };
+  rects[0].pop_back();
+  rects[1].pop_back();
+  int n = 0;
+  AllocationCounter allocations;
+  QBENCHMARK {
+    allocations.iteration();
+    scaler->getImage(QSize(1024, 1024), rects[n++%2]);
+  }
+  delete scaler;
+  delete dp;
+}
+
+// Markers on the n projected reflections with the lowest indices
+void ClipBenchmark::addMarkers(Crystal& c, Projector* p, int n) {
+  p->doProjection();
+  QList<Reflection> refs = p->getProjectedReflections();
+  std::stable_sort(refs.begin(), refs.end(), [](const Reflection& a, const Reflection& b) {
+    return a.hklSqSum<b.hklSqSum;
+  });
+  for (int i=0; i<std::min(n, refs.size()); i++)
+    p->addSpotMarker(p->normal2det(refs.at(i).normal));
+  QCOMPARE(c.getMarkers().size(), std::min(n, refs.size()));
+}
+
+void ClipBenchmark::indexing_data() {
+  QTest::addColumn<int>("markers");
+  QTest::newRow("4 markers") << 4;
+  QTest::newRow("8 markers") << 8;
+  QTest::newRow("16 markers") << 16;
+}
+
+void ClipBenchmark::indexing() {
+  QFETCH(int, markers);
+  Crystal c;
+  c.synchronUpdate(true);
+  QVERIFY(c.getSpacegroup()->setGroupSymbol("P212121"));
+  c.setCell(10.2, 12.4, 15.6, 90.0, 90.0, 90.0);
+  c.setRotation(orientation);
+  Projector* p = ProjectorFactory::getInstance().getProjector("LauePlaneProjector");
+  QVERIFY(p!=nullptr);
+  p->connectToCrystal(&c);
+  addMarkers(c, p, markers);
+
+  int solutions = 0;
+  AllocationCounter allocations;
+  QBENCHMARK {
+    allocations.iteration();
+    Indexer indexer(c.getMarkers(), c.getRealOrientationMatrix(), c.getReziprocalOrientationMatrix(),
+                    M_PI/180.0, 0.1, 5, c.getSpacegroup()->getLauegroup(), nullptr);
+    BatchIndexLimit limit(&indexer, 5, 0.0);
+    QObject::connect(&indexer, SIGNAL(nextMajorIndex(int)), &limit, SLOT(checkMajorIndex(int)), Qt::DirectConnection);
+    indexer.run();
+    solutions = indexer.solutions().size();
+  }
+  QVERIFY(solutions>0);
+  delete p;
+}
+
+void ClipBenchmark::refinement() {
+  Crystal c;
+  c.synchronUpdate(true);
+  QVERIFY(c.getSpacegroup()->setGroupSymbol("P212121"));
+  c.setCell(10.2, 12.4, 15.6, 90.0, 90.0, 90.0);
+  c.setRotation(orientation);
+  Projector* p = ProjectorFactory::getInstance().getProjector("LauePlaneProjector");
+  QVERIFY(p!=nullptr);
+  p->connectToCrystal(&c);
+  addMarkers(c, p, 12);
+  // Only the orientation is refined, whatever the projector defaults are
+  foreach (FitObject* o, c.getFitObjects())
+    foreach (FitParameter* f, o->allParameters())
+      f->setEnabled(o==&c && (f->name()=="omega" || f->name()=="chi" || f->name()=="phi"));
+
+  // Start every fit from the same, slightly misaligned orientation
+  Mat3D start = Mat3D(Vec3D(1, -1, 1).normalized(), M_PI/180.0)*orientation;
+  double score = -1.0;
+  AllocationCounter allocations;
+  QBENCHMARK {
+    allocations.iteration();
+    c.setRotation(start);
+    NelderMead fitter(&c);
+    score = fitter.fit();
+  }
+  QVERIFY(score>=0.0);
+  delete p;
+}
+
+// From creating the main window until the initial workspace is shown
+void ClipBenchmark::firstWindow() {
+  // The restore prompt would block
+  foreach (QString file, AutoSaver::staleAutosaves())
+    AutoSaver::discardAutosave(file);
+  AllocationCounter allocations;
+  QBENCHMARK {
+    allocations.iteration();
+    Clip* w = Clip::getInstance();
+    QSignalSpy loaded(w, SIGNAL(workspaceLoaded()));
+    w->show();
+    QVERIFY(QTest::qWaitForWindowExposed(w));
+    QVERIFY(loaded.count()>0 || loaded.wait(10000));
+    Clip::clearInstance();
+  }
+}
+
+void ClipBenchmark::firstImage_data() {
+  imageDecode_data();
+}
+
+// From opening an image in a projector until it is rendered
+void ClipBenchmark::firstImage() {
+  QFETCH(QString, file);
+  // Clip::clearInstance recreates the settings
+  ConfigStore::getInstance()->setFrameCacheEnabled(false);
+  Projector* p = ProjectorFactory::getInstance().getProjector("LauePlaneProjector");
+  QVERIFY(p!=nullptr);
+  QPolygonF rect(QRectF(0.0, 0.0, 1.0, 1.0));
+  rect.pop_back();
+  AllocationCounter allocations;
+  QBENCHMARK {
+    allocations.iteration();
+    QSignalSpy loaded(p, SIGNAL(imageLoaded(LaueImage*)));
+    p->loadImage(file);
+    QVERIFY(loaded.wait(10000));
+    QVERIFY(!p->getLaueImage()->getScaledImage(QSize(1024, 1024), rect).isNull());
+    p->closeImage();
+  }
+  delete p;
+}
+
+int main(int argc, char* argv[]) {
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  QApplication app(argc, argv);
+  // Keeps the settings of the benchmarks apart from those of Clip
+  app.setApplicationName("ClipBenchmark");
+  app.setOrganizationDomain("clip4.sf.net");
+  app.setOrganizationName("O.J.Schumann");
+
+  BenchmarkReport report;
+  QStringList arguments = report.parseArguments(app.arguments());
+  ClipBenchmark benchmark;
+  int r = QTest::qExec(&benchmark, arguments);
+  return report.finish(r);
+}
+
+#include "tst_clipbenchmark.moc"
@@ -26,18 +26,33 @@
 
 ColorConfigItem::ColorConfigItem(QString n, QColor defaultColor, QObject* _parent):
     QObject(_parent),
-    _name(n)
+    _color(defaultColor),
+    _name(n),
+    loaded(false),
+    changed(false),
+    loadMutex()
 {
-  QSettings settings;
-  setColor(settings.value(QString("colors/%1").arg(_name), defaultColor).value<QColor>());
 }
 
 ColorConfigItem::~ColorConfigItem() {
+  if (changed) {
+    QSettings settings;
+    settings.setValue(QString("colors/%1").arg(_name), _color);
+  }
+}
+
+// Called with loadMutex held
+void ColorConfigItem::ensureLoaded() const {
+  if (loaded) return;
+  loaded = true;
   QSettings settings;
-  settings.setValue(QString("colors/%1").arg(_name), _color);
+  _color = settings.value(QString("colors/%1").arg(_name), _color).value<QColor>();
 }
 
 QColor ColorConfigItem::color() const {
+  // Batch mode creates projectors, which ask for their colors, in several threads
+  QMutexLocker lock(&loadMutex);
+  ensureLoaded();
   return _color;
 }
 
@@ -46,7 +61,11 @@ QString ColorConfigItem::name() const {
 }
 
 void ColorConfigItem::setColor(const QColor &c) {
+  QMutexLocker lock(&loadMutex);
+  loaded = true;
+  changed = true;
   _color = c;
-  emit colorChanged(_color);
+  lock.unlock();
+  emit colorChanged(c);
 }
 
@@ -26,6 +26,7 @@
 #include <QObject>
 #include <QString>
 #include <QColor>
+#include <QMutex>
 
 #include "config.h"
 
@@ -41,8 +42,13 @@ public slots:
 signals:
   void colorChanged(QColor);
 private:
-  QColor _color;
+  // The stored color is read on first use, not when the item is created
+  void ensureLoaded() const;
+  mutable QColor _color;
   QString _name;
+  mutable bool loaded;
+  bool changed;
+  mutable QMutex loadMutex;
 };
 
 
@@ -24,6 +24,10 @@
 
 #include <QSettings>
 #include <QMetaMethod>
+#include <QDir>
+
+#include "image/tiledimagestore.h"
+#include "tools/memoryaccounting.h"
 
 ConfigStore::ConfigStore(QObject* _parent) :
     QObject(_parent)
@@ -65,6 +69,22 @@ ConfigStore::ConfigStore(QObject* _parent) :
   loadPositionFromCWS = settings.value("LoadPositionFromWorkspace", true).toBool();
   loadSizeFromCWS = settings.value("LoadSizeFromWorkspace", true).toBool();
   initialCWSFile = settings.value("InitialWorkspaceFile", "").toString();
+  memoryBudgetMB = settings.value("ImageMemoryBudget", 1024).toInt();
+  scratchDir = settings.value("ScratchDirectory", QDir::tempPath()).toString();
+  useFrameCache = settings.value("FrameCacheEnabled", false).toBool();
+  frameCacheMB = settings.value("FrameCacheSize", 4096).toInt();
+  autosaveMinutes = settings.value("AutosaveInterval", 5).toInt();
+  TiledImageStore::setMemoryBudget(qint64(memoryBudgetMB)<<20);
+  TiledImageStore::setScratchDirectory(scratchDir);
+
+  settings.beginGroup("MemoryBudgets");
+  for (int s=0; s<MemoryAccounting::SubsystemCount; s++) {
+    subsystemBudgetMB << settings.value(MemoryAccounting::subsystemKey(s), 0).toInt();
+    MemoryAccounting::getInstance()->setBudget(s, qint64(subsystemBudgetMB.last())<<20);
+  }
+  totalBudgetMB = settings.value("Total", 0).toInt();
+  MemoryAccounting::getInstance()->setTotalBudget(qint64(totalBudgetMB)<<20);
+  settings.endGroup();
 }
 
 ConfigStore::~ConfigStore() {
@@ -73,6 +93,16 @@ ConfigStore::~ConfigStore() {
   settings.setValue("LoadPositionFromWorkspace", loadPositionFromCWS);
   settings.setValue("LoadSizeFromWorkspace", loadSizeFromCWS);
   settings.setValue("InitialWorkspaceFile", initialCWSFile);
+  settings.setValue("ImageMemoryBudget", memoryBudgetMB);
+  settings.setValue("ScratchDirectory", scratchDir);
+  settings.setValue("FrameCacheEnabled", useFrameCache);
+  settings.setValue("FrameCacheSize", frameCacheMB);
+  settings.setValue("AutosaveInterval", autosaveMinutes);
+  settings.beginGroup("MemoryBudgets");
+  for (int s=0; s<subsystemBudgetMB.size(); s++)
+    settings.setValue(MemoryAccounting::subsystemKey(s), subsystemBudgetMB.at(s));
+  settings.setValue("Total", totalBudgetMB);
+  settings.endGroup();
 }
 
 ConfigStore* ConfigStore::instance = nullptr;
@@ -176,3 +206,65 @@ void ConfigStore::setInitialWorkspaceFile(QString s) {
 QString ConfigStore::initialWorkspaceFile() {
   return initialCWSFile;
 }
+
+void ConfigStore::setImageMemoryBudget(int mb) {
+  memoryBudgetMB = mb;
+  TiledImageStore::setMemoryBudget(qint64(memoryBudgetMB)<<20);
+}
+
+int ConfigStore::imageMemoryBudget() const {
+  return memoryBudgetMB;
+}
+
+void ConfigStore::setScratchDirectory(QString s) {
+  scratchDir = s;
+  TiledImageStore::setScratchDirectory(s);
+}
+
+QString ConfigStore::scratchDirectory() const {
+  return scratchDir.isEmpty() ? QDir::tempPath() : scratchDir;
+}
+
+void ConfigStore::setFrameCacheEnabled(bool b) {
+  useFrameCache = b;
+}
+
+bool ConfigStore::frameCacheEnabled() const {
+  return useFrameCache;
+}
+
+void ConfigStore::setFrameCacheSize(int mb) {
+  frameCacheMB = mb;
+}
+
+int ConfigStore::frameCacheSize() const {
+  return frameCacheMB;
+}
+
+void ConfigStore::setSubsystemMemoryBudget(int subsystem, int mb) {
+  if (subsystem<0 || subsystem>=subsystemBudgetMB.size()) return;
+  subsystemBudgetMB[subsystem] = mb;
+  MemoryAccounting::getInstance()->setBudget(subsystem, qint64(mb)<<20);
+}
+
+int ConfigStore::subsystemMemoryBudget(int subsystem) const {
+  return subsystemBudgetMB.value(subsystem, 0);
+}
+
+void ConfigStore::setTotalMemoryBudget(int mb) {
+  totalBudgetMB = mb;
+  MemoryAccounting::getInstance()->setTotalBudget(qint64(mb)<<20);
+}
+
+int ConfigStore::totalMemoryBudget() const {
+  return totalBudgetMB;
+}
+
+void ConfigStore::setAutosaveInterval(int minutes) {
+  autosaveMinutes = minutes;
+  emit autosaveIntervalChanged(minutes);
+}
+
+int ConfigStore::autosaveInterval() const {
+  return autosaveMinutes;
+}
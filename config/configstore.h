@@ -27,6 +27,7 @@
 #include <QString>
 #include <QColor>
 #include <QSignalMapper>
+#include <QVector>
 
 #include "config/colorconfigitem.h"
 
@@ -64,15 +65,32 @@ public:
   bool loadPositionFromWorkspace();
   bool loadSizeFromWorkspace();
   QString initialWorkspaceFile();
+  int imageMemoryBudget() const;
+  QString scratchDirectory() const;
+  bool frameCacheEnabled() const;
+  int frameCacheSize() const;
+  // Soft budgets of the memory accounting in MB, 0 for none
+  int subsystemMemoryBudget(int subsystem) const;
+  int totalMemoryBudget() const;
+  // Minutes between autosaves, 0 disables autosave
+  int autosaveInterval() const;
 public slots:
   void setZoneMarkerWidth(double);
   void setLoadPositionFromWorkspace(bool);
   void setLoadSizeFromWorkspace(bool);
   void setInitialWorkspaceFile(QString);
+  void setImageMemoryBudget(int);
+  void setScratchDirectory(QString);
+  void setFrameCacheEnabled(bool);
+  void setFrameCacheSize(int);
+  void setSubsystemMemoryBudget(int subsystem, int mb);
+  void setTotalMemoryBudget(int mb);
+  void setAutosaveInterval(int minutes);
 signals:
   void colorChanged(int, QColor);
   void zoneMarkerWidthChanged(double);
   void tmpColorChanged(QColor);
+  void autosaveIntervalChanged(int);
 
 private:
   explicit ConfigStore(QObject* _parent = nullptr);
@@ -84,6 +102,13 @@ private:
   bool loadSizeFromCWS;
   static ConfigStore* instance;
   QString initialCWSFile;
+  int memoryBudgetMB;
+  QString scratchDir;
+  bool useFrameCache;
+  int frameCacheMB;
+  QVector<int> subsystemBudgetMB;
+  int totalBudgetMB;
+  int autosaveMinutes;
 
 };
 
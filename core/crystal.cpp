@@ -39,6 +39,8 @@
 #include "tools/abstractmarkeritem.h"
 #include "refinement/fitparameter.h"
 #include "tools/threadrunner.h"
+#include "tools/updatescheduler.h"
+#include "tools/trace.h"
 
 
 
@@ -107,9 +109,11 @@ Crystal::Crystal(QObject* _parent):
   axisType(LabSystem),
   spaceGroup(this),
   reflections(),
+  reflectionMemory(MemoryAccounting::Reflections, this),
   reflectionFuture(),
   restartReflectionUpdate(false),
   immediateRotationUpdate(false),
+  rotationUpdatePending(false),
   predictionFactor(1.0),
   updateEnabled(true),
   updateIsSynchron(true),
@@ -271,6 +275,8 @@ void Crystal::generateReflections() {
     QPair<QVector<Reflection>, double> result = doGeneration(GenerationParameters(this));
     reflections = result.first;
     predictionFactor = result.second;
+    rotationUpdatePending = false;
+    updateReflectionMemory();
     emit reflectionsUpdate();
   } else if (reflectionFuture.isRunning()) {
     restartReflectionUpdate = true;
@@ -282,6 +288,7 @@ void Crystal::generateReflections() {
 void Crystal::reflectionGenerated() {
   reflections = reflectionFuture.result().first;
   predictionFactor = reflectionFuture.result().second;
+  updateReflectionMemory();
   if (restartReflectionUpdate) {
     restartReflectionUpdate = false;
     generateReflections();
@@ -289,6 +296,14 @@ void Crystal::reflectionGenerated() {
   emit reflectionsUpdate();
 }
 
+void Crystal::updateReflectionMemory() {
+  qint64 bytes = qint64(reflections.capacity())*sizeof(Reflection);
+  foreach (const Reflection& r, reflections)
+    bytes += qint64(r.orders.capacity())*sizeof(int);
+  reflectionMemory.setName(QString("%1, %2 reflections").arg(spaceGroup.groupSymbol()).arg(reflections.size()));
+  reflectionMemory.setBytes(bytes);
+}
+
 Crystal::GenerationParameters::GenerationParameters(Crystal* c):
     MRot(c->MRot),
     MReziprocal(c->MReziprocal),
@@ -301,6 +316,7 @@ Crystal::GenerationParameters::GenerationParameters(Crystal* c):
 }
 
 QPair<QVector<Reflection>, double> Crystal::doGeneration(const GenerationParameters& parameters) {
+  CLIP_TRACE("Crystal::doGeneration");
 
   Vec3D savedAstar(parameters.MReziprocal(0));
   Vec3D savedBstar(parameters.MReziprocal(1));
@@ -458,10 +474,24 @@ void Crystal::updateRotation() {
   if (not updateEnabled)
     return;
 
+  if (updateIsSynchron) {
+    applyRotation();
+  } else {
+    rotationUpdatePending = true;
+    UpdateScheduler::getInstance()->stageRequested("Reflection update");
+  }
+  emit reflectionsUpdate();
+}
+
+void Crystal::applyRotation() {
+  CLIP_TRACE("Crystal::applyRotation");
+  QElapsedTimer timer;
+  timer.start();
+  rotationUpdatePending = false;
   reflectionsUpdater->start(UpdateLoadBalancer(reflections.data(), reflections.size(), UpdateRef(this)));
   reflectionsUpdater->join();
-
-  emit reflectionsUpdate();
+  if (!updateIsSynchron)
+    UpdateScheduler::getInstance()->stageDone("Reflection update", timer.nsecsElapsed());
 }
 
 int Crystal::reflectionCount() {
@@ -498,6 +528,8 @@ Reflection Crystal::getClosestReflection(const Vec3D& normal) {
 
 
 QVector<Reflection> Crystal::getReflectionList() {
+  if (rotationUpdatePending)
+    applyRotation();
   return reflections;
 }
 
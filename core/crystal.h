@@ -34,6 +34,7 @@
 #include "tools/vec3D.h"
 #include "tools/mat3D.h"
 #include "tools/objectstore.h"
+#include "tools/memoryaccounting.h"
 #include "refinement/fitobject.h"
 #include "refinement/fitparametergroup.h"
 #include "core/spacegroup.h"
@@ -158,6 +159,11 @@ private:
   // define as static to avoid accidential use of this-ptr
   static QPair<QVector<Reflection>, double> doGeneration(const GenerationParameters&);
 
+  // Applies MRot to the reflection list
+  void applyRotation();
+  // Reports the size of the reflection list to the memory accounting
+  void updateReflectionMemory();
+
 
   // Real and reziprocal orientation Matrix
   Mat3D MReal;
@@ -188,6 +194,7 @@ private:
 
   // List of Reflections
   QVector<Reflection> reflections;
+  MemoryAccount reflectionMemory;
   // Flag, that indicates an running update of the reflection list.
   QFutureWatcher<QPair<QVector<Reflection>, double> > reflectionFuture;
   // flag to restart generation of reflections immediately
@@ -195,6 +202,9 @@ private:
   // flag to immediately update the rotation on newly generated reflections
   // nessesary if rotation is altered during generation of reflections
   bool immediateRotationUpdate;
+  // In asynchronous mode the rotation is applied to the reflections when
+  // they are requested, so several rotations per frame cost one update
+  bool rotationUpdatePending;
   // Factor for ab initio prediction of the number of reflections.
   double predictionFactor;
 
@@ -125,4 +125,8 @@ bool DiffractingStereoProjector::project(const Reflection &r, QPointF &p) {
   return false;
 }
 
+void DiffractingStereoProjector::projectRange(const Reflection* r, int n, QPointF* p, bool* ok) {
+  for (int i=0; i<n; i++) ok[i] = DiffractingStereoProjector::project(r[i], p[i]);
+}
+
 bool DiffractingStereoProjector_registered = ProjectorFactory::registerProjector("DiffractingStereoProjector", &StereoProjector::getInstance);
@@ -48,6 +48,7 @@ public:
   virtual QWidget* configWidget();
 protected:
   virtual bool project(const Reflection &r, QPointF &);
+  virtual void projectRange(const Reflection* r, int n, QPointF* p, bool* ok);
 
 };
 
@@ -192,6 +192,10 @@ bool LauePlaneProjector::project(const Reflection &r, QPointF& p) {
   return true;
 }
 
+void LauePlaneProjector::projectRange(const Reflection* r, int n, QPointF* p, bool* ok) {
+  for (int i=0; i<n; i++) ok[i] = LauePlaneProjector::project(r[i], p[i]);
+}
+
 
 void LauePlaneProjector::setDetSize(double _dist, double _width, double _height) {
   if ((detDist!=_dist) or (detWidth!=_width) or (detHeight!=_height)) {
@@ -92,6 +92,7 @@ protected:
   virtual bool parseXMLElement(QDomElement e);
 
   virtual bool project(const Reflection &r, QPointF& p);
+  virtual void projectRange(const Reflection* r, int n, QPointF* p, bool* ok);
   virtual QPair<double, double> validOrderRange(double Q, double Qscatter);
 
   Mat3D localCoordinates;
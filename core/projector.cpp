@@ -34,6 +34,7 @@
 #include <QGraphicsView>
 #include <QMetaObject>
 #include <QSettings>
+#include <QAtomicInt>
 
 #include "tools/circleitem.h"
 #include "tools/ruleritem.h"
@@ -46,8 +47,12 @@
 #include "tools/spotindicatorgraphicsitem.h"
 #include "tools/xmltools.h"
 #include "config/configstore.h"
-#include "tools/colortextitem.h"
+#include "tools/hkllabelitem.h"
 #include "tools/tools.h"
+#include "tools/threadrunner.h"
+#include "tools/updatescheduler.h"
+#include "tools/trace.h"
+#include "tools/startuptiming.h"
 
 
 const char Projector::Settings_QRangeMin[] = "Qmin";
@@ -74,7 +79,6 @@ const char XML_Projector_ZoneMarkers[] = "ZoneMarkers";
 Projector::Projector(QObject* _parent):
     FitObject(_parent),
     decorationItems(),
-    textMarkerItems(),
     spotMarkerStore(this),
     zoneMarkerStore(this),
     rulerStore(this),
@@ -83,6 +87,8 @@ Projector::Projector(QObject* _parent):
     scene(this),
     imageItemsPlane(new QGraphicsPixmapItem()),
     spotIndicator(new SpotIndicatorGraphicsItem()),
+    hklLabels(new HKLLabelItem()),
+    projectionThreads(nullptr),
     imageData(0),
     spotHighlightHKL(),
     spotHighlightItem(0)
@@ -91,6 +97,7 @@ Projector::Projector(QObject* _parent):
 
   scene.addItem(spotIndicator);
   scene.addItem(imageItemsPlane);
+  scene.addItem(hklLabels);
   scene.setItemIndexMethod(QGraphicsScene::NoIndex);
 
   spotIndicator->stackBefore(imageItemsPlane);
@@ -107,12 +114,12 @@ Projector::Projector(QObject* _parent):
   setTextSizeFraction(10.0);
   setSpotSizeFraction(1.0);
 
-  connect(this, SIGNAL(spotSizeChanged(double)), this, SLOT(doProjection()));
-  connect(this, SIGNAL(textSizeChanged(double)), this, SLOT(doProjection()));
+  connect(this, SIGNAL(spotSizeChanged(double)), this, SLOT(scheduleProjection()));
+  connect(this, SIGNAL(textSizeChanged(double)), this, SLOT(scheduleProjection()));
 
   QTimer::singleShot(0, this, SLOT(decorateScene()));
   connect(this, SIGNAL(projectionParamsChanged()), this, SLOT(invalidateMarkerCache()));
-  connect(this, SIGNAL(projectionParamsChanged()), this, SLOT(doProjection()));
+  connect(this, SIGNAL(projectionParamsChanged()), this, SLOT(scheduleProjection()));
   connect(&scene, SIGNAL(sceneRectChanged(const QRectF&)), this, SLOT(updateImgTransformations()));
 
   connect(&spotMarkerStore, SIGNAL(itemAdded(int)), this, SLOT(spotMarkerAdded(int)));
@@ -129,6 +136,7 @@ Projector::Projector(QObject* _parent):
 Projector::~Projector() {
   if (!crystal.isNull())
     crystal->removeProjector(this);
+  delete projectionThreads;
 }
 
 QString Projector::FitObjectName() {
@@ -170,7 +178,7 @@ void Projector::connectToCrystal(Crystal *c) {
   }
   crystal=c;
   crystal->addProjector(this);
-  connect(crystal, SIGNAL(reflectionsUpdate()), this, SLOT(doProjection()));
+  connect(crystal, SIGNAL(reflectionsUpdate()), this, SLOT(scheduleProjection()));
   connect(crystal, SIGNAL(cellChanged()), this, SLOT(invalidateMarkerCache()));
   connect(crystal, SIGNAL(orientationChanged()), this, SLOT(invalidateMarkerCache()));
   connect(crystal, SIGNAL(deleteMarker(AbstractMarkerItem*)), this, SLOT(deleteMarker(AbstractMarkerItem*)));
@@ -232,55 +240,108 @@ ItemStore<QGraphicsRectItem>& Projector::infoItems() {
   return infoStore;
 }
 
-void Projector::doProjection() {
-  if (crystal.isNull() or !isProjectionEnabled())
-    return;
+// Projects chunks of reflections, the chunks are distributed over the threads
+class ProjectionWorker {
+public:
+  ProjectionWorker(Projector* _projector, void (Projector::*_range)(const Reflection*, int, QPointF*, bool*), const Reflection* _refs, int _count, QPointF* _points, bool* _ok, QAtomicInt* _next):
+      projector(_projector), range(_range), refs(_refs), count(_count), points(_points), ok(_ok), next(_next) {}
+  void operator()() {
+    const int chunk = 512;
+    int i;
+    while ((i=next->fetchAndAddOrdered(chunk))<count) {
+      (projector->*range)(refs+i, std::min(chunk, count-i), points+i, ok+i);
+    }
+  }
+private:
+  Projector* projector;
+  void (Projector::*range)(const Reflection*, int, QPointF*, bool*);
+  const Reflection* refs;
+  int count;
+  QPointF* points;
+  bool* ok;
+  QAtomicInt* next;
+};
+
+void Projector::projectRange(const Reflection* r, int n, QPointF* p, bool* ok) {
+  for (int i=0; i<n; i++) ok[i] = project(r[i], p[i]);
+}
+
+void Projector::projectReflections(const QVector<Reflection>& refs, QVector<QPointF>& points, QVector<int>& visible) {
+  int n = refs.size();
+  QVector<QPointF> allPoints(n);
+  QVector<bool> ok(n);
+  if (n<4096) {
+    projectRange(refs.constData(), n, allPoints.data(), ok.data());
+  } else {
+    if (!projectionThreads) projectionThreads = new ThreadRunner();
+    QAtomicInt next(0);
+    projectionThreads->start(ProjectionWorker(this, &Projector::projectRange, refs.constData(), n, allPoints.data(), ok.data(), &next));
+    projectionThreads->join();
+  }
 
-  // Remove the textmarkeritems from the scene
-  foreach (QGraphicsItem* item, textMarkerItems) {
-    scene.removeItem(item);
-    delete item;
+  // Compact to the projected reflections
+  points.clear();
+  visible.clear();
+  for (int i=0; i<n; i++) {
+    if (ok[i]) {
+      points << allPoints[i];
+      visible << i;
+    }
   }
-  textMarkerItems.clear();
+}
 
-  // Clear the coordinates of the old projected spots
-  spotIndicator->coordinates.clear();
-  // Load Reflection List
-  QVector<Reflection> refs = crystal->getReflectionList();
-  // Resize the array, that caches the Information if a reflection is actually projected
-  reflectionIsProjected.resize(refs.size());
+void Projector::scheduleProjection() {
+  UpdateScheduler* scheduler = UpdateScheduler::getInstance();
+  scheduler->stageRequested("Projection");
+  scheduler->schedule(this, "doProjection");
+}
 
-  QPointF p;
-  // Loop over all reflections
-  for (int i=0; i<refs.size(); i++) {
-    // Do the actual projection and store, if reflection could be projected
-    if ((reflectionIsProjected[i] = project(refs.at(i), p))) {
-      // Save the projected coordinate
-      spotIndicator->coordinates << p;
-      // If hklSum is below limit, add a textitem to the scene
-      if (refs.at(i).hklSqSum<=maxHklSqSum) {
-        //QGraphicsTextItem* t = new QGraphicsTextItem();
-        QGraphicsTextItem* t = new ColorTextItem();
-        t->setTransform(QTransform(1,0,0,-1,0,0));
-        t->setHtml(refs.at(i).toHtml());
-        t->setPos(p);
-        ConfigStore::getInstance()->ensureColor(ConfigStore::HKLIndicator, t, SLOT(setColor(QColor)));
-        QRectF r=t->boundingRect();
-        double s=getTextSize()/std::min(r.width(), r.height());
-        t->setScale(s);
-        textMarkerItems.append(t);
-        scene.addItem(t);
-      }
+bool Projector::flushProjection(const QVector<Reflection>& refs) {
+  // The scheduled projection of a new reflection list may still be pending
+  if (!refs.isSharedWith(projectedReflections))
+    doProjection();
+  return refs.isSharedWith(projectedReflections);
+}
+
+void Projector::doProjection() {
+  CLIP_TRACE("Projector::doProjection");
+  if (crystal.isNull() or !isProjectionEnabled())
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // Remove the labels, their layouts are kept for the next projection
+  hklLabels->clear();
+
+  // Shares the reflection list of the crystal, no deep copy
+  const QVector<Reflection> refs = crystal->getReflectionList();
+  QVector<int> visible;
+  projectReflections(refs, spotIndicator->coordinates, visible);
+
+  // Cache the information if a reflection is actually projected
+  reflectionIsProjected.fill(false, refs.size());
+  projectedReflections = refs;
+  for (int j=0; j<visible.size(); j++) {
+    const Reflection& r = refs.at(visible[j]);
+    reflectionIsProjected[visible[j]] = true;
+    // If hklSum is below limit, add a label. Overlapping labels are culled
+    // by hklLabels, so dense projections stay readable
+    if (r.hklSqSum<=maxHklSqSum) {
+      hklLabels->addLabel(spotIndicator->coordinates.at(j), r.h, r.k, r.l);
     }
   }
 
   updateSpotHighlightMarker();
 
+  hklLabels->setTextSize(getTextSize());
+
   // set the spotsize (just in case)
   spotIndicator->setSpotsize(getSpotSize());
   // indicate that the coordinates have changed.
   spotIndicator->pointsUpdated();
   emit projectedPointsUpdated();
+  UpdateScheduler::getInstance()->stageDone("Projection", timer.nsecsElapsed());
 }
 
 QString Projector::diffractionOrders(const Vec3D &hkl) {
@@ -361,7 +422,8 @@ Reflection Projector::getClosestReflection(const Vec3D& normal) {
   if (crystal.isNull())
     return Reflection();
   QVector<Reflection> r = crystal->getReflectionList();
-  if (r.size()!=reflectionIsProjected.size()) qDebug() << "Something horrible is going on...";
+  if (!flushProjection(r))
+    return Reflection();
   int minIdx=-1;
   double minDist=0;
   for (int n=0; n<r.size(); n++) {
@@ -382,7 +444,11 @@ Reflection Projector::getClosestReflection(const Vec3D& normal) {
 
 QList<Reflection> Projector::getProjectedReflections() {
   QList<Reflection> list;
+  if (crystal.isNull())
+    return list;
   QVector<Reflection> r = crystal->getReflectionList();
+  if (!flushProjection(r))
+    return list;
   for (int n=0; n<r.size(); n++)
     if (reflectionIsProjected.at(n))
       list << r.at(n);
@@ -391,7 +457,11 @@ QList<Reflection> Projector::getProjectedReflections() {
 
 QList<Reflection> Projector::getProjectedReflectionsNormalToZone(const TVec3D<int>& uvw) {
   QList<Reflection> list;
+  if (crystal.isNull())
+    return list;
   QVector<Reflection> r = crystal->getReflectionList();
+  if (!flushProjection(r))
+    return list;
   for (int n=0; n<r.size(); n++)
     if (reflectionIsProjected.at(n) && ((r.at(n).hkl()*uvw)==0))
       list << r.at(n);
@@ -494,6 +564,7 @@ bool Projector::isProjectionEnabled() const {
 
 void Projector::setHQPrintMode(bool b) {
   spotIndicator->setCachedPainting(!b);
+  hklLabels->setCachedPainting(!b);
 }
 
 void Projector::setSpotHighlighting(Vec3D hkl) {
@@ -657,6 +728,7 @@ void Projector::showCropMarker() {
     connect(this, SIGNAL(spotSizeChanged(double)), cropMarker, SLOT(setHandleSize(double)));
     //connect(cropMarker.data(), SIGNAL(cancelCrop()), this, SLOT(delCropMarker()), Qt::QueuedConnection);
     connect(cropMarker.data(), SIGNAL(publishCrop(QPolygonF)), this, SLOT(setCrop(QPolygonF)), Qt::QueuedConnection);
+    connect(cropMarker.data(), SIGNAL(cropChanged(QPolygonF)), this, SLOT(previewCrop(QPolygonF)));
     //cropMarker->setTransform(QTransform::fromScale(det2img.m11(), det2img.m22()));
   } else {
     cropMarker->show();
@@ -668,6 +740,12 @@ void Projector::delCropMarker() {
     scene.removeItem(cropMarker.data());
     delete cropMarker;
   }
+  if (imageData) imageData->setHistogramRegion(QPolygonF());
+}
+
+void Projector::previewCrop(QPolygonF rect) {
+  // Histogram of the cropped region, updated while the marker is dragged
+  if (imageData) imageData->setHistogramRegion(det2img.map(rect));
 }
 
 void Projector::setCrop(QPolygonF rect) {
@@ -712,6 +790,7 @@ void Projector::loadImage(QString s) {
 
 void Projector::setImage(LaueImage *tmpImage) {
   if (tmpImage->isValid()) {
+    StartupTiming::mark("First image loaded");
     closeImage();
     imageData = tmpImage;
     emit imageLoaded(imageData);
@@ -53,6 +53,8 @@ class AbstractMarkerItem;
 class CropMarker;
 class LaueImage;
 class SpotIndicatorGraphicsItem;
+class HKLLabelItem;
+class ThreadRunner;
 
 
 class Projector: public FitObject {
@@ -91,6 +93,10 @@ public:
   virtual Vec3D det2normal(const QPointF&) const = 0;
   virtual Vec3D det2normal(const QPointF&, bool& b) const = 0;
 
+  // Projects all reflections in parallel. points receives the detector
+  // positions of the projected reflections, visible their indexes in refs.
+  void projectReflections(const QVector<Reflection>& refs, QVector<QPointF>& points, QVector<int>& visible);
+
   Reflection getClosestReflection(const Vec3D& normal);
   QList<Reflection> getProjectedReflections();
   QList<Reflection> getProjectedReflectionsNormalToZone(const TVec3D<int>& uvw);
@@ -149,6 +155,7 @@ public:
 public slots:
   void delCropMarker();
   void setCrop(QPolygonF);
+  void previewCrop(QPolygonF);
 
   void deleteMarker(AbstractMarkerItem*);
 
@@ -157,6 +164,8 @@ public slots:
   // Set Wavevectors. Note that the Value is expressed in 2*pi/lambda (1/A)
   void setWavevectors(double Qmin, double Qmax);
   void doProjection();
+  // Runs doProjection once in the next display frame
+  void scheduleProjection();
 
   void addRotation(const Vec3D &axis, double angle);
   void addRotation(const Mat3D& M);
@@ -216,14 +225,19 @@ protected:
   void internalSetWavevectors(double, double);
   void updateSpotHighlightMarker();
   virtual bool project(const Reflection &r, QPointF &point)=0;
+  // Batch version of project(). Subclasses override it with a loop over a
+  // qualified call of their own project(), so the per reflection call is not
+  // dispatched virtually and can be inlined.
+  virtual void projectRange(const Reflection* r, int n, QPointF* p, bool* ok);
   virtual QString diffractionOrders(const Vec3D& hkl);
   virtual QPair<double, double> validOrderRange(double Q, double Qscatter)=0;
   virtual bool parseXMLElement(QDomElement e);
+  // Projects refs at once if the scheduled projection has not run yet, false
+  // if reflectionIsProjected still does not belong to them
+  bool flushProjection(const QVector<Reflection>& refs);
 
   // Stuff like Primary beam marker, Coordinate lines
   QList<QGraphicsItem*> decorationItems;
-  // written indexes in the scene
-  QList<QGraphicsItem*> textMarkerItems;
   // Markers for indexation and fit
   ItemStore<SpotItem> spotMarkerStore;
   // Zone markers
@@ -247,6 +261,10 @@ protected:
   bool projectionEnabled;
   bool showMarkers;
   QVector<bool> reflectionIsProjected;
+  // Shares the list reflectionIsProjected was computed for. Rotating the
+  // crystal detaches its list, so a stale projection is never mistaken for
+  // a current one of the same size.
+  QVector<Reflection> projectedReflections;
 
   QGraphicsScene scene;
 
@@ -256,6 +274,12 @@ protected:
   // Projected Spots, drawing is done multithreaded
   SpotIndicatorGraphicsItem* spotIndicator;
 
+  // hkl labels of the projected spots, drawn in one batch
+  HKLLabelItem* hklLabels;
+
+  // Created on the first large projection
+  ThreadRunner* projectionThreads;
+
   LaueImage* imageData;
 
   Vec3D spotHighlightHKL;
@@ -40,7 +40,7 @@ Spacegroup::SpacegroupSymbolInfo::SpacegroupSymbolInfo(int _ITnr, QString _nrMod
   hallSymbol = _Hall;
 }
 
-bool Spacegroup::SpacegroupSymbolInfo::match(QString s) {
+bool Spacegroup::SpacegroupSymbolInfo::match(QString s) const {
   if (s==QString::number(spacegroupNumber))
     return true;
   if (!spacegroupNumberModifier.isEmpty() && s==QString::number(spacegroupNumber)+":"+spacegroupNumberModifier)
@@ -93,8 +93,8 @@ Spacegroup::Spacegroup(const Spacegroup &o): QObject(nullptr) {
 }
 
 bool Spacegroup::setGroupSymbol(QString s) {
-  QList<SpacegroupSymbolInfo>::iterator iter;
-  for (iter=groupInfos.begin(); iter!=groupInfos.end(); ++iter) {
+  QList<SpacegroupSymbolInfo>::const_iterator iter;
+  for (iter=groupInfos().constBegin(); iter!=groupInfos().constEnd(); ++iter) {
     if (iter->match(s)) {
 
       QList<int> oldConstrains = getConstrains();
@@ -441,6 +441,9 @@ bool Spacegroup::generateGroup(QString hall) {
 
 
 
-QList<Spacegroup::SpacegroupSymbolInfo> Spacegroup::groupInfos(Spacegroup::static_init());
+const QList<Spacegroup::SpacegroupSymbolInfo>& Spacegroup::groupInfos() {
+  static const QList<SpacegroupSymbolInfo> infos(static_init());
+  return infos;
+}
 
 
@@ -77,7 +77,7 @@ private:
   class SpacegroupSymbolInfo {
   public:
     SpacegroupSymbolInfo(int, QString, QString, QString, QString);
-    bool match(QString);
+    bool match(QString) const;
 
     Spacegroup::System system() const;
     int SpacegroupNumber() const;
@@ -103,7 +103,8 @@ private:
   QString symbol;
   System crystalsystem;
 
-  static QList<SpacegroupSymbolInfo> groupInfos;
+  // Built from static_init on first use, not at program start
+  static const QList<SpacegroupSymbolInfo>& groupInfos();
 
   class GroupElement {
   public:
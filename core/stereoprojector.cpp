@@ -156,6 +156,10 @@ bool StereoProjector::project(const Reflection &r, QPointF &p) {
   return false;
 }
 
+void StereoProjector::projectRange(const Reflection* r, int n, QPointF* p, bool* ok) {
+  for (int i=0; i<n; i++) ok[i] = StereoProjector::project(r[i], p[i]);
+}
+
 
 
 void StereoProjector::decorateScene() {
@@ -59,6 +59,7 @@ public slots:
   void saveParametersAsDefault();
 protected:
   virtual bool project(const Reflection &r, QPointF &);
+  virtual void projectRange(const Reflection* r, int n, QPointF* p, bool* ok);
   virtual QPair<double, double> validOrderRange(double Q, double Qscatter);
   virtual bool parseXMLElement(QDomElement);
 
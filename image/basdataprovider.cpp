@@ -28,11 +28,15 @@
 #include <QTextStream>
 #include <QDateTime>
 #include <QStringList>
+#include <QAtomicInt>
  
+#include <algorithm>
 #include <cmath>
 
 #include "tools/xmltools.h"
 #include "image/imagedatastore.h"
+#include "image/tiledimagestore.h"
+#include "tools/threadrunner.h"
 
 
 const char BasDataProvider::Info_OriginalFilename[] = "OriginalFilename";
@@ -55,6 +59,38 @@ const char BasDataProvider::INF_Suffix[] = "inf";
 const char BasDataProvider::IMG_Suffix[] = "img";
 
 
+// Maps big endian raw lines through the lookup table, chunks of lines are
+// distributed over the threads
+class LUTConverter {
+public:
+  LUTConverter(const uchar* _raw, float* _dst, int _width, int _lines, int _bytesPerPixel, const float* _lut, QAtomicInt* _nextLine):
+      raw(_raw), dst(_dst), width(_width), lines(_lines), bytesPerPixel(_bytesPerPixel), lut(_lut), nextLine(_nextLine) {}
+  void operator()() {
+    const int chunk = 16;
+    int y0;
+    while ((y0=nextLine->fetchAndAddOrdered(chunk))<lines) {
+      for (int y=y0; y<std::min(y0+chunk, lines); y++) {
+        const uchar* s = raw+qint64(y)*width*bytesPerPixel;
+        float* d = dst+qint64(y)*width;
+        if (bytesPerPixel==1) {
+          for (int x=0; x<width; x++) d[x] = lut[s[x]];
+        } else {
+          for (int x=0; x<width; x++) d[x] = lut[(s[2*x]<<8)|s[2*x+1]];
+        }
+      }
+    }
+  }
+private:
+  const uchar* raw;
+  float* dst;
+  int width;
+  int lines;
+  int bytesPerPixel;
+  const float* lut;
+  QAtomicInt* nextLine;
+};
+
+
 BasDataProvider::BasDataProvider(QObject* _parent) :
     DataProvider(_parent)
 {
@@ -144,7 +180,8 @@ DataProvider* BasDataProvider::Factory::getProvider(QString filename, ImageDataS
   if (dataSize != imgFile.size()) return nullptr;
 
 
-  QVector<float> pixelData(pixelCount);
+  int w = headerData[Info_Width].toInt();
+  int h = headerData[Info_Height].toInt();
 
   double linscale = 4000.0/headerData[Info_Sensitivity].toDouble();
   linscale *= headerData[Info_XPixelSize].toDouble()/100.0;
@@ -154,29 +191,57 @@ DataProvider* BasDataProvider::Factory::getProvider(QString filename, ImageDataS
   linscale *= exp(-0.5*logscale);
   logscale /= (1<<headerData[Info_BitsPerPixel].toInt())-1;
 
-  QDataStream in(&imgFile);
-  in.setByteOrder(QDataStream::BigEndian);
-  if (bytesPerPixel==1) {
-    quint8 pixel;
-    for (int i=0; i<pixelCount; i++) {
-      in >> pixel;
-      if (pixel!=0) {
-        pixelData[i]=linscale * exp(logscale*pixel);
-      }
+  // Large plates are decoded into a scratch file backed store
+  QVector<float> pixelData;
+  TiledImageStore* tiledData = nullptr;
+  if (TiledImageStore::exceedsBudget(qint64(pixelCount)*sizeof(float))) {
+    tiledData = new TiledImageStore(QSize(w, h), sizeof(float), true);
+    if (!tiledData->isValid()) {
+      delete tiledData;
+      return nullptr;
     }
-  } else if (bytesPerPixel==2) {
-    quint16 pixel;
-    for (int i=0; i<pixelCount; i++) {
-      in >> pixel;
-      if (pixel!=0) {
-        //pixelData[i]=linscale * exp(logscale*pixel);
-        pixelData[i]=1.0*pixel;
+  } else {
+    pixelData.resize(pixelCount);
+  }
+
+  // At most 65536 distinct raw values, convert them once
+  QVector<float> lut(1<<(8*bytesPerPixel));
+  for (int pixel=1; pixel<lut.size(); pixel++) {
+    if (bytesPerPixel==1) {
+      lut[pixel] = linscale * exp(logscale*pixel);
+    } else {
+      //lut[pixel] = linscale * exp(logscale*pixel);
+      lut[pixel] = 1.0*pixel;
+    }
+  }
+
+  // Data is stored big endian, line by line. Blocks of lines are read
+  // sequentially and converted in parallel.
+  const int blockLines = TiledImageStore::TileSize;
+  QByteArray rawBlock(blockLines*w*bytesPerPixel, 0);
+  QVector<float> blockBuffer(tiledData ? blockLines*w : 0);
+  ThreadRunner threads;
+  for (int y=0; y<h; y+=blockLines) {
+    int lines = std::min(blockLines, h-y);
+    qint64 blockBytes = qint64(lines)*w*bytesPerPixel;
+    if (imgFile.read(rawBlock.data(), blockBytes)!=blockBytes) {
+      delete tiledData;
+      return nullptr;
+    }
+    float* dst = tiledData ? blockBuffer.data() : pixelData.data()+qint64(y)*w;
+    QAtomicInt nextLine(0);
+    threads.start(LUTConverter(reinterpret_cast<const uchar*>(rawBlock.constData()), dst, w, lines, bytesPerPixel, lut.constData(), &nextLine));
+    threads.join();
+    if (tiledData) {
+      for (int l=0; l<lines; l++) tiledData->writeRow(y+l, blockBuffer.constData()+l*w);
+      // A tile that could not be mapped lost its pixels
+      if (!tiledData->isValid()) {
+        delete tiledData;
+        return nullptr;
       }
     }
   }
 
-  int w = headerData[Info_Width].toInt();
-  int h = headerData[Info_Height].toInt();
   int pixX = headerData[Info_XPixelSize].toInt();
   int pixY = headerData[Info_YPixelSize].toInt();
   store->setData(ImageDataStore::PixelSize, QSizeF(w, h));
@@ -194,28 +259,29 @@ DataProvider* BasDataProvider::Factory::getProvider(QString filename, ImageDataS
   provider->insertFileInformation(filename);
   provider->providerInformation.unite(headerData);
   provider->pixelData = pixelData;
+  provider->tileStore = tiledData;
   provider->dataSize = QSize(w,h);
   return provider;
 }
 
 const void* BasDataProvider::getData() {
-  return (void*)pixelData.data();
+  return pixelData.isEmpty() ? nullptr : (void*)pixelData.data();
 }
 
 QSize BasDataProvider::size() {
   return dataSize;
 }
 
-int BasDataProvider::bytesCount() {
-  return pixelData.size()*sizeof(float);
+qint64 BasDataProvider::bytesCount() {
+  return qint64(pixelCount())*sizeof(float);
 }
 
 int BasDataProvider::pixelCount() {
-  return pixelData.size();
+  return dataSize.width()*dataSize.height();
 }
 
 DataProvider::Format BasDataProvider::format() {
   return Float32;
 }
 
-bool BasRegisterOK = DataProviderFactory::registerImageLoader(0, new BasDataProvider::Factory());
+bool BasRegisterOK = DataProviderFactory::registerImageLoader<BasDataProvider::Factory>(0);
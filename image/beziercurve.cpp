@@ -37,6 +37,15 @@ BezierCurve::BezierCurve(): params() {
 
 bool BezierCurve::setPoints(const QList<QPointF>& p) {
   points=p;
+  bool ok = makeParams(p);
+  // Built here and not on first use, so the scaler threads only read it
+  compileTable();
+  if (ok)
+    emit curveChanged();
+  return ok;
+}
+
+bool BezierCurve::makeParams(const QList<QPointF>& p) {
   // this ist stolen from GIMP. Hale the GPL!!!
   // File: GIMP/app/base/curves.c
   params.clear();
@@ -98,7 +107,6 @@ bool BezierCurve::setPoints(const QList<QPointF>& p) {
     params.last().Xmax=INFINITY;
     if (params.empty()) return false;
   }
-  emit curveChanged();
   return true;
 }
 
@@ -121,6 +129,21 @@ float BezierCurve::operator()(float x, int& hint) {
 }
 
 
+const QVector<float>& BezierCurve::table() {
+  return lookupTable;
+}
+
+void BezierCurve::compileTable() {
+  lookupTable.resize(LUTSize+1);
+  if (params.empty()) {
+    lookupTable.fill(0.0f);
+    return;
+  }
+  int hint = 0;
+  for (int i=0; i<=LUTSize; i++)
+    lookupTable[i] = (*this)(static_cast<float>(i)/LUTSize, hint);
+}
+
 QList<float> BezierCurve::range(float x0, float dx, int N) {
   QList<float> r;
   float x=x0;
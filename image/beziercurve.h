@@ -25,9 +25,12 @@
 
 #include <QPointF>
 #include <QList>
+#include <QVector>
 #include <QObject>
 #include <QDomElement>
 
+#include <algorithm>
+
 
 class BezierCurve: public QObject {
   Q_OBJECT
@@ -42,6 +45,18 @@ public:
   float operator()(float x);
   float operator()(float x, int& hint);
 
+  // Curve sampled at LUTSize+1 points of [0,1], rebuilt in setPoints()
+  static const int LUTSize = 4096;
+  const QVector<float>& table();
+  // Linear interpolation in table(), x is clamped to [0,1]
+  inline float lookup(float x) {
+    float f = std::max(0.0f, std::min(1.0f, x))*LUTSize;
+    int i = std::min(static_cast<int>(f), LUTSize-1);
+    f -= i;
+    const float* t = lookupTable.constData();
+    return t[i]*(1.0f-f)+t[i+1]*f;
+  }
+
   QList<float> range(float x0, float dx, int N);
   QList<QPointF> pointRange(float x0, float dx, int N);
   QList<float> map(QList<float> X);
@@ -78,8 +93,11 @@ private:
   CurveParams getCurveParam(float x);
 
   int getCurveParamIdx(float x);
+  bool makeParams(const QList<QPointF>& p);
+  void compileTable();
   QList<CurveParams> params;
   QList<QPointF> points;
+  QVector<float> lookupTable;
 };
 
 template <class T> T BezierCurve::mapSorted(T X) {
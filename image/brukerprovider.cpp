@@ -350,8 +350,8 @@ QSize BrukerProvider::size() {
   return QSize(providerInformation.values("NCOLS").first().toInt(), providerInformation.values("NROWS").first().toInt());
 }
 
-int BrukerProvider::bytesCount() {
-  return pixelData.size()*sizeof(int);
+qint64 BrukerProvider::bytesCount() {
+  return qint64(pixelData.size())*sizeof(int);
 }
 
 int BrukerProvider::pixelCount() {
@@ -363,4 +363,4 @@ DataProvider::Format BrukerProvider::format() {
 }
 
 
-bool BrukerRegisterOK = DataProviderFactory::registerImageLoader(0, new BrukerProvider::Factory());
+bool BrukerRegisterOK = DataProviderFactory::registerImageLoader<BrukerProvider::Factory>(0);
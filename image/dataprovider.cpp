@@ -27,16 +27,35 @@
 #include <QFileInfo>
 #include <QDateTime>
 
+#include "image/tiledimagestore.h"
 #include "ui/resolutioncalculator.h"
 #include "ui/contrastcurves.h"
 
 
 DataProvider::DataProvider(QObject* _parent) :
-    QObject(_parent)
+    QObject(_parent),
+    tileStore(nullptr)
 {
 }
 
 DataProvider::~DataProvider() {
+  delete tileStore;
+}
+
+int DataProvider::bytesPerPixel(Format f) {
+  switch (f) {
+  case UInt8: return 1;
+  case UInt16: return 2;
+  case Int16: return 2;
+  case Float64: return 8;
+  default: return 4;
+  }
+}
+
+TiledImageStore* DataProvider::tiles() {
+  // Providers with a contiguous buffer are wrapped, out-of-core providers override this
+  if (!tileStore) tileStore = new TiledImageStore(getData(), size(), bytesPerPixel(format()));
+  return tileStore;
 }
 
 DataProvider* DataProvider::openDevice() {
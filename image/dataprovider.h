@@ -32,11 +32,13 @@
 #include "config.h"
 
 class ImageDataStore;
+class TiledImageStore;
 
 
 class DataProvider : public QObject
 {
     Q_OBJECT
+  friend class FrameCache;
 public:
   enum Format {
     RGB8Bit,
@@ -44,7 +46,9 @@ public:
     Float64,
     UInt8,
     UInt16,
-    UInt32
+    UInt32,
+    Int16,
+    Int32
   };
 
   class ImageFactoryClass {
@@ -57,20 +61,28 @@ public:
 
   static DataProvider* loadImage(const QString&);
   static DataProvider* openDevice();
+  static int bytesPerPixel(Format);
   virtual ~DataProvider();
 
   void insertFileInformation(const QString&);
   virtual void saveToXML(QDomElement);
   virtual void loadFromXML(QDomElement);
+  // Providers with live data announce new frames via newDataAvailable(). nextFrame()
+  // hands out the new data for background preparation, loadNewData() switches to it
+  // and rejectFrame() drops it if it could not be prepared
   virtual void loadNewData() {}
+  virtual DataProvider* nextFrame() { return nullptr; }
+  virtual void rejectFrame() {}
+  // Contiguous pixel buffer, may be nullptr for out-of-core providers. Use tiles() instead
   virtual const void* getData()=0;
-  virtual int bytesCount()=0;
+  virtual TiledImageStore* tiles();
+  virtual qint64 bytesCount()=0;
   virtual int pixelCount()=0;
   virtual QSize size()=0;
   virtual Format format()=0;
   virtual QString name();
   virtual QList<QWidget*> toolboxPages();
-  virtual QVariant getProviderInfo(const QString& key) { return providerInformation.values(key).first(); }
+  virtual QVariant getProviderInfo(const QString& key) { return providerInformation.value(key); }
   virtual QList<QString> getProviderInfoKeys() { return providerInformation.keys(); }
 
   static const char Info_ImageFilename[];
@@ -82,6 +94,7 @@ public:
 protected:
   explicit DataProvider(QObject* _parent = nullptr);
   QMultiMap<QString, QVariant> providerInformation;
+  TiledImageStore* tileStore;
 
 signals:
   void newDataAvailable();
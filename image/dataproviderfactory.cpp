@@ -25,9 +25,15 @@
  
 #include <QStringList>
 
+#include "image/framecache.h"
 
 
-DataProviderFactory::DataProviderFactory()
+
+DataProviderFactory::DataProviderFactory():
+    imageLoaderCreators(),
+    imageLoaders(),
+    loadersCreated(false),
+    loaderMutex()
 {
 }
 
@@ -45,10 +51,17 @@ DataProviderFactory& DataProviderFactory::getInstance() {
 }
 
 DataProvider* DataProviderFactory::loadImage(const QString &filename, ImageDataStore* store, QObject* _parent) {
+  FrameCache& cache = FrameCache::getInstance();
+  DataProvider* dp = cache.load(filename, store, _parent);
+  if (dp) return dp;
+  const QMultiMap<int, DataProvider::ImageFactoryClass*>& imageLoaders = loaders();
   foreach (int key, imageLoaders.uniqueKeys()) {
     foreach (auto loader, imageLoaders.values(key)) {
-      DataProvider* dp = loader->getProvider(filename, store, _parent);
-      if (dp) return dp;
+      dp = loader->getProvider(filename, store, _parent);
+      if (dp) {
+        cache.insert(filename, dp, store);
+        return dp;
+      }
     }
   }
   return nullptr;
@@ -56,6 +69,7 @@ DataProvider* DataProviderFactory::loadImage(const QString &filename, ImageDataS
 
 QStringList DataProviderFactory::registeredImageFormats() {
   QStringList formats;
+  const QMultiMap<int, DataProvider::ImageFactoryClass*>& imageLoaders = loaders();
   foreach (int key, imageLoaders.uniqueKeys()) {
     foreach (auto loader, imageLoaders.values(key)) {
       formats += loader->fileFormatFilters();
@@ -64,11 +78,23 @@ QStringList DataProviderFactory::registeredImageFormats() {
   return formats;
 }
 
-bool DataProviderFactory::registerImageLoader(int priority, DataProvider::ImageFactoryClass* loader) {
-  DataProviderFactory::getInstance().imageLoaders.insert(priority, loader);
+bool DataProviderFactory::registerImageLoader(int priority, ImageLoaderCreator creator) {
+  DataProviderFactory::getInstance().imageLoaderCreators.insert(priority, creator);
   return true;
 }
 
+const QMultiMap<int, DataProvider::ImageFactoryClass*>& DataProviderFactory::loaders() {
+  // Images are opened from worker threads, so the first ones may race here
+  QMutexLocker lock(&loaderMutex);
+  if (!loadersCreated) {
+    QMultiMap<int, ImageLoaderCreator>::const_iterator it;
+    for (it=imageLoaderCreators.constBegin(); it!=imageLoaderCreators.constEnd(); ++it)
+      imageLoaders.insert(it.key(), it.value()());
+    loadersCreated = true;
+  }
+  return imageLoaders;
+}
+
 bool DataProviderFactory::registerDeviceOpener(int, DeviceOpener) {
 return true;
 }
@@ -25,14 +25,19 @@
 
 #include <QObject>
 #include <QMultiMap>
+#include <QMutex>
 #include <image/dataprovider.h>
 
 class DataProviderFactory {
 public:
   typedef DataProvider*(*DeviceOpener)(QObject*);
+  typedef DataProvider::ImageFactoryClass*(*ImageLoaderCreator)();
 
   static DataProviderFactory& getInstance();
-  static bool registerImageLoader(int, DataProvider::ImageFactoryClass*);
+  // Only the creator is stored at program start, the loaders are created
+  // when the first image is opened
+  static bool registerImageLoader(int, ImageLoaderCreator);
+  template <class T> static bool registerImageLoader(int priority) { return registerImageLoader(priority, &createImageLoader<T>); }
   static bool registerDeviceOpener(int, DeviceOpener);
 
   DataProvider* loadImage(const QString&, ImageDataStore*, QObject* = nullptr);
@@ -44,7 +49,13 @@ private:
   DataProviderFactory(const DataProviderFactory&);
   virtual ~DataProviderFactory();
 
+  template <class T> static DataProvider::ImageFactoryClass* createImageLoader() { return new T(); }
+  const QMultiMap<int, DataProvider::ImageFactoryClass*>& loaders();
+
+  QMultiMap<int, ImageLoaderCreator> imageLoaderCreators;
   QMultiMap<int, DataProvider::ImageFactoryClass*> imageLoaders;
+  bool loadersCreated;
+  QMutex loaderMutex;
 
 
 signals:
@@ -28,15 +28,19 @@
 #include "image/beziercurve.h"
 #include "tools/xmltools.h"
 #include "tools/threadrunner.h"
+#include "image/tiledimagestore.h"
 
 
 DataScaler::DataScaler(DataProvider* dp, QObject* _parent) :
     QObject(_parent),
-    provider(dp), cache(nullptr), sourceRect(), threads(new ThreadRunner())
+    provider(dp), cache(nullptr), sourceRect(), threads(new ThreadRunner()),
+    cacheMemory(MemoryAccounting::ScalerCache, this, "releaseCache")
 {
+  cacheMemory.setName(provider->name());
   for (int n=0; n<4; n++) {
     BezierCurve* curve = new BezierCurve();
     transferCurves << curve;
+    connect(curve, SIGNAL(curveChanged()), this, SLOT(invalidateTransferTable()));
     connect(curve, SIGNAL(curveChanged()), this, SLOT(updateContrastMapping()));
   }
   resetAllTransforms();
@@ -47,9 +51,11 @@ DataScaler::~DataScaler() {
     delete transferCurves[n];
   transferCurves.clear();
   delete threads;
+  delete cache;
 }
 
 #include "tools/debug.h"
+#include "tools/trace.h"
 
 
 QTransform DataScaler::initialTransform() {
@@ -72,16 +78,51 @@ void DataScaler::addTransform(const QTransform & t) {
 void DataScaler::updateContrastMapping() {
 }
 
+void DataScaler::invalidateTransferTable() {
+  transferLUT.clear();
+}
+
+const QVector<QRgb>& DataScaler::transferTable() {
+  if (transferLUT.isEmpty()) {
+    transferLUT.resize(TransferTableSize);
+    for (int n=0; n<TransferTableSize; n++) {
+      float v = transferCurves[0]->lookup(static_cast<float>(n)/(TransferTableSize-1));
+      QRgb color=0xFF;
+      for (int i=0; i<3; i++) {
+        color <<= 8;
+        color |= static_cast<int>(255.99f*transferCurves[i+1]->lookup(v));
+      }
+      transferLUT[n] = color;
+    }
+  }
+  return transferLUT;
+}
+
+void DataScaler::setHistogramRegion(const QPolygonF& r) {
+  histogramRegion = r.isEmpty() ? QPolygonF() : (QTransform(1,0,0,-1,0,1)*sqareToRaw).map(r);
+  publishHistogram();
+}
+
 QImage DataScaler::getImage(const QSize &size, const QPolygonF &_sourceRect) {
   if ((cache==nullptr) || (size!=cache->size()) || (_sourceRect!=sourceRect)) {
     if (cache!=nullptr) delete cache;
     cache = new QImage(size, QImage::Format_ARGB32_Premultiplied);
     sourceRect = _sourceRect;
     redrawCache();
+    cacheMemory.setBytes(qint64(cache->bytesPerLine())*cache->height()+transferLUT.size()*sizeof(QRgb));
+  } else {
+    cacheMemory.touch();
   }
   return *cache;
 }
 
+void DataScaler::releaseCache() {
+  delete cache;
+  cache = nullptr;
+  transferLUT.clear();
+  cacheMemory.setBytes(0);
+}
+
 DataScaler::Mapper::Mapper(DataScaler* s): scaler(s) {}
 
 void DataScaler::Mapper::init() {
@@ -104,21 +145,27 @@ void DataScaler::Mapper::operator()(int threadId) {
 
   QPointF dx = t.map(QPointF(1, 0))-t.map(QPointF(0, 0));
   while ((y = line.fetchAndAddOrdered(1))<h) {
-    QRgb* d = data+y*w;
-    QPointF p = t.map(QPointF(0, y));
-    for (int x=0; x<w; x++) {
-      *(d++) = scaler->getRGB(p);
-      p+=dx;
-    }
+    scaler->getRGBLine(data+y*w, t.map(QPointF(0, y)), dx, w);
+  }
+}
+
+void DataScaler::getRGBLine(QRgb* dst, const QPointF& p, const QPointF& dx, int count) {
+  QPointF q = p;
+  for (int x=0; x<count; x++) {
+    dst[x] = getRGB(q);
+    q += dx;
   }
 }
 
 
 void DataScaler::redrawCache() {
+  CLIP_TRACE("DataScaler::redrawCache");
   if (cache==nullptr) return;
 
   threads->start(Mapper(this));
   threads->join();
+  // Release tiles paged in during this pass
+  provider->tiles()->trim();
 }
 
 QList<QWidget*> DataScaler::toolboxPages() {
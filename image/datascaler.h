@@ -29,6 +29,7 @@
 #include <QDomElement>
 
 #include "config.h"
+#include "tools/memoryaccounting.h"
 
 class DataProvider;
 class BezierCurve;
@@ -45,6 +46,8 @@ public:
   void loadFromXML(QDomElement);
 
   QImage getImage(const QSize& size, const QPolygonF& from);
+  QSize cacheSize() const { return cache ? cache->size() : QSize(); }
+  QPolygonF cacheSourceRect() const { return sourceRect; }
   QList<BezierCurve*> getTransferCurves() { return transferCurves; }
 
 signals:
@@ -55,10 +58,23 @@ public slots:
   void resetAllTransforms();
   virtual void updateContrastMapping();
   virtual QList<QWidget*> toolboxPages();
+  virtual void publishHistogram() {}
+  // Restricts the published histogram to a region in image coordinates, an empty polygon resets it
+  void setHistogramRegion(const QPolygonF&);
+protected slots:
+  void invalidateTransferTable();
+  // Frees the scaled image, it is rendered again on the next request
+  void releaseCache();
 protected:
   QTransform initialTransform();
   virtual void redrawCache();
   virtual QRgb getRGB(const QPointF&)=0;
+  // Color of an input value in [0,1] after the value curve and the red, green
+  // and blue curves, compiled on demand into TransferTableSize entries
+  static const int TransferTableSize = 1<<16;
+  const QVector<QRgb>& transferTable();
+  // Renders count pixels of one output line, starting at p in steps of dx
+  virtual void getRGBLine(QRgb* dst, const QPointF& p, const QPointF& dx, int count);
 
   class Mapper {
   public:
@@ -75,9 +91,13 @@ protected:
   DataProvider* provider;
   QImage* cache;
   QPolygonF sourceRect;
+  // Region of the histogram in raw pixel coordinates, empty for the whole image
+  QPolygonF histogramRegion;
   QTransform sqareToRaw;
   QList<BezierCurve*> transferCurves;
+  QVector<QRgb> transferLUT;
   ThreadRunner* threads;
+  MemoryAccount cacheMemory;
 };
 
 #endif // DATASCALER_H
@@ -0,0 +1,255 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "framecache.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QMutexLocker>
+#include <QtConcurrentRun>
+#include <limits>
+
+#include "config/configstore.h"
+#include "image/dataprovider.h"
+#include "image/imagedatastore.h"
+#include "image/tiledimagestore.h"
+
+
+const quint32 FrameCache_Magic = 0x434C4643; // "CLFC"
+const quint32 FrameCache_Version = 1;
+const char FrameCache_Suffix[] = ".frame";
+
+// Serves the pixels of a cache entry directly from the mapped file
+class CachedFrameProvider: public DataProvider {
+public:
+  CachedFrameProvider(QFile* _file, uchar* _data, qint64 _bytes, const QSize& _size, Format _format, const QMultiMap<QString, QVariant>& info, QObject* _parent):
+      DataProvider(_parent),
+      file(_file),
+      data(_data),
+      bytes(_bytes),
+      dataSize(_size),
+      dataFormat(_format)
+  {
+    providerInformation = info;
+  }
+  virtual ~CachedFrameProvider() {
+    file->unmap(data);
+    delete file;
+  }
+  virtual const void* getData() { return data; }
+  virtual QSize size() { return dataSize; }
+  virtual qint64 bytesCount() { return bytes; }
+  virtual int pixelCount() { return dataSize.width()*dataSize.height(); }
+  virtual Format format() { return dataFormat; }
+private:
+  QFile* file;
+  uchar* data;
+  qint64 bytes;
+  QSize dataSize;
+  Format dataFormat;
+};
+
+
+FrameCache::FrameCache() {
+}
+
+FrameCache::FrameCache(const FrameCache&) {
+}
+
+FrameCache::~FrameCache() {
+  QMutexLocker lock(&pendingMutex);
+  foreach (QFuture<void> f, pendingWrites)
+    f.waitForFinished();
+}
+
+FrameCache& FrameCache::getInstance() {
+  static FrameCache instance;
+  return instance;
+}
+
+bool FrameCache::isEnabled() const {
+  return ConfigStore::getInstance()->frameCacheEnabled();
+}
+
+QString FrameCache::cacheDirectory() const {
+  return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("frames");
+}
+
+QString FrameCache::entryFilename(const QByteArray& key) const {
+  return QDir(cacheDirectory()).filePath(QString(key)+FrameCache_Suffix);
+}
+
+QByteArray FrameCache::makeKey(const QString& filename) {
+  QFileInfo info(filename);
+  QFile f(filename);
+  if (!info.exists() || !f.open(QFile::ReadOnly)) return QByteArray();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(info.canonicalFilePath().toUtf8());
+  hash.addData(QByteArray::number(info.size()));
+  hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+  // Hash head and tail of the content, reading multi-GB files would defeat the cache
+  const qint64 sampleSize = 1<<16;
+  hash.addData(f.read(sampleSize));
+  if (info.size()>sampleSize) {
+    f.seek(info.size()-sampleSize);
+    hash.addData(f.read(sampleSize));
+  }
+  return hash.result().toHex();
+}
+
+DataProvider* FrameCache::load(const QString& filename, ImageDataStore* store, QObject* _parent) {
+  if (!isEnabled()) return nullptr;
+  QByteArray key = makeKey(filename);
+  if (key.isEmpty()) return nullptr;
+
+  QFile* file = new QFile(entryFilename(key));
+  if (!file->open(QFile::ReadOnly)) {
+    delete file;
+    return nullptr;
+  }
+
+  QDataStream in(file);
+  in.setVersion(QDataStream::Qt_5_0);
+  qint64 dataOffset;
+  QByteArray header;
+  in >> dataOffset >> header;
+
+  QDataStream hs(header);
+  hs.setVersion(QDataStream::Qt_5_0);
+  quint32 magic=0, version=0;
+  QByteArray storedKey;
+  qint32 width=0, height=0, format=0;
+  QMultiMap<QString, QVariant> info;
+  QMap<qint32, QVariant> storeData;
+  hs >> magic >> version >> storedKey >> width >> height >> format >> info >> storeData;
+
+  qint64 dataBytes = qint64(width)*height*DataProvider::bytesPerPixel(DataProvider::Format(format));
+  if (in.status()!=QDataStream::Ok || hs.status()!=QDataStream::Ok || magic!=FrameCache_Magic || version!=FrameCache_Version ||
+      storedKey!=key || dataBytes<=0 || file->size()<dataOffset+dataBytes) {
+    delete file;
+    return nullptr;
+  }
+  uchar* data = file->map(dataOffset, dataBytes);
+  if (!data) {
+    delete file;
+    return nullptr;
+  }
+  // Mark as recently used for the eviction
+  file->setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+  for (QMap<qint32, QVariant>::const_iterator it=storeData.constBegin(); it!=storeData.constEnd(); ++it) {
+    store->setData(ImageDataStore::DataType(it.key()), it.value());
+  }
+  return new CachedFrameProvider(file, data, dataBytes, QSize(width, height), DataProvider::Format(format), info, _parent);
+}
+
+void FrameCache::insert(const QString& filename, DataProvider* dp, ImageDataStore* store) {
+  if (!isEnabled()) return;
+  TiledImageStore* tiles = dp->tiles();
+  if (!tiles->isValid()) return;
+  QSize size = tiles->size();
+  qint64 rowBytes = qint64(size.width())*tiles->bytesPerPixel();
+  // Small images decode fast enough
+  if (rowBytes*size.height()<(1<<20)) return;
+
+  QByteArray key = makeKey(filename);
+  if (key.isEmpty()) return;
+  QDir().mkpath(cacheDirectory());
+
+  QByteArray header;
+  QDataStream hs(&header, QIODevice::WriteOnly);
+  hs.setVersion(QDataStream::Qt_5_0);
+  QMap<qint32, QVariant> storeData;
+  for (int d=ImageDataStore::PhysicalSize; d<=ImageDataStore::CellGamma; d++) {
+    if (store->hasData(ImageDataStore::DataType(d))) storeData.insert(d, store->getData(ImageDataStore::DataType(d)));
+  }
+  hs << FrameCache_Magic << FrameCache_Version << key << qint32(size.width()) << qint32(size.height()) << qint32(dp->format()) << dp->providerInformation << storeData;
+
+  // Pixel data starts page aligned, so it can be mapped directly
+  const qint64 pageSize = 4096;
+  qint64 dataOffset = ((sizeof(qint64)+sizeof(quint32)+header.size()+pageSize-1)/pageSize)*pageSize;
+  QByteArray entryHeader;
+  QDataStream es(&entryHeader, QIODevice::WriteOnly);
+  es.setVersion(QDataStream::Qt_5_0);
+  es << dataOffset << header;
+  entryHeader.append(QByteArray(dataOffset-entryHeader.size(), 0));
+
+  qint64 maxBytes = qint64(ConfigStore::getInstance()->frameCacheSize())<<20;
+  if (tiles->isOutOfCore() || rowBytes*size.height()>std::numeric_limits<int>::max()) {
+    // Too large to be copied, these are streamed by the loading thread
+    if (writeEntry(entryFilename(key), entryHeader, QByteArray(), tiles))
+      evict(maxBytes);
+    tiles->trim();
+    return;
+  }
+  // The provider may be deleted meanwhile, so the writer gets a copy
+  QByteArray pixels(rowBytes*size.height(), Qt::Uninitialized);
+  for (int y=0; y<size.height(); y++)
+    tiles->readRow(y, pixels.data()+y*rowBytes);
+  tiles->trim();
+
+  QFuture<void> f = QtConcurrent::run(this, &FrameCache::writeBack, entryFilename(key), entryHeader, pixels, maxBytes);
+  QMutexLocker lock(&pendingMutex);
+  for (int i=pendingWrites.size()-1; i>=0; i--)
+    if (pendingWrites.at(i).isFinished()) pendingWrites.removeAt(i);
+  pendingWrites << f;
+}
+
+bool FrameCache::writeEntry(const QString& entry, const QByteArray& header, const QByteArray& pixels, TiledImageStore* tiles) {
+  QSaveFile out(entry);
+  if (!out.open(QIODevice::WriteOnly)) return false;
+  out.write(header);
+  if (tiles) {
+    QSize size = tiles->size();
+    QByteArray row(qint64(size.width())*tiles->bytesPerPixel(), 0);
+    for (int y=0; y<size.height(); y++) {
+      tiles->readRow(y, row.data());
+      out.write(row);
+    }
+  } else {
+    out.write(pixels);
+  }
+  return out.commit();
+}
+
+void FrameCache::writeBack(QString entry, QByteArray header, QByteArray pixels, qint64 maxBytes) {
+  if (writeEntry(entry, header, pixels, nullptr))
+    evict(maxBytes);
+}
+
+void FrameCache::evict(qint64 maxBytes) {
+  QMutexLocker lock(&mutex);
+  QDir dir(cacheDirectory());
+  qint64 total = 0;
+  // Newest first, everything beyond the limit is removed
+  foreach (QFileInfo info, dir.entryInfoList(QStringList() << QString("*")+FrameCache_Suffix, QDir::Files, QDir::Time)) {
+    total += info.size();
+    if (total>maxBytes) QFile::remove(info.filePath());
+  }
+}
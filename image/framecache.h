@@ -0,0 +1,70 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QFuture>
+#include <QList>
+#include <QMutex>
+
+class QObject;
+class DataProvider;
+class ImageDataStore;
+class TiledImageStore;
+
+// Optional on-disk cache of decoded frames. Each entry holds the provider
+// information, the ImageDataStore values and the raw pixels in row-major
+// order at a page aligned offset, so a hit is served by mapping the file.
+// Frames held in memory are copied and written in the background, out-of-core
+// frames are streamed to the cache by the loading thread.
+class FrameCache {
+public:
+  static FrameCache& getInstance();
+
+  DataProvider* load(const QString& filename, ImageDataStore* store, QObject* _parent = nullptr);
+  void insert(const QString& filename, DataProvider* dp, ImageDataStore* store);
+
+  bool isEnabled() const;
+  QString cacheDirectory() const;
+  void evict(qint64 maxBytes);
+
+  static QByteArray makeKey(const QString& filename);
+private:
+  FrameCache();
+  FrameCache(const FrameCache&);
+  ~FrameCache();
+
+  QString entryFilename(const QByteArray& key) const;
+  // Either pixels or, row by row, tiles are written
+  static bool writeEntry(const QString& entry, const QByteArray& header, const QByteArray& pixels, TiledImageStore* tiles);
+  void writeBack(QString entry, QByteArray header, QByteArray pixels, qint64 maxBytes);
+
+  QMutex mutex;
+  // Background writes, waited for on destruction
+  QMutex pendingMutex;
+  QList<QFuture<void> > pendingWrites;
+};
+
+#endif // FRAMECACHE_H
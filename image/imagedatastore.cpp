@@ -21,7 +21,7 @@
  **********************************************************************/
 
 #include "imagedatastore.h"
-#include "tools/tools.h"
+#include "tools/guitools.h"
 
 ImageDataStore::ImageDataStore(QObject* _parent) :
     QObject(_parent)
@@ -0,0 +1,158 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "image/imagepyramid.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include "image/tiledimagestore.h"
+#include "tools/threadrunner.h"
+#include "tools/trace.h"
+
+
+// Pools 2x2 blocks of the previous level into the tiles of the next one
+class PoolWorker {
+public:
+  PoolWorker(TiledImageStore** _src, TiledImageStore** _dst, const QVector<float>& _values, QAtomicInt* _nextTile, const QAtomicInt* _cancelled):
+      src(_src), dst(_dst), values(_values.constData()), valueCount(_values.size()), nextTile(_nextTile), cancelled(_cancelled) {}
+  void operator()() {
+    int t;
+    QSize s = src[0]->size();
+    while (!cancelled->loadAcquire() && (t=nextTile->fetchAndAddOrdered(1))<dst[0]->tileCount()) {
+      TiledImageStore::Tile out[3];
+      for (int m=0; m<3; m++) out[m] = dst[m]->tile(t);
+      QRect r = out[0].rect;
+      for (int y=0; y<r.height(); y++) {
+        int* oMax = reinterpret_cast<int*>(out[ImagePyramid::Maximum].data+y*out[0].stride);
+        int* oMean = reinterpret_cast<int*>(out[ImagePyramid::Mean].data+y*out[0].stride);
+        int* oMin = reinterpret_cast<int*>(out[ImagePyramid::Minimum].data+y*out[0].stride);
+        int sy = 2*(r.y()+y);
+        for (int x=0; x<r.width(); x++) {
+          int sx = 2*(r.x()+x);
+          int vMax = -1;
+          int vMin = INT_MAX;
+          float sum = 0.0f;
+          int n = 0;
+          for (int j=sy; j<std::min(sy+2, s.height()); j++) {
+            for (int i=sx; i<std::min(sx+2, s.width()); i++) {
+              vMax = std::max(vMax, src[ImagePyramid::Maximum]->pixel<int>(i, j));
+              vMin = std::min(vMin, src[ImagePyramid::Minimum]->pixel<int>(i, j));
+              sum += values[src[ImagePyramid::Mean]->pixel<int>(i, j)];
+              n++;
+            }
+          }
+          oMax[x] = vMax;
+          oMin[x] = vMin;
+          oMean[x] = nearestRank(sum/n);
+        }
+      }
+    }
+  }
+private:
+  int nearestRank(float v) {
+    int n = std::lower_bound(values, values+valueCount, v)-values;
+    if (n==valueCount || (n>0 && v-values[n-1]<values[n]-v)) n--;
+    return n;
+  }
+  TiledImageStore** src;
+  TiledImageStore** dst;
+  const float* values;
+  int valueCount;
+  QAtomicInt* nextTile;
+  const QAtomicInt* cancelled;
+};
+
+
+ImagePyramid::ImagePyramid(TiledImageStore* _base, const QVector<float>& rankValues):
+    base(_base),
+    values(rankValues),
+    levels(),
+    cancelled(0)
+{
+}
+
+ImagePyramid::~ImagePyramid() {
+  foreach (Level l, levels)
+    for (int m=0; m<3; m++) delete l.store[m];
+}
+
+void ImagePyramid::build() {
+  CLIP_TRACE("ImagePyramid::build");
+  ThreadRunner threads;
+  TiledImageStore* src[3] = { base, base, base };
+  QSize s = base->size();
+  // Stop once a level fits into a single tile
+  while ((s.width()>TiledImageStore::TileSize || s.height()>TiledImageStore::TileSize) && !cancelled.loadAcquire()) {
+    s = QSize((s.width()+1)/2, (s.height()+1)/2);
+    Level l;
+    bool valid = true;
+    for (int m=0; m<3; m++) {
+      l.store[m] = new TiledImageStore(s, sizeof(int));
+      valid = valid && l.store[m]->isValid();
+    }
+    if (valid) {
+      QAtomicInt nextTile(0);
+      threads.start(PoolWorker(src, l.store, values, &nextTile, &cancelled));
+      threads.join();
+      for (int m=0; m<3; m++) valid = valid && l.store[m]->isValid();
+    }
+    // Coarser levels are built from this one, so the pyramid ends here
+    if (!valid) {
+      for (int m=0; m<3; m++) delete l.store[m];
+      break;
+    }
+    levels << l;
+    for (int m=0; m<3; m++) src[m] = l.store[m];
+  }
+}
+
+void ImagePyramid::cancel() {
+  cancelled.storeRelease(1);
+}
+
+TiledImageStore* ImagePyramid::level(int n, Mode m) {
+  if (n<=0 || levels.isEmpty()) return base;
+  return levels[std::min(n, levels.size())-1].store[m];
+}
+
+qint64 ImagePyramid::residentBytes() const {
+  qint64 bytes = 0;
+  foreach (Level l, levels)
+    for (int m=0; m<3; m++) bytes += l.store[m]->residentBytes();
+  return bytes;
+}
+
+void ImagePyramid::trim() {
+  foreach (Level l, levels)
+    for (int m=0; m<3; m++) l.store[m]->trim();
+}
+
+int ImagePyramid::levelFor(double sourcePixelsPerSample) {
+  int n = 0;
+  while (sourcePixelsPerSample>=2.0) {
+    sourcePixelsPerSample /= 2.0;
+    n++;
+  }
+  return n;
+}
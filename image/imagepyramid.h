@@ -0,0 +1,74 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef IMAGEPYRAMID_H
+#define IMAGEPYRAMID_H
+
+#include <QVector>
+#include <QAtomicInt>
+
+class TiledImageStore;
+
+// Downsampled levels of an index image, whose values are the ranks of the
+// sorted distinct pixel values. Each level halves the size of the previous one
+// and keeps the minimum, maximum and mean of the pooled pixels. As ranks are
+// ordered like the values, max pooling keeps single bright spots visible.
+class ImagePyramid {
+public:
+  enum Mode {
+    Maximum,
+    Mean,
+    Minimum
+  };
+
+  // rankValues maps a rank to its (monotonic) value, used for the mean
+  ImagePyramid(TiledImageStore* base, const QVector<float>& rankValues);
+  ~ImagePyramid();
+
+  // Builds all levels, may run in a background thread. The base must not be
+  // trimmed meanwhile.
+  void build();
+  void cancel();
+
+  // Level 0 is the base
+  int levelCount() const { return levels.size()+1; }
+  TiledImageStore* level(int n, Mode m);
+  void trim();
+  qint64 residentBytes() const;
+
+  // Coarsest level at which a sample still covers at most one pooled pixel
+  static int levelFor(double sourcePixelsPerSample);
+private:
+  ImagePyramid(const ImagePyramid&);
+  ImagePyramid& operator=(const ImagePyramid&);
+
+  struct Level {
+    TiledImageStore* store[3];
+  };
+
+  TiledImageStore* base;
+  QVector<float> values;
+  QVector<Level> levels;
+  QAtomicInt cancelled;
+};
+
+#endif // IMAGEPYRAMID_H
@@ -25,6 +25,7 @@
 #include <QImage>
 #include <QPixmap>
 #include <QApplication>
+#include <QDomDocument>
  
 #include <QtConcurrentRun>
 
@@ -35,12 +36,17 @@
 #include "tools/zipiterator.h"
 #include "image/beziercurve.h"
 #include "image/datascaler.h"
+#include "image/dataprovider.h"
+#include "image/tiledimagestore.h"
+#include "tools/trace.h"
 
 
 LaueImage::LaueImage(QObject* _parent) :
-    QObject(_parent), provider(nullptr), scaler(nullptr), dataStore()
+    QObject(_parent), provider(nullptr), scaler(nullptr), rescaleProvider(nullptr), rescaling(false), rescaleRequested(false), dataStore(),
+    dataMemory(MemoryAccounting::ImageData, this)
 {
   connect(&watcher, SIGNAL(finished()), this, SLOT(doneOpenFile()));
+  connect(&rescaleWatcher, SIGNAL(finished()), this, SLOT(doneRescale()));
 }
 
 
@@ -49,6 +55,7 @@ void LaueImage::startOpenFile(QString filename, QDomElement base) {
 }
 
 QPair<DataProvider*, DataScaler*> LaueImage::doOpenFile(QString filename, QDomElement base) {
+  CLIP_TRACE("LaueImage::doOpenFile");
   DataProvider* dp = DataProviderFactory::getInstance().loadImage(filename, &dataStore);
   DataScaler* ds = dp ? DataScalerFactory::getInstance().getScaler(dp) : nullptr;
   if (ds && dp) {
@@ -76,6 +83,8 @@ void LaueImage::doneOpenFile() {
     scaler->setParent(this);
     connect(scaler, SIGNAL(imageContentsChanged()), this, SIGNAL(imageContentsChanged()));
     connect(scaler, SIGNAL(histogramChanged(QVector<int>,QVector<int>,QVector<int>)), this, SIGNAL(histogramChanged(QVector<int>,QVector<int>,QVector<int>)));
+    connect(provider, SIGNAL(newDataAvailable()), this, SLOT(startRescale()));
+    updateMemoryAccount();
   } else {
     if (dp!=nullptr) delete dp;
     if (ds!=nullptr) delete ds;
@@ -84,10 +93,33 @@ void LaueImage::doneOpenFile() {
 }
 
 LaueImage::~LaueImage() {
+  cancelRescale();
   if (scaler!=nullptr) delete scaler;
   if (provider!=nullptr) delete provider;
 }
 
+// Waits for a running rescale and drops its result, the frame it was
+// prepared from dies with the current provider
+void LaueImage::cancelRescale() {
+  if (rescaling) {
+    rescaleWatcher.waitForFinished();
+    delete rescaleWatcher.result();
+  }
+  rescaling = false;
+  rescaleRequested = false;
+  rescaleProvider = nullptr;
+}
+
+void LaueImage::updateMemoryAccount() {
+  if (provider==nullptr) {
+    dataMemory.setBytes(0);
+    return;
+  }
+  dataMemory.setName(provider->name());
+  // Out-of-core providers only hold their mapped tiles in memory
+  dataMemory.setBytes(provider->getData() ? provider->bytesCount() : provider->tiles()->residentBytes());
+}
+
 QImage LaueImage::getScaledImage(const QSize& requestedSize, const QPolygonF& r) {
   return scaler->getImage(requestedSize, r);
 }
@@ -106,6 +138,10 @@ void LaueImage::resetAllTransforms() {
   scaler->resetAllTransforms();
 }
 
+void LaueImage::setHistogramRegion(const QPolygonF& r) {
+  if (scaler) scaler->setHistogramRegion(r);
+}
+
 QString LaueImage::name() {
   return provider->name();
 }
@@ -145,10 +181,12 @@ void LaueImage::loadFromXML(QDomElement base) {
   QDomElement element = base.elementsByTagName(XML_LaueImage_element).at(0).toElement();
   if (element.isNull()) return;
   QString filename = element.attribute(XML_LaueImage_element_fn);
+  cancelRescale();
   if (scaler!=nullptr) delete scaler;
   if (provider!=nullptr) delete provider;
   scaler = nullptr;
   provider = nullptr;
+  updateMemoryAccount();
 
   startOpenFile(filename, element);
 }
@@ -175,5 +213,69 @@ void LaueImage::loadCurvesFromXML(QDomElement base, DataScaler* ds) {
   }
 }
 
+void LaueImage::startRescale() {
+  if (rescaling) {
+    rescaleRequested = true;
+    return;
+  }
+  DataProvider* dp = provider ? provider->nextFrame() : nullptr;
+  if (!dp || !scaler) return;
+
+  // Transfer curves and transforms are handed over via XML
+  QDomDocument doc;
+  QDomElement base = doc.appendChild(doc.createElement(XML_LaueImage_element)).toElement();
+  scaler->saveToXML(base);
+  saveCurvesToXML(base);
+  rescaling = true;
+  rescaleProvider = provider;
+  rescaleWatcher.setFuture(QtConcurrent::run(this, &LaueImage::doRescale, dp, base, scaler->cacheSize(), scaler->cacheSourceRect()));
+}
 
+DataScaler* LaueImage::doRescale(DataProvider* dp, QDomElement base, QSize size, QPolygonF rect) {
+  CLIP_TRACE("LaueImage::doRescale");
+  DataScaler* ds = DataScalerFactory::getInstance().getScaler(dp);
+  if (ds) {
+    ds->loadFromXML(base);
+    loadCurvesFromXML(base, ds);
+    // Render the visible part already here, so switching does not block the GUI
+    if (!size.isEmpty()) ds->getImage(size, rect);
+    ds->moveToThread(thread());
+  }
+  return ds;
+}
 
+void LaueImage::doneRescale() {
+  // Finished signal of a rescale that was already cancelled
+  if (!rescaling) return;
+  rescaling = false;
+  DataScaler* ds = rescaleWatcher.result();
+  if (provider!=rescaleProvider) {
+    // The frame belongs to a provider that has since been replaced
+    delete ds;
+    return;
+  }
+  rescaleProvider = nullptr;
+  if (ds && provider) {
+    delete scaler;
+    scaler = ds;
+    scaler->setParent(this);
+    connect(scaler, SIGNAL(imageContentsChanged()), this, SIGNAL(imageContentsChanged()));
+    connect(scaler, SIGNAL(histogramChanged(QVector<int>,QVector<int>,QVector<int>)), this, SIGNAL(histogramChanged(QVector<int>,QVector<int>,QVector<int>)));
+    provider->loadNewData();
+    updateMemoryAccount();
+    emit imageContentsChanged();
+    scaler->publishHistogram();
+    emit frameChanged(this);
+  } else {
+    delete ds;
+    if (provider) {
+      // Release the frame, otherwise the provider withholds all further frames
+      provider->rejectFrame();
+      rescaleRequested = true;
+    }
+  }
+  if (rescaleRequested) {
+    rescaleRequested = false;
+    startRescale();
+  }
+}
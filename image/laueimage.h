@@ -31,11 +31,16 @@
 #include <QFutureWatcher>
 
 #include "image/imagedatastore.h"
+#include "tools/memoryaccounting.h"
 
 class DataProvider;
 class DataScaler;
 class BezierCurve;
 
+// Element and filename attribute of an image in a saved workspace
+extern const char XML_LaueImage_element[];
+extern const char XML_LaueImage_element_fn[];
+
 class LaueImage : public QObject
 {
   Q_OBJECT
@@ -70,20 +75,34 @@ signals:
   void histogramChanged(QVector<int>, QVector<int>, QVector<int>);
   void openFinished(LaueImage*);
   void openFailed(LaueImage*);
+  void frameChanged(LaueImage*);
 
 public slots:
   void addTransform(const QTransform&);
   void resetAllTransforms();
+  void setHistogramRegion(const QPolygonF&);
 protected slots:
   void doneOpenFile();
+  void startRescale();
+  void doneRescale();
 protected:
   QPair<DataProvider*, DataScaler*> doOpenFile(QString filename, QDomElement base=QDomElement());
+  DataScaler* doRescale(DataProvider* dp, QDomElement base, QSize size, QPolygonF rect);
 private:
+  void updateMemoryAccount();
+  void cancelRescale();
+
   DataProvider* provider;
   DataScaler* scaler;
   QFutureWatcher< QPair<DataProvider*, DataScaler*> > watcher;
+  // Scaler for new frames of live providers, prepared in the background
+  QFutureWatcher<DataScaler*> rescaleWatcher;
+  DataProvider* rescaleProvider;
+  bool rescaling;
+  bool rescaleRequested;
 
   ImageDataStore dataStore;
+  MemoryAccount dataMemory;
 
 };
 
@@ -172,8 +172,8 @@ QSize MWDataProvider::size() {
   return QSize(256, 256);
 }
 
-int MWDataProvider::bytesCount() {
-  return pixelData.size()*sizeof(float);
+qint64 MWDataProvider::bytesCount() {
+  return qint64(pixelData.size())*sizeof(float);
 }
 
 int MWDataProvider::pixelCount() {
@@ -185,4 +185,4 @@ DataProvider::Format MWDataProvider::format() {
 }
 
 
-bool MWRegisterOK = DataProviderFactory::registerImageLoader(0, new MWDataProvider::Factory());
+bool MWRegisterOK = DataProviderFactory::registerImageLoader<MWDataProvider::Factory>(0);
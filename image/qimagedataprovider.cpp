@@ -29,8 +29,7 @@
 
 #include "image/dataproviderfactory.h"
 #include "image/imagedatastore.h"
-
-#include <tiffio.h>
+#include "image/tiledimagestore.h"
 
 
 
@@ -63,37 +62,21 @@ DataProvider* QImageDataProvider::Factory::getProvider(QString filename, ImageDa
         headerData.insert(key, QVariant(img.text(key)));
       }
     }
-    if (reader.format() == "tiff") {
-      TIFF* tif = TIFFOpen(filename.toStdString().c_str(), "r");
-      if (tif) {
-          char* value;
-          ismono = true; //convert all tiff files to monochrome
-          if (TIFFGetField(tif, TIFFTAG_IMAGEDESCRIPTION, &value)) {
-            QString desc(value);
-            //printf("Desc: |%s|\n", qPrintable(desc));
-            if (desc.trimmed().startsWith("instrument:")) {
-              printf("ILL Tiff file detected, parsing description\n");
-              QStringList pairs = desc.split(',');
-              for (const QString &pair : pairs) {
-                QStringList keyValue = pair.split(':');
-                if (keyValue.size() == 2) {
-                  headerData.insert(keyValue[0].trimmed(), keyValue[1].trimmed());
-                  if (keyValue[0].trimmed() == "angle_horizontal") {
-                    bool ok;
-                    double d = keyValue[1].trimmed().toDouble(&ok);
-                    if (ok) {
-                      printf("Setting detector - sample distance to %f\n", d);
-                      store->setData(ImageDataStore::PlaneDetectorToSampleDistance, d);
-                    }
-                  }
-                }
-              }
-
-            } 
-          }
-          TIFFClose(tif);
-      }
-    } 
+    // Gray images are kept as intensities, bilevel and indexed images only
+    // if their color table is gray
+    switch (img.format()) {
+    case QImage::Format_Grayscale8:
+    case QImage::Format_Grayscale16:
+      ismono = true;
+      break;
+    case QImage::Format_Mono:
+    case QImage::Format_MonoLSB:
+    case QImage::Format_Indexed8:
+      ismono = img.isGrayscale();
+      break;
+    default:
+      break;
+    }
     store->setData(ImageDataStore::PixelSize, img.size());
     headerData.insert(Info_ImageSize, QString("%1x%2 pixels").arg(img.width()).arg(img.height()));
     if (ismono) {
@@ -115,11 +98,17 @@ const void* QImageDataProvider::getData() {
   return data.bits();
 }
 
+TiledImageStore* QImageDataProvider::tiles() {
+  // QImage lines are 32 bit aligned
+  if (!tileStore) tileStore = new TiledImageStore(data.constBits(), data.size(), bytesPerPixel(format()), data.bytesPerLine());
+  return tileStore;
+}
+
 QSize QImageDataProvider::size() {
   return data.size();
 }
 
-int QImageDataProvider::bytesCount() {
+qint64 QImageDataProvider::bytesCount() {
   return data.sizeInBytes();
 }
 
@@ -142,4 +131,4 @@ void QImageDataProvider::loadFromXML(QDomElement) {
 
 }
 
-bool registerOK = DataProviderFactory::registerImageLoader(128, new QImageDataProvider::Factory());
+bool registerOK = DataProviderFactory::registerImageLoader<QImageDataProvider::Factory>(128);
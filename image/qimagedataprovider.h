@@ -43,8 +43,9 @@ public:
   virtual void saveToXML(QDomElement);
   virtual void loadFromXML(QDomElement);
   virtual const void* getData();
+  virtual TiledImageStore* tiles();
   virtual QSize size();
-  virtual int bytesCount();
+  virtual qint64 bytesCount();
   virtual int pixelCount();
   virtual Format format();
 private:
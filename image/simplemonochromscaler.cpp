@@ -22,30 +22,250 @@
 
 #include "simplemonochromscaler.h"
 
-#include <set>
-#include <tr1/unordered_set>
-#include <tr1/unordered_map>
+#include <QAtomicInt>
+#include <QtConcurrentRun>
  
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <limits>
 
 #include "image/beziercurve.h"
 #include "image/datascalerfactory.h"
+#include "image/dataprovider.h"
+#include "image/imagepyramid.h"
+#include "image/tiledimagestore.h"
+#include "tools/threadrunner.h"
 #include "ui/monoscalercfg.h"
 
+
+// Pixel values are sorted as unsigned 32 bit keys with the same ordering
+template <typename T> inline quint32 sortKey(T v) { return static_cast<quint32>(v); }
+template <typename T> inline T keyValue(quint32 k) { return static_cast<T>(k); }
+
+template <> inline quint32 sortKey<float>(float v) {
+  quint32 k;
+  std::memcpy(&k, &v, sizeof(k));
+  return (k&0x80000000u) ? ~k : (k|0x80000000u);
+}
+template <> inline float keyValue<float>(quint32 k) {
+  k = (k&0x80000000u) ? (k&0x7FFFFFFFu) : ~k;
+  float v;
+  std::memcpy(&v, &k, sizeof(v));
+  return v;
+}
+// Signed values are offset by flipping the sign bit
+template <> inline quint32 sortKey<qint16>(qint16 v) { return static_cast<quint32>(qint32(v))^0x80000000u; }
+template <> inline qint16 keyValue<qint16>(quint32 k) { return static_cast<qint16>(static_cast<qint32>(k^0x80000000u)); }
+template <> inline quint32 sortKey<qint32>(qint32 v) { return static_cast<quint32>(v)^0x80000000u; }
+template <> inline qint32 keyValue<qint32>(quint32 k) { return static_cast<qint32>(k^0x80000000u); }
+
+// Copies the sort keys of all pixels, tile by tile
+template <typename T> class KeyCollector {
+public:
+  KeyCollector(TiledImageStore* _data, quint32* _keys, QAtomicInt* _nextTile):
+      data(_data), keys(_keys), nextTile(_nextTile) {}
+  void operator()() {
+    int t;
+    while ((t=nextTile->fetchAndAddOrdered(1))<data->tileCount()) {
+      TiledImageStore::Tile tile = data->tile(t);
+      // tiles are filled in order, so each tile owns a contiguous key range
+      quint32* k = keys + tileOffset(t);
+      for (int y=0; y<tile.rect.height(); y++) {
+        T const* line = reinterpret_cast<T const*>(tile.data+y*tile.stride);
+        for (int x=0; x<tile.rect.width(); x++) *k++ = sortKey<T>(line[x]);
+      }
+    }
+  }
+private:
+  qint64 tileOffset(int t) {
+    // all tiles above have full height, all tiles left of t in the same row share its height
+    QRect r = data->tileRect(t);
+    return qint64(r.y())*data->size().width() + qint64(r.x())*r.height();
+  }
+  TiledImageStore* data;
+  quint32* keys;
+  QAtomicInt* nextTile;
+};
+
+// Writes the index of the distinct value of each pixel, tile by tile. The
+// distinct keys are split into buckets by their leading bits, so a lookup is
+// a short binary search within one bucket.
+template <typename T> class IndexWriter {
+public:
+  IndexWriter(TiledImageStore* _data, TiledImageStore* _index, const QVector<quint32>& _distinct, const QVector<int>& _bucketStart, int _shift, QAtomicInt* _nextTile):
+      data(_data), index(_index), distinct(_distinct.constData()), bucketStart(_bucketStart.constData()), shift(_shift), nextTile(_nextTile) {}
+  void operator()() {
+    int t;
+    quint32 minKey = distinct[0];
+    while ((t=nextTile->fetchAndAddOrdered(1))<data->tileCount()) {
+      TiledImageStore::Tile src = data->tile(t);
+      TiledImageStore::Tile dst = index->tile(t);
+      for (int y=0; y<src.rect.height(); y++) {
+        T const* line = reinterpret_cast<T const*>(src.data+y*src.stride);
+        int* out = reinterpret_cast<int*>(dst.data+y*dst.stride);
+        for (int x=0; x<src.rect.width(); x++) {
+          quint32 k = sortKey<T>(line[x]);
+          int b = (k-minKey)>>shift;
+          out[x] = std::lower_bound(distinct+bucketStart[b], distinct+bucketStart[b+1], k)-distinct;
+        }
+      }
+    }
+  }
+private:
+  TiledImageStore* data;
+  TiledImageStore* index;
+  const quint32* distinct;
+  const int* bucketStart;
+  int shift;
+  QAtomicInt* nextTile;
+};
+
+// Histograms of the mapped red, green and blue channels, 768 bins per tile
+class TileHistogramBuilder {
+public:
+  TileHistogramBuilder(TiledImageStore* _index, const QRgb* _colors, int* _histograms, QAtomicInt* _nextTile):
+      index(_index), colors(_colors), histograms(_histograms), nextTile(_nextTile) {}
+  void operator()() {
+    int t;
+    while ((t=nextTile->fetchAndAddOrdered(1))<index->tileCount()) {
+      int* h = histograms+768*t;
+      std::fill(h, h+768, 0);
+      TiledImageStore::Tile tile = index->tile(t);
+      for (int y=0; y<tile.rect.height(); y++) {
+        int const* line = reinterpret_cast<int const*>(tile.data+y*tile.stride);
+        for (int x=0; x<tile.rect.width(); x++) {
+          QRgb c = colors[line[x]];
+          h[qRed(c)]++;
+          h[256+qGreen(c)]++;
+          h[512+qBlue(c)]++;
+        }
+      }
+    }
+  }
+private:
+  TiledImageStore* index;
+  const QRgb* colors;
+  int* histograms;
+  QAtomicInt* nextTile;
+};
+
+// Horizontal extent of a convex polygon at height y
+static bool polygonSpan(const QPolygonF& p, double y, double& x0, double& x1) {
+  x0 = std::numeric_limits<double>::max();
+  x1 = -std::numeric_limits<double>::max();
+  for (int i=0; i<p.size(); i++) {
+    QPointF a = p[i];
+    QPointF b = p[(i+1)%p.size()];
+    if ((a.y()<=y && b.y()>y) || (b.y()<=y && a.y()>y)) {
+      double x = a.x()+(y-a.y())*(b.x()-a.x())/(b.y()-a.y());
+      x0 = std::min(x0, x);
+      x1 = std::max(x1, x);
+    }
+  }
+  return x0<=x1;
+}
+
+// Channel histogram of the pixels of some tiles that lie within a polygon.
+// Each thread counts separately, the sums are added to result when done.
+class RegionHistogramWorker {
+public:
+  RegionHistogramWorker(TiledImageStore* _index, const QRgb* _colors, const QPolygonF& _region, const QVector<int>& _tiles, int* _result, QAtomicInt* _nextTile):
+      index(_index), colors(_colors), region(_region), tiles(_tiles), result(_result), nextTile(_nextTile) {}
+  void init(int numberOfThreads) {
+    threadHistograms = QVector<int>(768*numberOfThreads);
+  }
+  void operator()(int threadId) {
+    int* h = threadHistograms.data()+768*threadId;
+    int n;
+    while ((n=nextTile->fetchAndAddOrdered(1))<tiles.size()) {
+      TiledImageStore::Tile tile = index->tile(tiles[n]);
+      QRect r = tile.rect;
+      for (int y=0; y<r.height(); y++) {
+        double x0, x1;
+        if (!polygonSpan(region, r.y()+y+0.5, x0, x1)) continue;
+        int xs = std::max(static_cast<int>(std::ceil(x0-0.5))-r.x(), 0);
+        int xe = std::min(static_cast<int>(std::ceil(x1-0.5))-r.x(), r.width());
+        int const* line = reinterpret_cast<int const*>(tile.data+y*tile.stride);
+        for (int x=xs; x<xe; x++) {
+          QRgb c = colors[line[x]];
+          h[qRed(c)]++;
+          h[256+qGreen(c)]++;
+          h[512+qBlue(c)]++;
+        }
+      }
+    }
+  }
+  void done(int numberOfThreads) {
+    for (int i=0; i<numberOfThreads; i++)
+      for (int b=0; b<768; b++) result[b] += threadHistograms[768*i+b];
+  }
+private:
+  TiledImageStore* index;
+  const QRgb* colors;
+  QPolygonF region;
+  QVector<int> tiles;
+  int* result;
+  QAtomicInt* nextTile;
+  QVector<int> threadHistograms;
+};
+
+// LSD radix sort, passes in which all keys share the same byte are skipped
+static void radixSort(QVector<quint32>& keys) {
+  QVector<quint32> scratch(keys.size());
+  quint32* src = keys.data();
+  quint32* dst = scratch.data();
+  qint64 n = keys.size();
+  for (int shift=0; shift<32; shift+=8) {
+    qint64 count[257] = {};
+    for (qint64 i=0; i<n; i++) count[((src[i]>>shift)&0xFF)+1]++;
+    if (std::find(count+1, count+257, n)!=count+257) continue;
+    for (int i=0; i<256; i++) count[i+1] += count[i];
+    for (qint64 i=0; i<n; i++) dst[count[(src[i]>>shift)&0xFF]++] = src[i];
+    std::swap(src, dst);
+  }
+  if (src!=keys.data()) keys.swap(scratch);
+}
+
 template <typename T> SimpleMonochromScaler<T>::SimpleMonochromScaler(DataProvider* dp, QObject* _parent) :
-    AbstractMonoScaler(dp, _parent)
+    AbstractMonoScaler(dp, _parent),
+    imagePosToPixelValue(nullptr),
+    pyramid(nullptr),
+    pyramidWatcher(nullptr),
+    pyramidReady(false),
+    pyramidWanted(0),
+    downsampling(ImagePyramid::Maximum),
+    indexMemory(MemoryAccounting::ValueIndex, this),
+    pyramidMemory(MemoryAccounting::ImagePyramid, this, "releasePyramid")
 {
+  indexMemory.setName(dp->name());
+  pyramidMemory.setName(dp->name());
   logarithmicMapping = false;
   histogramEqualisation = false;
   datawidth = dp->size().width();
   dataheight = dp->size().height();
   makeValueIndex();
+  if (imagePosToPixelValue) {
+    pyramidWatcher = new QFutureWatcher<void>(this);
+    connect(pyramidWatcher, SIGNAL(finished()), this, SLOT(pyramidBuilt()));
+    startPyramid();
+  }
 }
 
-template <typename T> SimpleMonochromScaler<T>::SimpleMonochromScaler(const SimpleMonochromScaler &): AbstractMonoScaler(0)  {}
+template <typename T> void SimpleMonochromScaler<T>::startPyramid() {
+  pyramidWanted.storeRelease(0);
+  pyramid = new ImagePyramid(imagePosToPixelValue, unmappedPixelValues);
+  pyramidWatcher->setFuture(QtConcurrent::run(pyramid, &ImagePyramid::build));
+}
 
 template <typename T> SimpleMonochromScaler<T>::~SimpleMonochromScaler() {
+  if (pyramid) {
+    pyramid->cancel();
+    pyramidWatcher->waitForFinished();
+    delete pyramid;
+  }
+  delete imagePosToPixelValue;
 }
 
 template <typename T> DataScaler* SimpleMonochromScaler<T>::getScaler(DataProvider *dp, QObject* _parent) {
@@ -55,62 +275,150 @@ template <typename T> DataScaler* SimpleMonochromScaler<T>::getScaler(DataProvid
 template <typename T> QRgb SimpleMonochromScaler<T>::getRGB(const QPointF &p) {
   int x = static_cast<int>(std::floor(p.x()));
   int y = static_cast<int>(std::floor(p.y()));
-  if (x<0 || x>=datawidth || y<0 || y>=dataheight) {
+  if (!imagePosToPixelValue || x<0 || x>=datawidth || y<0 || y>=dataheight) {
     return 0xFF000000;
   } else {
-    int idx = imagePosToPixelValue[x+y*datawidth];
+    int idx = imagePosToPixelValue->pixel<int>(x, y);
     return mappedPixelValues[idx];
   }
 }
 
+template <typename T> void SimpleMonochromScaler<T>::getRGBLine(QRgb* dst, const QPointF& p, const QPointF& dx, int count) {
+  // Without a value index, e.g. for empty data, there is nothing to show
+  if (!imagePosToPixelValue) {
+    std::fill(dst, dst+count, 0xFF000000);
+    return;
+  }
+  // Sample the value indices into the output line, then map them in place
+  int* idx = reinterpret_cast<int*>(dst);
+  // The pyramid may have fewer levels if its stores could not be allocated
+  int level = ImagePyramid::levelFor(std::hypot(dx.x(), dx.y()));
+  if (pyramidReady) {
+    level = std::min(level, pyramid->levelCount()-1);
+  } else {
+    if (level>0 && !pyramid) pyramidWanted.storeRelease(1);
+    level = 0;
+  }
+  if (level>0) {
+    double scale = 1.0/(1<<level);
+    pyramid->level(level, static_cast<ImagePyramid::Mode>(downsampling))->sampleLine<int>(idx, scale*p, scale*dx, count, -1);
+  } else {
+    imagePosToPixelValue->sampleLine<int>(idx, p, dx, count, -1);
+  }
+  const QRgb* lut = mappedPixelValues.constData();
+  for (int x=0; x<count; x++) dst[x] = (idx[x]<0) ? 0xFF000000 : lut[idx[x]];
+}
 
+template <typename T> void SimpleMonochromScaler<T>::redrawCache() {
+  DataScaler::redrawCache();
+  if (!pyramid && imagePosToPixelValue && pyramidWanted.loadAcquire()) startPyramid();
+  // The pyramid builder reads the index image until it is done
+  if (imagePosToPixelValue && (pyramidReady || !pyramid)) imagePosToPixelValue->trim();
+  if (pyramidReady) pyramid->trim();
+  updateMemoryAccounts();
+}
 
+template <typename T> void SimpleMonochromScaler<T>::pyramidBuilt() {
+  pyramidReady = true;
+  redrawCache();
+  emit imageContentsChanged();
+}
+
+template <typename T> void SimpleMonochromScaler<T>::releasePyramid() {
+  // A pyramid that is still being built is kept
+  if (!pyramidReady) return;
+  pyramidReady = false;
+  delete pyramid;
+  pyramid = nullptr;
+  updateMemoryAccounts();
+}
+
+template <typename T> void SimpleMonochromScaler<T>::updateMemoryAccounts() {
+  qint64 bytes = sizeof(float)*(qint64(unmappedPixelValues.capacity())+logMappedPixelValues.capacity()+cummulativeHistogram.capacity());
+  bytes += sizeof(int)*(qint64(valueCount.capacity())+tileHistograms.capacity());
+  bytes += sizeof(QRgb)*qint64(mappedPixelValues.capacity());
+  if (imagePosToPixelValue) bytes += imagePosToPixelValue->residentBytes();
+  indexMemory.setBytes(bytes);
+  // The levels are only complete once the pyramid is built
+  pyramidMemory.setBytes(pyramidReady ? pyramid->residentBytes() : 0);
+}
 
 
-template <typename T> void SimpleMonochromScaler<T>::makeValueIndex() {
 
-  T const* mydata = static_cast<T const*>(provider->getData());
 
-  // Generates a hashed Tree with the distinct pixel values in the image.
-  // store the index of each pixel for every pixel value
-  std::set<UniqueHelper> indexSet;
-  std::tr1::unordered_set<UniqueHelper, hash> uniqueSet;
-  // loop over all pixel
-  for (int i=0; i<provider->pixelCount(); i++) {
-    // Try to insert pixel, res containes an iterator to the element and
-    // info if this is a new pixel value
-    uniqueSet.insert(UniqueHelper(*mydata)).first->addIndex(i);
-    mydata++;
-  }
-  foreach (UniqueHelper u, uniqueSet) indexSet.insert(u);
 
+template <typename T> void SimpleMonochromScaler<T>::makeValueIndex() {
+
+  TiledImageStore* data = provider->tiles();
+
+  // Sort the keys of all pixels, so that equal values are adjacent
+  QVector<quint32> keys(provider->pixelCount());
+  QAtomicInt nextTile(0);
+  threads->start(KeyCollector<T>(data, keys.data(), &nextTile));
+  threads->join();
+  data->trim();
+  radixSort(keys);
+
+  // Collapse to the distinct values and their number of occurence
+  QVector<quint32> distinct;
+  valueCount.clear();
+  for (int i=0; i<keys.size(); i++) {
+    if (distinct.isEmpty() || distinct.last()!=keys[i]) {
+      distinct << keys[i];
+      valueCount << 0;
+    }
+    valueCount.last()++;
+  }
+  keys = QVector<quint32>();
+  if (distinct.isEmpty()) return;
 
-  // indexSet.size() is now the number of distinct pixel values
-  unmappedPixelValues.resize(indexSet.size());
-  logMappedPixelValues.resize(indexSet.size());
-  cummulativeHistogram.resize(indexSet.size());
-  mappedPixelValues.resize(indexSet.size());
-  valueCount.resize(indexSet.size());
-  imagePosToPixelValue.resize(provider->pixelCount());
+  // distinct.size() is now the number of distinct pixel values
+  unmappedPixelValues.resize(distinct.size());
+  logMappedPixelValues.resize(distinct.size());
+  cummulativeHistogram.resize(distinct.size());
+  mappedPixelValues.resize(distinct.size());
 
-  float minPixelValue = static_cast<float>(indexSet.begin()->key);
-  float pixelValueRange = static_cast<float>(indexSet.rbegin()->key) - minPixelValue;
+  float minPixelValue = static_cast<float>(keyValue<T>(distinct.first()));
+  float pixelValueRange = static_cast<float>(keyValue<T>(distinct.last())) - minPixelValue;
   float logRange = log(pixelValueRange+0.5f)-log(0.5f);
 
-  int n=0;
   int histogramSum=0;
-  float cumHistScale = 1.0/(provider->pixelCount() - indexSet.rbegin()->indexes.size());
-  foreach (UniqueHelper u, indexSet) {
-    unmappedPixelValues[n]=(static_cast<float>(u.key)-minPixelValue)/pixelValueRange;
-    logMappedPixelValues[n]=(log(static_cast<float>(u.key)-minPixelValue+0.5f)-log(0.5f))/logRange;
+  float cumHistScale = 1.0/(provider->pixelCount() - valueCount.last());
+  for (int n=0; n<distinct.size(); n++) {
+    float v = static_cast<float>(keyValue<T>(distinct[n]));
+    unmappedPixelValues[n]=(v-minPixelValue)/pixelValueRange;
+    logMappedPixelValues[n]=(log(v-minPixelValue+0.5f)-log(0.5f))/logRange;
     cummulativeHistogram[n] = cumHistScale*histogramSum;
-    valueCount[n] = u.indexes.size();
     histogramSum += valueCount[n];
-    foreach (int i, u.indexes)
-      imagePosToPixelValue[i]=n;
-    n++;
   }
 
+  // At most 65536 buckets over the key range
+  quint32 keyRange = distinct.last()-distinct.first();
+  int shift = 0;
+  while ((keyRange>>shift) > 0xFFFF) shift++;
+  int bucketCount = (keyRange>>shift)+1;
+  QVector<int> bucketStart(bucketCount+1);
+  for (int b=0, n=0; b<=bucketCount; b++) {
+    while (n<distinct.size() && static_cast<int>((distinct[n]-distinct.first())>>shift)<b) n++;
+    bucketStart[b] = n;
+  }
+
+  delete imagePosToPixelValue;
+  imagePosToPixelValue = new TiledImageStore(provider->size(), sizeof(int));
+  if (imagePosToPixelValue->isValid()) {
+    nextTile.storeRelease(0);
+    threads->start(IndexWriter<T>(data, imagePosToPixelValue, distinct, bucketStart, shift, &nextTile));
+    threads->join();
+    data->trim();
+  }
+  // An index that could not be stored completely shows nothing
+  if (!imagePosToPixelValue->isValid()) {
+    delete imagePosToPixelValue;
+    imagePosToPixelValue = nullptr;
+    return;
+  }
+  imagePosToPixelValue->trim();
+
   updateContrastMapping();
 }
 
@@ -118,23 +426,70 @@ template <typename T> void SimpleMonochromScaler<T>::updateContrastMapping() {
   QList<QVector<int> > channels;
   channels << QVector<int>(256) << QVector<int>(256) << QVector<int>(256);
 
-  QVector<float> vMap = transferCurves[0]->mapSorted((histogramEqualisation) ? cummulativeHistogram : (logarithmicMapping) ? logMappedPixelValues : unmappedPixelValues);
-  int Hints[3] = {0, 0, 0};
-  float scale = 256.0*(1.0-1.0/mappedPixelValues.size());
-  for (int n=0; n<vMap.size(); n++) {
-    float v = vMap[n];
-    QRgb color=0xFF;
-    for (int i=0; i<3; i++) {
-      int c = static_cast<int>(scale*(*transferCurves[i+1])(v, Hints[i]));
-      color <<= 8;
-      color |= c;
-      channels[i][c]+=valueCount[n];
-    }
+  const QVector<float>& values = (histogramEqualisation) ? cummulativeHistogram : (logarithmicMapping) ? logMappedPixelValues : unmappedPixelValues;
+  const QVector<QRgb>& table = transferTable();
+  float scale = TransferTableSize-1;
+  for (int n=0; n<values.size(); n++) {
+    float v = std::max(0.0f, std::min(1.0f, values[n]));
+    QRgb color = table[static_cast<int>(scale*v+0.5f)];
+    channels[0][qRed(color)]+=valueCount[n];
+    channels[1][qGreen(color)]+=valueCount[n];
+    channels[2][qBlue(color)]+=valueCount[n];
     mappedPixelValues[n]=color;
   }
+  histogramChannels = channels;
+  tileHistograms.clear();
   redrawCache();
   emit imageContentsChanged();
-  emit histogramChanged(channels[0], channels[1], channels[2]);
+  publishHistogram();
+}
+
+template <typename T> void SimpleMonochromScaler<T>::publishHistogram() {
+  QList<QVector<int> > channels = histogramRegion.isEmpty() ? histogramChannels : regionHistogram();
+  if (channels.size()==3)
+    emit histogramChanged(channels[0], channels[1], channels[2]);
+}
+
+template <typename T> void SimpleMonochromScaler<T>::buildTileHistograms() {
+  tileHistograms.resize(768*imagePosToPixelValue->tileCount());
+  QAtomicInt nextTile(0);
+  threads->start(TileHistogramBuilder(imagePosToPixelValue, mappedPixelValues.constData(), tileHistograms.data(), &nextTile));
+  threads->join();
+  updateMemoryAccounts();
+}
+
+template <typename T> QList<QVector<int> > SimpleMonochromScaler<T>::regionHistogram() {
+  if (!imagePosToPixelValue) return QList<QVector<int> >();
+  // The tile histograms stay valid until the contrast mapping changes, so
+  // moving the region only rescans the tiles on its border
+  if (tileHistograms.isEmpty()) buildTileHistograms();
+
+  QVector<int> sum(768);
+  QVector<int> partialTiles;
+  QRectF bounds = histogramRegion.boundingRect();
+  for (int t=0; t<imagePosToPixelValue->tileCount(); t++) {
+    QRectF r = imagePosToPixelValue->tileRect(t);
+    if (!r.intersects(bounds)) continue;
+    if (histogramRegion.containsPoint(r.topLeft(), Qt::OddEvenFill) &&
+        histogramRegion.containsPoint(r.topRight(), Qt::OddEvenFill) &&
+        histogramRegion.containsPoint(r.bottomLeft(), Qt::OddEvenFill) &&
+        histogramRegion.containsPoint(r.bottomRight(), Qt::OddEvenFill)) {
+      const int* h = tileHistograms.constData()+768*t;
+      for (int b=0; b<768; b++) sum[b] += h[b];
+    } else {
+      partialTiles << t;
+    }
+  }
+  if (!partialTiles.isEmpty()) {
+    QAtomicInt nextTile(0);
+    threads->start(RegionHistogramWorker(imagePosToPixelValue, mappedPixelValues.constData(), histogramRegion, partialTiles, sum.data(), &nextTile));
+    threads->join();
+  }
+  if (pyramidReady || !pyramid) imagePosToPixelValue->trim();
+
+  QList<QVector<int> > channels;
+  channels << sum.mid(0, 256) << sum.mid(256, 256) << sum.mid(512, 256);
+  return channels;
 }
 
 #include <QFormLayout>
@@ -143,9 +498,10 @@ template <typename T> void SimpleMonochromScaler<T>::updateContrastMapping() {
 template <typename T> QList<QWidget*> SimpleMonochromScaler<T>::toolboxPages() {
   QList<QWidget*> pages;
 
-  MonoScalerCfg* cfg = new MonoScalerCfg(histogramEqualisation, logarithmicMapping);
+  MonoScalerCfg* cfg = new MonoScalerCfg(histogramEqualisation, logarithmicMapping, downsampling);
   connect(cfg, SIGNAL(histogramEq(bool)), this, SLOT(setHistogramEqualisation(bool)));
   connect(cfg, SIGNAL(logMapping(bool)), this, SLOT(setLogarithmicMapping(bool)));
+  connect(cfg, SIGNAL(downsamplingMode(int)), this, SLOT(setDownsampling(int)));
   pages << cfg;
 
   return pages;
@@ -165,9 +521,19 @@ template <typename T> void SimpleMonochromScaler<T>::setLogarithmicMapping(bool
   }
 }
 
+template <typename T> void SimpleMonochromScaler<T>::setDownsampling(int m) {
+  if (m!=downsampling) {
+    downsampling = m;
+    redrawCache();
+    emit imageContentsChanged();
+  }
+}
+
 template class SimpleMonochromScaler<float>;
 template class SimpleMonochromScaler<unsigned int>;
 
 bool SimpleMonochromScaler_Float = DataScalerFactory::registerDataScaler(DataProvider::Float32, &SimpleMonochromScaler<float>::getScaler);
 bool SimpleMonochromScaler_Int = DataScalerFactory::registerDataScaler(DataProvider::UInt32, &SimpleMonochromScaler<unsigned int>::getScaler);
 bool SimpleMonochromScaler_Int16 = DataScalerFactory::registerDataScaler(DataProvider::UInt16, &SimpleMonochromScaler<uint16_t>::getScaler);
+bool SimpleMonochromScaler_SInt16 = DataScalerFactory::registerDataScaler(DataProvider::Int16, &SimpleMonochromScaler<qint16>::getScaler);
+bool SimpleMonochromScaler_SInt32 = DataScalerFactory::registerDataScaler(DataProvider::Int32, &SimpleMonochromScaler<qint32>::getScaler);
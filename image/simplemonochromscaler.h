@@ -23,8 +23,14 @@
 #ifndef SIMPLEMONOCHROMSCALER_H
 #define SIMPLEMONOCHROMSCALER_H
 
+#include <QAtomicInt>
+#include <QFutureWatcher>
+
 #include "image/datascaler.h"
 
+class TiledImageStore;
+class ImagePyramid;
+
 
 class AbstractMonoScaler : public DataScaler {
   Q_OBJECT
@@ -34,6 +40,9 @@ public:
 protected slots:
   virtual void setHistogramEqualisation(bool)=0;
   virtual void setLogarithmicMapping(bool)=0;
+  virtual void setDownsampling(int)=0;
+  virtual void pyramidBuilt()=0;
+  virtual void releasePyramid()=0;
 };
 
 template <typename T> class SimpleMonochromScaler : public AbstractMonoScaler
@@ -43,33 +52,30 @@ public:
   virtual ~SimpleMonochromScaler();
   virtual void updateContrastMapping();
   QList<QWidget*> toolboxPages();
+  virtual void publishHistogram();
 protected:
   virtual QRgb getRGB(const QPointF &);
+  virtual void getRGBLine(QRgb* dst, const QPointF& p, const QPointF& dx, int count);
+  virtual void redrawCache();
   virtual void setHistogramEqualisation(bool);
   virtual void setLogarithmicMapping(bool);
+  virtual void setDownsampling(int);
+  virtual void pyramidBuilt();
+  // Zoomed out views sample the full resolution index until the next zoomed
+  // out redraw has rebuilt the pyramid in the background
+  virtual void releasePyramid();
 private:
   explicit SimpleMonochromScaler(DataProvider* dp, QObject* _parent = nullptr);
   SimpleMonochromScaler(const SimpleMonochromScaler&);
   void makeValueIndex();
+  void startPyramid();
+  void buildTileHistograms();
+  QList<QVector<int> > regionHistogram();
+  void updateMemoryAccounts();
 
-  class UniqueHelper {
-  public:
-    UniqueHelper(T _key): key(_key), indexes() {}
-    UniqueHelper(const UniqueHelper& o) { key = o.key; indexes=o.indexes; }
-    UniqueHelper& operator=(const UniqueHelper& o) { key = o.key; indexes=o.indexes; return *this; }
-    void addIndex(int i) const { const_cast<QList<int>& >(indexes).append(i); }
-    T key;
-    QList<int> indexes;
-    inline bool operator<(const UniqueHelper& o) const { return key<o.key; }
-    inline bool operator==(const UniqueHelper& o) const { return key==o.key; }
-  };
   int datawidth;
   int dataheight;
 
-  struct hash {
-    std::size_t operator()(const UniqueHelper& v) const { return (std::size_t)v.key; }
-  };
-
   // Dispaly logarithm of values
   bool logarithmicMapping;
   // Equalize the histogram befor applying the transfer curves
@@ -85,8 +91,22 @@ private:
   QVector<int> valueCount;
   // Mapped pixel values
   QVector<QRgb> mappedPixelValues;
+  // Histogram of the mapped red, green and blue channels
+  QList<QVector<int> > histogramChannels;
+  // Red, green and blue histograms of each tile of imagePosToPixelValue, built on demand
+  QVector<int> tileHistograms;
   // mappes index of a pixel to its value in unmappedPixelValues and mappedPixelValues
-  QVector<int> imagePosToPixelValue;
+  TiledImageStore* imagePosToPixelValue;
+  // Downsampled index images, used once built in the background
+  ImagePyramid* pyramid;
+  QFutureWatcher<void>* pyramidWatcher;
+  bool pyramidReady;
+  // Set by render threads that would have used a released pyramid
+  QAtomicInt pyramidWanted;
+  // ImagePyramid::Mode used for zoomed out display
+  int downsampling;
+  MemoryAccount indexMemory;
+  MemoryAccount pyramidMemory;
 };
 
 
@@ -22,13 +22,15 @@
 
 #include "simplergbscaler.h"
 #include "image/datascalerfactory.h"
+#include "image/dataprovider.h"
+#include "image/tiledimagestore.h"
  
 
 
 SimpleRGBScaler::SimpleRGBScaler(DataProvider* dp, QObject* _parent) :
     DataScaler(dp, _parent)
 {
-  data = static_cast<QRgb const*>(dp->getData());
+  data = dp->tiles();
   datawidth = dp->size().width();
   dataheight = dp->size().height();
 }
@@ -48,9 +50,13 @@ QRgb SimpleRGBScaler::getRGB(const QPointF &p) {
   if (x<0 || x>=datawidth || y<0 || y>=dataheight) {
     return 0xFFFF0000;
   } else {
-    return *(data+x+y*datawidth);
+    return data->pixel<QRgb>(x, y);
   }
 }
 
+void SimpleRGBScaler::getRGBLine(QRgb* dst, const QPointF& p, const QPointF& dx, int count) {
+  data->sampleLine<QRgb>(dst, p, dx, count, 0xFFFF0000);
+}
+
 
 bool SimpleRGBScalerRegistered = DataScalerFactory::registerDataScaler(DataProvider::RGB8Bit, &SimpleRGBScaler::getScaler);
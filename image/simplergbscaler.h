@@ -26,6 +26,8 @@
 #include <QObject>
 #include "image/datascaler.h"
 
+class TiledImageStore;
+
 class SimpleRGBScaler : public DataScaler
 {
   Q_OBJECT
@@ -34,10 +36,11 @@ public:
   virtual ~SimpleRGBScaler();
 protected:
   virtual QRgb getRGB(const QPointF &);
+  virtual void getRGBLine(QRgb* dst, const QPointF& p, const QPointF& dx, int count);
 private:
   explicit SimpleRGBScaler(DataProvider* dp, QObject* _parent = nullptr);
   SimpleRGBScaler(const SimpleRGBScaler&);
-  QRgb const* data;
+  TiledImageStore* data;
   int datawidth;
   int dataheight;
 };
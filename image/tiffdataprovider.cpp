@@ -0,0 +1,334 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "tiffdataprovider.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QAtomicInt>
+
+#include <algorithm>
+#include <limits>
+#include <tiffio.h>
+
+#include "image/dataproviderfactory.h"
+#include "image/imagedatastore.h"
+#include "tools/threadrunner.h"
+
+
+const char TiffDataProvider::Info_BitsPerSample[] = "BitsPerSample";
+const char TiffDataProvider::Info_SampleFormat[] = "SampleFormat";
+const char TiffDataProvider::Info_Layout[] = "Layout";
+const char TiffDataProvider::Info_Compression[] = "Compression";
+const char TiffDataProvider::Info_Description[] = "Description";
+const char TiffDataProvider::Info_Software[] = "Software";
+const char TiffDataProvider::Info_DateTime[] = "DateTime";
+
+
+// Geometry of the strips or tiles of one TIFF directory
+struct TiffLayout {
+  int width;
+  int height;
+  bool tiled;
+  int chunkWidth;
+  int chunkHeight;
+  int chunksAcross;
+  int chunkCount;
+  int chunkBytes;
+  int sampleFormat;
+  int bitsPerSample;
+  bool invert;
+};
+
+template <typename S, typename D> static void copyChunk(const void* src, int srcStride, D* dst, int dstStride, int w, int h, bool invert) {
+  const S* s = static_cast<const S*>(src);
+  for (int y=0; y<h; y++) {
+    const S* sl = s+y*srcStride;
+    D* dl = dst+y*dstStride;
+    if (invert) {
+      for (int x=0; x<w; x++) dl[x] = static_cast<D>(std::numeric_limits<S>::max()-sl[x]);
+    } else {
+      for (int x=0; x<w; x++) dl[x] = static_cast<D>(sl[x]);
+    }
+  }
+}
+
+// Native sample type -> type stored in the provider
+static void storeChunk(const TiffLayout& l, const void* src, int chunk, char* dst) {
+  int x0 = l.tiled ? (chunk%l.chunksAcross)*l.chunkWidth : 0;
+  int y0 = (l.tiled ? (chunk/l.chunksAcross) : chunk)*l.chunkHeight;
+  int w = std::min(l.chunkWidth, l.width-x0);
+  int h = std::min(l.chunkHeight, l.height-y0);
+  if (w<=0 || h<=0) return;
+  int offset = x0+y0*l.width;
+  int stride = l.chunkWidth;
+
+  if (l.sampleFormat==SAMPLEFORMAT_UINT) {
+    if (l.bitsPerSample==8) {
+      copyChunk<quint8>(src, stride, reinterpret_cast<quint16*>(dst)+offset, l.width, w, h, l.invert);
+    } else if (l.bitsPerSample==16) {
+      copyChunk<quint16>(src, stride, reinterpret_cast<quint16*>(dst)+offset, l.width, w, h, l.invert);
+    } else {
+      copyChunk<quint32>(src, stride, reinterpret_cast<unsigned int*>(dst)+offset, l.width, w, h, l.invert);
+    }
+  } else if (l.sampleFormat==SAMPLEFORMAT_INT) {
+    if (l.bitsPerSample==8) {
+      copyChunk<qint8>(src, stride, reinterpret_cast<qint16*>(dst)+offset, l.width, w, h, false);
+    } else if (l.bitsPerSample==16) {
+      copyChunk<qint16>(src, stride, reinterpret_cast<qint16*>(dst)+offset, l.width, w, h, false);
+    } else {
+      copyChunk<qint32>(src, stride, reinterpret_cast<qint32*>(dst)+offset, l.width, w, h, false);
+    }
+  } else {
+    float* d = reinterpret_cast<float*>(dst)+offset;
+    if (l.bitsPerSample==32) {
+      copyChunk<float>(src, stride, d, l.width, w, h, false);
+    } else {
+      copyChunk<double>(src, stride, d, l.width, w, h, false);
+    }
+  }
+}
+
+// Each worker thread holds its own TIFF handle, as libtiff handles are not
+// reentrant. Strips or tiles are distributed via an atomic counter.
+class TiffDataProvider::Decoder {
+public:
+  Decoder(const QString& _filename, const TiffLayout& _layout, char* _dst, QAtomicInt* _nextChunk, QAtomicInt* _failed):
+      filename(QFile::encodeName(_filename)),
+      layout(_layout),
+      dst(_dst),
+      nextChunk(_nextChunk),
+      failed(_failed) {}
+
+  void operator()() {
+    TIFF* tif = nullptr;
+    QByteArray buffer;
+    int chunk;
+    while ((chunk=nextChunk->fetchAndAddOrdered(1))<layout.chunkCount) {
+      if (!tif) {
+        tif = TIFFOpen(filename.constData(), "r");
+        if (!tif) {
+          failed->storeRelease(1);
+          return;
+        }
+        buffer.resize(layout.chunkBytes);
+      }
+      tmsize_t n;
+      if (layout.tiled) {
+        n = TIFFReadEncodedTile(tif, chunk, buffer.data(), layout.chunkBytes);
+      } else {
+        n = TIFFReadEncodedStrip(tif, chunk, buffer.data(), layout.chunkBytes);
+      }
+      if (n<0) {
+        failed->storeRelease(1);
+        break;
+      }
+      storeChunk(layout, buffer.constData(), chunk, dst);
+    }
+    if (tif) TIFFClose(tif);
+  }
+private:
+  QByteArray filename;
+  TiffLayout layout;
+  char* dst;
+  QAtomicInt* nextChunk;
+  QAtomicInt* failed;
+};
+
+
+TiffDataProvider::TiffDataProvider(QObject* _parent) :
+    DataProvider(_parent),
+    dataFormat(UInt16)
+{
+}
+
+TiffDataProvider::~TiffDataProvider() {}
+
+QStringList TiffDataProvider::Factory::fileFormatFilters() {
+  return QStringList() << "tif" << "tiff";
+}
+
+// ILL detectors put their metadata as "key: value, key: value" into the description
+static void parseILLDescription(const QString& desc, QMultiMap<QString, QVariant>& headerData, ImageDataStore* store) {
+  printf("ILL Tiff file detected, parsing description\n");
+  QStringList pairs = desc.split(',');
+  for (const QString &pair : pairs) {
+    QStringList keyValue = pair.split(':');
+    if (keyValue.size() == 2) {
+      headerData.insert(keyValue[0].trimmed(), keyValue[1].trimmed());
+      if (keyValue[0].trimmed() == "angle_horizontal") {
+        bool ok;
+        double d = keyValue[1].trimmed().toDouble(&ok);
+        if (ok) {
+          printf("Setting detector - sample distance to %f\n", d);
+          store->setData(ImageDataStore::PlaneDetectorToSampleDistance, d);
+        }
+      }
+    }
+  }
+}
+
+DataProvider* TiffDataProvider::Factory::getProvider(QString filename, ImageDataStore *store, QObject* _parent) {
+  QFileInfo info(filename);
+  if (!info.exists() || !info.isReadable()) return nullptr;
+  if (!fileFormatFilters().contains(info.suffix().toLower())) return nullptr;
+
+  TIFF* tif = TIFFOpen(QFile::encodeName(filename).constData(), "r");
+  if (!tif) return nullptr;
+
+  uint32_t width=0, height=0;
+  uint16_t spp=1, bps=1, sampleFormat=SAMPLEFORMAT_UINT, photometric=PHOTOMETRIC_MINISBLACK, compression=COMPRESSION_NONE;
+  TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
+  TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
+  TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &spp);
+  TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &bps);
+  TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLEFORMAT, &sampleFormat);
+  TIFFGetFieldDefaulted(tif, TIFFTAG_COMPRESSION, &compression);
+  TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &photometric);
+
+  bool supported = (spp==1) && (width>0) && (height>0);
+  if (sampleFormat==SAMPLEFORMAT_UINT || sampleFormat==SAMPLEFORMAT_INT) {
+    supported &= (bps==8 || bps==16 || bps==32);
+  } else if (sampleFormat==SAMPLEFORMAT_IEEEFP) {
+    supported &= (bps==32 || bps==64);
+  } else {
+    supported = false;
+  }
+  supported &= (photometric==PHOTOMETRIC_MINISBLACK || photometric==PHOTOMETRIC_MINISWHITE);
+  if (!supported) {
+    // Color, palette and bilevel images are left to the QImage based loader
+    TIFFClose(tif);
+    return nullptr;
+  }
+
+  TiffLayout layout;
+  layout.width = width;
+  layout.height = height;
+  layout.tiled = TIFFIsTiled(tif);
+  if (layout.tiled) {
+    uint32_t tw=0, th=0;
+    TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tw);
+    TIFFGetField(tif, TIFFTAG_TILELENGTH, &th);
+    layout.chunkWidth = tw;
+    layout.chunkHeight = th;
+    layout.chunksAcross = (width+tw-1)/tw;
+    layout.chunkCount = TIFFNumberOfTiles(tif);
+    layout.chunkBytes = TIFFTileSize(tif);
+  } else {
+    uint32_t rowsPerStrip = height;
+    TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+    layout.chunkWidth = width;
+    layout.chunkHeight = std::min(rowsPerStrip, height);
+    layout.chunksAcross = 1;
+    layout.chunkCount = TIFFNumberOfStrips(tif);
+    layout.chunkBytes = TIFFStripSize(tif);
+  }
+  layout.sampleFormat = sampleFormat;
+  layout.bitsPerSample = bps;
+  layout.invert = (photometric==PHOTOMETRIC_MINISWHITE) && (sampleFormat==SAMPLEFORMAT_UINT);
+
+  QMultiMap<QString, QVariant> headerData;
+  char* value;
+  if (TIFFGetField(tif, TIFFTAG_IMAGEDESCRIPTION, &value)) {
+    QString desc(value);
+    if (desc.trimmed().startsWith("instrument:")) {
+      parseILLDescription(desc, headerData, store);
+    } else if (!desc.trimmed().isEmpty()) {
+      headerData.insert(Info_Description, desc.trimmed());
+    }
+  }
+  if (TIFFGetField(tif, TIFFTAG_SOFTWARE, &value)) headerData.insert(Info_Software, QString(value).trimmed());
+  if (TIFFGetField(tif, TIFFTAG_DATETIME, &value)) headerData.insert(Info_DateTime, QString(value).trimmed());
+  TIFFClose(tif);
+
+  if (layout.chunkBytes<=0 || layout.chunkCount<=0) return nullptr;
+
+  TiffDataProvider* provider = new TiffDataProvider(_parent);
+  provider->dataSize = QSize(width, height);
+  int bytesPerPixel;
+  if (sampleFormat==SAMPLEFORMAT_UINT && bps<=16) {
+    provider->dataFormat = UInt16;
+    bytesPerPixel = sizeof(quint16);
+  } else if (sampleFormat==SAMPLEFORMAT_UINT) {
+    provider->dataFormat = UInt32;
+    bytesPerPixel = sizeof(unsigned int);
+  } else if (sampleFormat==SAMPLEFORMAT_INT && bps<=16) {
+    provider->dataFormat = Int16;
+    bytesPerPixel = sizeof(qint16);
+  } else if (sampleFormat==SAMPLEFORMAT_INT) {
+    provider->dataFormat = Int32;
+    bytesPerPixel = sizeof(qint32);
+  } else {
+    provider->dataFormat = Float32;
+    bytesPerPixel = sizeof(float);
+  }
+  provider->pixelData.fill(0, bytesPerPixel*width*height);
+
+  QAtomicInt nextChunk(0);
+  QAtomicInt failed(0);
+  // The workers read the file name of decoder, so it has to outlive join()
+  Decoder decoder(filename, layout, provider->pixelData.data(), &nextChunk, &failed);
+  if (layout.chunkCount==1) {
+    decoder();
+  } else {
+    ThreadRunner threads;
+    threads.start(decoder);
+    threads.join();
+  }
+  if (failed.loadAcquire()) {
+    delete provider;
+    return nullptr;
+  }
+
+  store->setData(ImageDataStore::PixelSize, provider->dataSize);
+  headerData.insert(Info_ImageSize, QString("%1x%2 pixels").arg(width).arg(height));
+  headerData.insert(Info_BitsPerSample, int(bps));
+  headerData.insert(Info_SampleFormat, QString((sampleFormat==SAMPLEFORMAT_IEEEFP) ? "float" : ((sampleFormat==SAMPLEFORMAT_INT) ? "signed" : "unsigned")));
+  headerData.insert(Info_Layout, QString("%1 %2").arg(layout.chunkCount).arg(layout.tiled ? "tiles" : "strips"));
+  headerData.insert(Info_Compression, int(compression));
+
+  provider->insertFileInformation(filename);
+  provider->providerInformation.unite(headerData);
+  return provider;
+}
+
+const void* TiffDataProvider::getData() {
+  return pixelData.constData();
+}
+
+QSize TiffDataProvider::size() {
+  return dataSize;
+}
+
+qint64 TiffDataProvider::bytesCount() {
+  return pixelData.size();
+}
+
+int TiffDataProvider::pixelCount() {
+  return dataSize.width()*dataSize.height();
+}
+
+DataProvider::Format TiffDataProvider::format() {
+  return dataFormat;
+}
+
+bool TiffRegisterOK = DataProviderFactory::registerImageLoader<TiffDataProvider::Factory>(64);
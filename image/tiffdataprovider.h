@@ -0,0 +1,76 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef TIFFDATAPROVIDER_H
+#define TIFFDATAPROVIDER_H
+
+#include <QByteArray>
+#include <QStringList>
+
+#include "image/dataprovider.h"
+
+// Reads monochrome TIFF files directly via libtiff. Strips or tiles are
+// decoded in parallel into a native buffer, thus the full dynamic range of
+// 16 and 32 bit detector images is preserved.
+class TiffDataProvider : public DataProvider
+{
+  Q_OBJECT
+public:
+  class Factory: public DataProvider::ImageFactoryClass {
+  public:
+    Factory() {}
+    QStringList fileFormatFilters();
+    DataProvider* getProvider(QString, ImageDataStore*, QObject* = nullptr);
+  };
+  virtual ~TiffDataProvider();
+
+  virtual const void* getData();
+  virtual QSize size();
+  virtual qint64 bytesCount();
+  virtual int pixelCount();
+  virtual Format format();
+
+  static const char Info_BitsPerSample[];
+  static const char Info_SampleFormat[];
+  static const char Info_Layout[];
+  static const char Info_Compression[];
+  static const char Info_Description[];
+  static const char Info_Software[];
+  static const char Info_DateTime[];
+
+private:
+  explicit TiffDataProvider(QObject* _parent = nullptr);
+  TiffDataProvider(const TiffDataProvider&);
+  TiffDataProvider& operator=(const TiffDataProvider&);
+
+  class Decoder;
+
+  QByteArray pixelData;
+  QSize dataSize;
+  Format dataFormat;
+signals:
+
+public slots:
+
+};
+
+#endif // TIFFDATAPROVIDER_H
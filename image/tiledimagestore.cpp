@@ -0,0 +1,227 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "tiledimagestore.h"
+
+#include <QTemporaryFile>
+#include <QDir>
+#include <QMutexLocker>
+#include <QAtomicInteger>
+#include <QVector>
+#include <QPair>
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+
+
+static QAtomicInteger<qint64> globalMappedBytes(0);
+static QAtomicInteger<qint64> globalBudget(qint64(1024)<<20);
+static QMutex scratchMutex;
+static QString scratchDirectory;
+static QAtomicInt mapClock(0);
+
+
+TiledImageStore::TiledImageStore(const void* data, const QSize& size, int bytesPerPixel, int stride):
+    dataSize(size),
+    bpp(bytesPerPixel),
+    across((size.width()+TileSize-1)/TileSize),
+    down((size.height()+TileSize-1)/TileSize),
+    tileBytes(0),
+    rawData(static_cast<const uchar*>(data)),
+    rawStride((stride>0) ? stride : size.width()*bytesPerPixel),
+    file(nullptr),
+    tileMap(nullptr),
+    tileStamp(nullptr),
+    mapFailed(0)
+{
+}
+
+TiledImageStore::TiledImageStore(const QSize& size, int bytesPerPixel, bool outOfCore):
+    dataSize(size),
+    bpp(bytesPerPixel),
+    across((size.width()+TileSize-1)/TileSize),
+    down((size.height()+TileSize-1)/TileSize),
+    tileBytes(TileSize*TileSize*bytesPerPixel),
+    rawData(nullptr),
+    rawStride(0),
+    file(nullptr),
+    tileMap(new QAtomicPointer<uchar>[across*down]),
+    tileStamp(new QAtomicInt[across*down]),
+    mapFailed(0)
+{
+  qint64 totalBytes = qint64(tileBytes)*tileCount();
+  if (outOfCore || exceedsBudget(totalBytes)) {
+    scratchMutex.lock();
+    QString dir = scratchDirectory.isEmpty() ? QDir::tempPath() : scratchDirectory;
+    scratchMutex.unlock();
+    QTemporaryFile* scratch = new QTemporaryFile(QDir(dir).filePath("clip_tiles_XXXXXX"));
+    if (scratch->open() && scratch->resize(totalBytes)) {
+      file = scratch;
+    } else {
+      printf("Could not create scratch file for %dx%d image, keeping it in memory\n", size.width(), size.height());
+      delete scratch;
+    }
+  }
+  // Without a scratch file, larger images cannot be stored and the store stays invalid
+  if (!file && totalBytes<=INT_MAX) {
+    ownData.fill(0, static_cast<int>(totalBytes));
+    for (int n=0; n<tileCount(); n++) {
+      tileMap[n].storeRelease(reinterpret_cast<uchar*>(ownData.data())+qint64(n)*tileBytes);
+    }
+  }
+}
+
+TiledImageStore::~TiledImageStore() {
+  if (file) {
+    for (int n=0; n<tileCount(); n++) unmapTile(n);
+    delete file;
+  }
+  delete[] tileMap;
+  delete[] tileStamp;
+}
+
+bool TiledImageStore::isValid() const {
+  return !mapFailed.loadAcquire() && (rawData || file || !ownData.isEmpty());
+}
+
+QRect TiledImageStore::tileRect(int n) const {
+  QRect r((n%across)*TileSize, (n/across)*TileSize, TileSize, TileSize);
+  return r.intersected(QRect(QPoint(0, 0), dataSize));
+}
+
+TiledImageStore::Tile TiledImageStore::tile(int n) {
+  Tile t;
+  t.rect = tileRect(n);
+  if (rawData) {
+    t.data = const_cast<uchar*>(rawData)+t.rect.y()*rawStride+t.rect.x()*bpp;
+    t.stride = rawStride;
+  } else {
+    t.data = tileMap[n].loadAcquire();
+    if (!t.data) t.data = mapTile(n);
+    t.stride = TileSize*bpp;
+  }
+  return t;
+}
+
+void TiledImageStore::writeRow(int y, const void* src) {
+  if (rawData || y<0 || y>=dataSize.height()) return;
+  const uchar* s = static_cast<const uchar*>(src);
+  for (int tx=0; tx<across; tx++) {
+    Tile t = tile(tx+(y>>TileShift)*across);
+    memcpy(t.data+(y-t.rect.y())*t.stride, s+t.rect.x()*bpp, t.rect.width()*bpp);
+  }
+  // Written tile rows are complete, release them if needed
+  if (((y&(TileSize-1))==TileSize-1) || (y==dataSize.height()-1)) trim();
+}
+
+void TiledImageStore::readRow(int y, void* dst) {
+  if (y<0 || y>=dataSize.height()) return;
+  uchar* d = static_cast<uchar*>(dst);
+  if (rawData) {
+    memcpy(d, rawData+y*rawStride, dataSize.width()*bpp);
+    return;
+  }
+  for (int tx=0; tx<across; tx++) {
+    Tile t = tile(tx+(y>>TileShift)*across);
+    memcpy(d+t.rect.x()*bpp, t.data+(y-t.rect.y())*t.stride, t.rect.width()*bpp);
+  }
+}
+
+uchar* TiledImageStore::mapTile(int n) {
+  QMutexLocker lock(&mapMutex);
+  uchar* p = tileMap[n].loadAcquire();
+  if (p) return p;
+  p = file ? file->map(qint64(n)*tileBytes, tileBytes) : nullptr;
+  if (!p) {
+    // Invalidates the store, the tile gets zeroed memory of its own so
+    // that callers neither crash nor write into other tiles
+    printf("Could not map image tile %d\n", n);
+    mapFailed.storeRelease(1);
+    QByteArray& replacement = failedTiles[n];
+    replacement.fill(0, tileBytes);
+    p = reinterpret_cast<uchar*>(replacement.data());
+    tileMap[n].storeRelease(p);
+    return p;
+  }
+  globalMappedBytes.fetchAndAddOrdered(tileBytes);
+  tileStamp[n].storeRelease(mapClock.fetchAndAddRelaxed(1));
+  tileMap[n].storeRelease(p);
+  return p;
+}
+
+void TiledImageStore::unmapTile(int n) {
+  // Replacements of failed tiles stay until the store is deleted
+  if (failedTiles.contains(n)) return;
+  uchar* p = tileMap[n].fetchAndStoreOrdered(nullptr);
+  if (p && file) {
+    file->unmap(p);
+    globalMappedBytes.fetchAndAddOrdered(-tileBytes);
+  }
+}
+
+void TiledImageStore::trim() {
+  if (!file) return;
+  QMutexLocker lock(&mapMutex);
+  qint64 budget = memoryBudget();
+  if (globalMappedBytes.loadAcquire()<=budget) return;
+
+  QVector<QPair<int, int> > mapped;
+  for (int n=0; n<tileCount(); n++) {
+    if (tileMap[n].loadAcquire()) mapped << qMakePair(tileStamp[n].loadAcquire(), n);
+  }
+  std::sort(mapped.begin(), mapped.end());
+  for (int i=0; i<mapped.size() && globalMappedBytes.loadAcquire()>budget; i++) {
+    unmapTile(mapped.at(i).second);
+  }
+}
+
+qint64 TiledImageStore::residentBytes() const {
+  if (!file) return ownData.size();
+  qint64 bytes = 0;
+  for (int n=0; n<tileCount(); n++)
+    if (tileMap[n].loadAcquire()) bytes += tileBytes;
+  return bytes;
+}
+
+qint64 TiledImageStore::memoryBudget() {
+  return globalBudget.loadAcquire();
+}
+
+void TiledImageStore::setMemoryBudget(qint64 bytes) {
+  globalBudget.storeRelease(bytes);
+}
+
+void TiledImageStore::setScratchDirectory(const QString& dir) {
+  QMutexLocker lock(&scratchMutex);
+  scratchDirectory = dir;
+}
+
+qint64 TiledImageStore::mappedBytes() {
+  return globalMappedBytes.loadAcquire();
+}
+
+bool TiledImageStore::exceedsBudget(qint64 bytes) {
+  return bytes>memoryBudget()/2;
+}
@@ -0,0 +1,160 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef TILEDIMAGESTORE_H
+#define TILEDIMAGESTORE_H
+
+#include <QSize>
+#include <QRect>
+#include <QPointF>
+#include <QByteArray>
+#include <QString>
+#include <QMutex>
+#include <QHash>
+#include <QAtomicPointer>
+#include <QAtomicInt>
+
+#include <cmath>
+
+class QFile;
+
+// Pixel storage that is accessed in square tiles. A store either wraps a
+// contiguous row-major buffer, holds its tiles in memory or pages them in
+// from a scratch file on demand. Mapped tiles of out-of-core stores count
+// against a global memory budget, which is enforced in trim().
+class TiledImageStore {
+public:
+  static const int TileShift = 8;
+  static const int TileSize = 1<<TileShift;
+
+  struct Tile {
+    uchar* data;   // first pixel of the tile
+    int stride;    // bytes from one tile line to the next
+    QRect rect;    // covered pixels in image coordinates
+  };
+
+  // Wraps a row-major buffer owned by the caller. stride defaults to width*bytesPerPixel
+  TiledImageStore(const void* data, const QSize& size, int bytesPerPixel, int stride=0);
+  // Tile-major store, uses a scratch file if requested or the data exceeds the budget
+  TiledImageStore(const QSize& size, int bytesPerPixel, bool outOfCore=false);
+  ~TiledImageStore();
+
+  // False if the pixels could not be allocated or a tile could not be mapped.
+  // Such a store must not be used, it holds lost or zeroed pixels.
+  bool isValid() const;
+  bool isOutOfCore() const { return file!=nullptr; }
+  QSize size() const { return dataSize; }
+  int bytesPerPixel() const { return bpp; }
+  int tilesAcross() const { return across; }
+  int tileCount() const { return across*down; }
+  QRect tileRect(int n) const;
+
+  Tile tile(int n);
+  void writeRow(int y, const void* src);
+  void readRow(int y, void* dst);
+
+  template <typename T> T pixel(int x, int y) {
+    return *reinterpret_cast<const T*>(pixelAddress(x, y));
+  }
+  template <typename T> void setPixel(int x, int y, T v) {
+    if (!rawData) *reinterpret_cast<T*>(pixelAddress(x, y)) = v;
+  }
+  // Samples count pixels starting at p in steps of dx. The position is
+  // advanced in 32.32 fixed point, pixels outside the image are set to outside.
+  template <typename T> void sampleLine(T* dst, const QPointF& p, const QPointF& dx, int count, T outside);
+
+  // Unmaps least recently mapped tiles while the budget is exceeded. Must not
+  // be called while other threads read from this store.
+  void trim();
+  // Owned pixel data that is in memory, mapped tiles for out-of-core stores
+  qint64 residentBytes() const;
+
+  static qint64 memoryBudget();
+  static qint64 mappedBytes();
+  static bool exceedsBudget(qint64 bytes);
+  // Set by the application configuration, defaults are 1 GiB and the temp dir
+  static void setMemoryBudget(qint64 bytes);
+  static void setScratchDirectory(const QString& dir);
+private:
+  TiledImageStore(const TiledImageStore&);
+  TiledImageStore& operator=(const TiledImageStore&);
+
+  uchar* mapTile(int n);
+  inline uchar* pixelAddress(int x, int y) {
+    if (rawData) return const_cast<uchar*>(rawData)+y*rawStride+x*bpp;
+    int n = (x>>TileShift)+(y>>TileShift)*across;
+    uchar* t = tileMap[n].loadAcquire();
+    if (!t) t = mapTile(n);
+    return t+((x&(TileSize-1))+((y&(TileSize-1))<<TileShift))*bpp;
+  }
+  void unmapTile(int n);
+
+  QSize dataSize;
+  int bpp;
+  int across;
+  int down;
+  int tileBytes;
+
+  // row-major, not owned
+  const uchar* rawData;
+  int rawStride;
+
+  // tile-major, either in ownData or in file
+  QByteArray ownData;
+  QFile* file;
+  QAtomicPointer<uchar>* tileMap;
+  QAtomicInt* tileStamp;
+  QMutex mapMutex;
+  // Zeroed replacements of tiles that could not be mapped, one per tile
+  QHash<int, QByteArray> failedTiles;
+  QAtomicInt mapFailed;
+};
+
+template <typename T> void TiledImageStore::sampleLine(T* dst, const QPointF& p, const QPointF& dx, int count, T outside) {
+  const double scale = 4294967296.0;
+  qint64 fx = static_cast<qint64>(std::floor(p.x()*scale));
+  qint64 fy = static_cast<qint64>(std::floor(p.y()*scale));
+  qint64 sx = static_cast<qint64>(std::floor(dx.x()*scale+0.5));
+  qint64 sy = static_cast<qint64>(std::floor(dx.y()*scale+0.5));
+  int cachedTile = -1;
+  const uchar* tileData = nullptr;
+  for (int i=0; i<count; i++, fx+=sx, fy+=sy) {
+    qint64 x = fx>>32;
+    qint64 y = fy>>32;
+    if (x<0 || x>=dataSize.width() || y<0 || y>=dataSize.height()) {
+      dst[i] = outside;
+    } else if (rawData) {
+      dst[i] = *reinterpret_cast<const T*>(rawData+y*rawStride+x*bpp);
+    } else {
+      // consecutive samples mostly hit the same tile
+      int n = (x>>TileShift)+(y>>TileShift)*across;
+      if (n!=cachedTile) {
+        tileData = tileMap[n].loadAcquire();
+        if (!tileData) tileData = mapTile(n);
+        cachedTile = n;
+      }
+      dst[i] = *reinterpret_cast<const T*>(tileData+((x&(TileSize-1))+((y&(TileSize-1))<<TileShift))*bpp);
+    }
+  }
+}
+
+#endif // TILEDIMAGESTORE_H
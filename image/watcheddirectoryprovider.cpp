@@ -0,0 +1,274 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "watcheddirectoryprovider.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QtConcurrentRun>
+
+#include "image/dataproviderfactory.h"
+#include "image/imagedatastore.h"
+#include "tools/trace.h"
+
+
+const char WatchedDirectoryProvider::Info_WatchedDirectory[] = "Watched Directory";
+const char WatchedDirectoryProvider::Info_IngestLatency[] = "Ingest Latency";
+
+
+WatchedDirectoryProvider::WatchedDirectoryProvider(const QString& dir, DataProvider* first, QObject* _parent) :
+    DataProvider(_parent),
+    directory(dir),
+    watcher(nullptr),
+    debounceTimer(nullptr),
+    decoder(nullptr),
+    decoding(false),
+    current(first),
+    handedOut(nullptr),
+    pending(nullptr),
+    lastLatency(-1)
+{
+  foreach (QString f, imageFiles(directory)) {
+    seenFiles.insert(f, QFileInfo(f).lastModified());
+  }
+  // The factory runs in a worker thread, start watching after moving to the final thread
+  QMetaObject::invokeMethod(this, "startWatching", Qt::QueuedConnection);
+}
+
+WatchedDirectoryProvider::~WatchedDirectoryProvider() {
+  if (decoding) {
+    decoder->waitForFinished();
+    delete decoder->result();
+  }
+  delete current;
+  delete handedOut;
+  delete pending;
+}
+
+QStringList WatchedDirectoryProvider::Factory::fileFormatFilters() {
+  // Directories are not selected via file name filters
+  return QStringList();
+}
+
+DataProvider* WatchedDirectoryProvider::Factory::getProvider(QString filename, ImageDataStore* store, QObject* _parent) {
+  QFileInfo info(filename);
+  if (!info.isDir() || !info.isReadable()) return nullptr;
+
+  // Start with the newest frame, which is assumed to be complete
+  foreach (QString f, imageFiles(info.canonicalFilePath())) {
+    DataProvider* first = DataProviderFactory::getInstance().loadImage(f, store);
+    if (first) {
+      return new WatchedDirectoryProvider(info.canonicalFilePath(), first, _parent);
+    }
+  }
+  return nullptr;
+}
+
+QStringList WatchedDirectoryProvider::imageFiles(const QString& dir) {
+  QStringList filters;
+  foreach (QString suffix, DataProviderFactory::getInstance().registeredImageFormats()) {
+    filters << "*."+suffix;
+  }
+  QStringList files;
+  // Newest first
+  foreach (QFileInfo info, QDir(dir).entryInfoList(filters, QDir::Files|QDir::Readable, QDir::Time)) {
+    files << info.absoluteFilePath();
+  }
+  return files;
+}
+
+void WatchedDirectoryProvider::startWatching() {
+  watcher = new QFileSystemWatcher(this);
+  connect(watcher, SIGNAL(directoryChanged(QString)), this, SLOT(directoryChanged()));
+  watcher->addPath(directory);
+
+  debounceTimer = new QTimer(this);
+  debounceTimer->setSingleShot(true);
+  debounceTimer->setInterval(DebounceInterval);
+  connect(debounceTimer, SIGNAL(timeout()), this, SLOT(checkCandidates()));
+
+  decoder = new QFutureWatcher<DataProvider*>(this);
+  connect(decoder, SIGNAL(finished()), this, SLOT(frameDecoded()));
+}
+
+void WatchedDirectoryProvider::directoryChanged() {
+  foreach (QString f, imageFiles(directory)) {
+    QFileInfo info(f);
+    if (seenFiles.value(f)==info.lastModified() || candidates.contains(f)) continue;
+    Candidate c;
+    c.size = info.size();
+    c.modified = info.lastModified();
+    c.detected.start();
+    candidates.insert(f, c);
+  }
+  if (!candidates.isEmpty() && !debounceTimer->isActive()) debounceTimer->start();
+}
+
+void WatchedDirectoryProvider::checkCandidates() {
+  // A file is ready, if it did not change during one debounce interval
+  QString newest;
+  QDateTime newestTime;
+  QStringList ready;
+  for (QMap<QString, Candidate>::iterator it=candidates.begin(); it!=candidates.end(); ++it) {
+    QFileInfo info(it.key());
+    if (!info.exists()) {
+      ready << it.key();
+    } else if (info.size()==it.value().size && info.lastModified()==it.value().modified && info.size()>0) {
+      ready << it.key();
+      if (newest.isEmpty() || it.value().modified>newestTime) {
+        newest = it.key();
+        newestTime = it.value().modified;
+      }
+    } else {
+      it.value().size = info.size();
+      it.value().modified = info.lastModified();
+    }
+  }
+
+  // Only the newest frame is shown, older ones are skipped
+  QElapsedTimer detected;
+  if (!newest.isEmpty()) detected = candidates.value(newest).detected;
+  foreach (QString f, ready) {
+    if (f!=newest) seenFiles.insert(f, candidates.value(f).modified);
+    candidates.remove(f);
+  }
+  if (!newest.isEmpty()) {
+    if (decoding) {
+      queuedFrame = newest;
+      queuedFrameDetected = detected;
+    } else {
+      startDecoding(newest, detected);
+    }
+  }
+  if (!candidates.isEmpty()) debounceTimer->start();
+}
+
+DataProvider* WatchedDirectoryProvider::decodeFrame(QString filename, QThread* target) {
+  CLIP_TRACE("WatchedDirectoryProvider::decodeFrame");
+  ImageDataStore store;
+  DataProvider* dp = DataProviderFactory::getInstance().loadImage(filename, &store);
+  if (dp) dp->moveToThread(target);
+  return dp;
+}
+
+void WatchedDirectoryProvider::startDecoding(const QString& filename, const QElapsedTimer& detected) {
+  decoding = true;
+  decodingFrameDetected = detected;
+  decoder->setFuture(QtConcurrent::run(&WatchedDirectoryProvider::decodeFrame, filename, thread()));
+}
+
+void WatchedDirectoryProvider::frameDecoded() {
+  decoding = false;
+  DataProvider* dp = decoder->result();
+  if (dp) {
+    // Mark all files of the frame as seen (e.g. the .inf and .img of BAS files)
+    QString path = dp->getProviderInfo(Info_ImagePath).toString();
+    QString base = QFileInfo(path).completeBaseName();
+    foreach (QString f, imageFiles(directory)) {
+      if (QFileInfo(f).completeBaseName()==base) seenFiles.insert(f, QFileInfo(f).lastModified());
+    }
+    delete pending;
+    pending = dp;
+    pendingDetected = decodingFrameDetected;
+    emit newDataAvailable();
+  }
+  if (!queuedFrame.isEmpty()) {
+    QString f = queuedFrame;
+    queuedFrame.clear();
+    startDecoding(f, queuedFrameDetected);
+  }
+}
+
+DataProvider* WatchedDirectoryProvider::nextFrame() {
+  // The consumer has to switch to the last frame before it gets a new one
+  if (handedOut || !pending) return nullptr;
+  handedOut = pending;
+  handedOutDetected = pendingDetected;
+  pending = nullptr;
+  return handedOut;
+}
+
+void WatchedDirectoryProvider::loadNewData() {
+  if (!handedOut) return;
+  delete current;
+  current = handedOut;
+  handedOut = nullptr;
+  lastLatency = handedOutDetected.elapsed();
+}
+
+void WatchedDirectoryProvider::rejectFrame() {
+  // Keep showing the current frame, but accept the next one
+  delete handedOut;
+  handedOut = nullptr;
+}
+
+const void* WatchedDirectoryProvider::getData() {
+  return current->getData();
+}
+
+TiledImageStore* WatchedDirectoryProvider::tiles() {
+  return current->tiles();
+}
+
+QSize WatchedDirectoryProvider::size() {
+  return current->size();
+}
+
+qint64 WatchedDirectoryProvider::bytesCount() {
+  return current->bytesCount();
+}
+
+int WatchedDirectoryProvider::pixelCount() {
+  return current->pixelCount();
+}
+
+DataProvider::Format WatchedDirectoryProvider::format() {
+  return current->format();
+}
+
+QString WatchedDirectoryProvider::name() {
+  return current->name();
+}
+
+QList<QWidget*> WatchedDirectoryProvider::toolboxPages() {
+  return current->toolboxPages();
+}
+
+QVariant WatchedDirectoryProvider::getProviderInfo(const QString& key) {
+  if (key==Info_WatchedDirectory || key==Info_ImagePath) {
+    // The workspace reopens the directory, not the current frame
+    return directory;
+  } else if (key==Info_IngestLatency) {
+    return (lastLatency<0) ? QVariant() : QVariant(QString("%1 ms").arg(lastLatency));
+  }
+  return current->getProviderInfo(key);
+}
+
+QList<QString> WatchedDirectoryProvider::getProviderInfoKeys() {
+  QList<QString> keys = current->getProviderInfoKeys();
+  keys << Info_WatchedDirectory;
+  if (lastLatency>=0) keys << Info_IngestLatency;
+  return keys;
+}
+
+bool WatchedDirectoryRegisterOK = DataProviderFactory::registerImageLoader<WatchedDirectoryProvider::Factory>(0);
@@ -0,0 +1,115 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef WATCHEDDIRECTORYPROVIDER_H
+#define WATCHEDDIRECTORYPROVIDER_H
+
+#include <QMap>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QPointer>
+#include <QTimer>
+#include <QThread>
+
+#include "image/dataprovider.h"
+
+class QFileSystemWatcher;
+
+// Follows an acquisition directory. New image files are debounced until
+// their size and modification time are stable, decoded in the background
+// and offered via newDataAvailable(). The consumer fetches the decoded
+// frame with nextFrame(), prepares its display and switches to it with
+// loadNewData().
+class WatchedDirectoryProvider : public DataProvider
+{
+  Q_OBJECT
+public:
+  class Factory: public DataProvider::ImageFactoryClass {
+  public:
+    Factory() {}
+    QStringList fileFormatFilters();
+    DataProvider* getProvider(QString, ImageDataStore*, QObject* = nullptr);
+  };
+  virtual ~WatchedDirectoryProvider();
+
+  virtual void loadNewData();
+  virtual DataProvider* nextFrame();
+  virtual void rejectFrame();
+  virtual const void* getData();
+  virtual TiledImageStore* tiles();
+  virtual QSize size();
+  virtual qint64 bytesCount();
+  virtual int pixelCount();
+  virtual Format format();
+  virtual QString name();
+  virtual QList<QWidget*> toolboxPages();
+  virtual QVariant getProviderInfo(const QString& key);
+  virtual QList<QString> getProviderInfoKeys();
+
+  static const char Info_WatchedDirectory[];
+  static const char Info_IngestLatency[];
+  static const int DebounceInterval = 250;
+
+private slots:
+  void startWatching();
+  void directoryChanged();
+  void checkCandidates();
+  void frameDecoded();
+private:
+  explicit WatchedDirectoryProvider(const QString& dir, DataProvider* first, QObject* _parent = nullptr);
+  WatchedDirectoryProvider(const WatchedDirectoryProvider&);
+  WatchedDirectoryProvider& operator=(const WatchedDirectoryProvider&);
+
+  static QStringList imageFiles(const QString& dir);
+  static DataProvider* decodeFrame(QString filename, QThread* target);
+  void startDecoding(const QString& filename, const QElapsedTimer& detected);
+
+  struct Candidate {
+    qint64 size;
+    QDateTime modified;
+    QElapsedTimer detected;
+  };
+
+  QString directory;
+  // Created in startWatching(), thus living in the thread of the provider
+  QFileSystemWatcher* watcher;
+  QTimer* debounceTimer;
+  QMap<QString, Candidate> candidates;
+  QMap<QString, QDateTime> seenFiles;
+
+  QFutureWatcher<DataProvider*>* decoder;
+  bool decoding;
+  QElapsedTimer decodingFrameDetected;
+  QString queuedFrame;
+  QElapsedTimer queuedFrameDetected;
+
+  // Frame shown, frame handed out via nextFrame() and latest decoded frame
+  DataProvider* current;
+  DataProvider* handedOut;
+  DataProvider* pending;
+  QElapsedTimer handedOutDetected;
+  QElapsedTimer pendingDetected;
+  qint64 lastLatency;
+};
+
+#endif // WATCHEDDIRECTORYPROVIDER_H
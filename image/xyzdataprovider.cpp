@@ -90,8 +90,8 @@ QSize XYZDataProvider::size() {
   return QSize(imgWidth, imgHeight);
 }
 
-int XYZDataProvider::bytesCount() {
-  return pixelData.size()*sizeof(float);
+qint64 XYZDataProvider::bytesCount() {
+  return qint64(pixelData.size())*sizeof(float);
 }
 
 int XYZDataProvider::pixelCount() {
@@ -110,4 +110,4 @@ void XYZDataProvider::loadFromXML(QDomElement) {
 
 }
 
-bool XYZRegisterOK = DataProviderFactory::registerImageLoader(192, new XYZDataProvider::Factory());
+bool XYZRegisterOK = DataProviderFactory::registerImageLoader<XYZDataProvider::Factory>(192);
@@ -44,7 +44,7 @@ public:
   virtual void loadFromXML(QDomElement);
   virtual const void* getData();
   virtual QSize size();
-  virtual int bytesCount();
+  virtual qint64 bytesCount();
   virtual int pixelCount();
   virtual Format format();
 private:
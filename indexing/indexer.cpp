@@ -34,6 +34,7 @@
 #include "tools/mat3D.h"
 #include "tools/optimalrotation.h"
 #include "indexing/marker.h"
+#include "tools/trace.h"
 
 
 
@@ -84,6 +85,7 @@ Indexer::~Indexer() {
 }
 
 void Indexer::run() {
+  CLIP_TRACE("Indexer::run");
   runningThreads.ref();
 
   ThreadLocalData localData;
@@ -258,3 +260,10 @@ bool Indexer::AngleInfo::operator<(const AngleInfo& o) const {
 void Indexer::stop() {
   shouldStop=true;
 }
+
+QList<Solution> Indexer::solutions() {
+  uniqLock.lockForRead();
+  QList<Solution> s = uniqSolutions;
+  uniqLock.unlock();
+  return s;
+}
@@ -57,6 +57,9 @@ public:
   void run();
   void operator()() { run(); }
 
+  // All distinct solutions found so far
+  QList<Solution> solutions();
+
 public slots:
   void stop();
 
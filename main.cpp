@@ -25,6 +25,9 @@
 #include <cmath>
  
 #include "ui/clip.h"
+#include "batch/batchprocessor.h"
+#include "tools/trace.h"
+#include "tools/startuptiming.h"
 
 
 #ifdef CLIP_STATIC
@@ -43,16 +46,34 @@ Q_IMPORT_PLUGIN(qsvg)
 
 
 int main(int argc, char *argv[]) {
+  StartupTiming::init(argc, argv);
+  Trace::startFromEnvironment();
+  bool batch = BatchProcessor::isBatchCall(argc, argv);
+  // The batch mode shows no windows and must run without a display
+  if (batch && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+
   QApplication a(argc, argv);
+  StartupTiming::mark("Application created");
 
   a.setApplicationName("Clip");
   a.setOrganizationDomain("clip4.sf.net");
   a.setOrganizationName("O.J.Schumann");
 
+  if (batch) {
+    BatchProcessor processor;
+    int r = processor.run(a.arguments());
+    Trace::finishFromEnvironment();
+    return r;
+  }
+
   Clip* w = Clip::getInstance();
+  StartupTiming::mark("Main window created");
   w->show();
+  StartupTiming::mark("Main window shown");
   int r = a.exec();
   Clip::clearInstance();
+  Trace::finishFromEnvironment();
   return r;
 }
 
@@ -24,7 +24,6 @@
 #define FITPARAMETER_H
 
 #include <QObject>
-#include <QTreeWidgetItem>
 
 #include "refinement/fitparametergroup.h"
 
@@ -33,11 +33,13 @@
 #include "core/projector.h"
 #include "refinement/fitparameter.h"
 #include "refinement/fitparametergroup.h"
+#include "tools/trace.h"
 
 
 NelderMead::NelderMead(Crystal* c, QObject* _parent) :
     QObject(_parent),
     liveCrystal(c),
+    lastScore(-1.0),
     shouldStop(false)
 {
   connect(&threadWatcher, SIGNAL(finished()), this, SIGNAL(finished()));
@@ -65,7 +67,18 @@ bool NelderMead::isRunning() {
   return threadWatcher.isRunning();
 }
 
+double NelderMead::fit() {
+  if (threadWatcher.isRunning()) return -1.0;
+  shouldStop = false;
+  lastScore = -1.0;
+  run();
+  if (lastScore>=0.0)
+    setBestSolutionToLiveCrystal(lastSolution, lastDeviation);
+  return lastScore;
+}
+
 void NelderMead::run() {
+  CLIP_TRACE("NelderMead::run");
   NMWorker* worker = new NMWorker(liveCrystal);
   if (worker->valid()) {
     int loops = 0;
@@ -100,6 +113,11 @@ void NelderMead::run() {
       }
     }
   }
+  if (worker->valid()) {
+    lastSolution = worker->bestSolution();
+    lastDeviation = worker->calcDeviation();
+    lastScore = worker->bestScore();
+  }
   emit bestSolutionScore(worker->bestScore());
   emit bestSolution(worker->bestSolution(), worker->calcDeviation());
   delete worker;
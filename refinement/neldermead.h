@@ -45,6 +45,9 @@ public:
   explicit NelderMead(Crystal* c, QObject* _parent = nullptr);
   virtual ~NelderMead();
   bool isRunning();
+  // Fits in the calling thread and applies the result to the crystal.
+  // Returns the final score, or -1 if there is nothing to fit.
+  double fit();
 public slots:
   void start();
   void stop();
@@ -62,6 +65,11 @@ protected:
   // Crystal, that is used in the UI
   Crystal* liveCrystal;
 
+  // Result of the last run
+  QList<double> lastSolution;
+  QList<double> lastDeviation;
+  double lastScore;
+
   QFutureWatcher<void> threadWatcher;
   QReadWriteLock threadLock;
   bool shouldStop;
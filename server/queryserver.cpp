@@ -0,0 +1,445 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "server/queryserver.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+
+#include "core/crystal.h"
+#include "core/projector.h"
+#include "core/reflection.h"
+#include "image/laueimage.h"
+#include "image/imagedatastore.h"
+#include "ui/clip.h"
+#include "ui/reorient.h"
+
+const char QueryServer::DefaultName[] = "clip-query";
+
+static void setupStream(QDataStream& s) {
+  s.setByteOrder(QDataStream::LittleEndian);
+  s.setFloatingPointPrecision(QDataStream::DoublePrecision);
+}
+
+QueryServer::QueryServer(QObject* _parent):
+    QObject(_parent),
+    server(new QLocalServer(this)),
+    buffers(),
+    crystal(),
+    latencies(OpcodeCount)
+{
+  server->setSocketOptions(QLocalServer::UserAccessOption);
+  connect(server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+QueryServer::~QueryServer() {
+  close();
+}
+
+bool QueryServer::listen(const QString& name) {
+  close();
+  if (server->listen(name)) return true;
+  if (server->serverError()!=QAbstractSocket::AddressInUseError) return false;
+
+  // A socket file is left over if a previous instance crashed. Only remove it
+  // if nobody answers on it.
+  QLocalSocket probe;
+  probe.connectToServer(name);
+  if (probe.waitForConnected(100)) return false;
+  QLocalServer::removeServer(name);
+  return server->listen(name);
+}
+
+void QueryServer::close() {
+  foreach (QLocalSocket* s, buffers.keys()) {
+    s->disconnect(this);
+    s->abort();
+    s->deleteLater();
+  }
+  buffers.clear();
+  server->close();
+}
+
+bool QueryServer::isListening() const {
+  return server->isListening();
+}
+
+QString QueryServer::serverName() const {
+  return server->fullServerName();
+}
+
+void QueryServer::setCrystal(Crystal* c) {
+  crystal = c;
+}
+
+Crystal* QueryServer::getCrystal() {
+  if (crystal.isNull())
+    crystal = Clip::getInstance()->getMostRecentCrystal(true);
+  return crystal;
+}
+
+void QueryServer::newConnection() {
+  while (QLocalSocket* s = server->nextPendingConnection()) {
+    buffers.insert(s, QByteArray());
+    connect(s, SIGNAL(readyRead()), this, SLOT(readRequests()));
+    connect(s, SIGNAL(disconnected()), this, SLOT(connectionClosed()));
+  }
+}
+
+void QueryServer::connectionClosed() {
+  QLocalSocket* s = qobject_cast<QLocalSocket*>(sender());
+  if (s==nullptr) return;
+  buffers.remove(s);
+  s->deleteLater();
+}
+
+void QueryServer::readRequests() {
+  QLocalSocket* s = qobject_cast<QLocalSocket*>(sender());
+  if (s==nullptr || !buffers.contains(s)) return;
+
+  QByteArray& buffer = buffers[s];
+  buffer.append(s->readAll());
+
+  // Answer every complete request in the buffer and send all responses at once
+  QByteArray responses;
+  int pos = 0;
+  bool broken = false;
+  while (buffer.size()-pos>=4) {
+    quint32 length = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(buffer.constData()+pos));
+    if (length<5 || length>MaxFrameSize) {
+      broken = true;
+      break;
+    }
+    if (static_cast<quint32>(buffer.size()-pos-4)<length) break;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QByteArray request = QByteArray::fromRawData(buffer.constData()+pos+4, length);
+    QDataStream in(request);
+    setupStream(in);
+    quint32 id;
+    quint8 opcode;
+    in >> id >> opcode;
+
+    QByteArray result;
+    QDataStream out(&result, QIODevice::WriteOnly);
+    setupStream(out);
+    quint8 status = handleRequest(opcode, in, out);
+    if (status!=Ok) result.clear();
+
+    QByteArray header;
+    QDataStream h(&header, QIODevice::WriteOnly);
+    setupStream(h);
+    h << static_cast<quint32>(5+result.size()) << id << status;
+    responses.append(header);
+    responses.append(result);
+
+    recordLatency(opcode, timer.nsecsElapsed());
+    pos += 4+length;
+  }
+
+  if (broken) {
+    // The stream cannot be resynchronized after a bad frame length
+    buffers.remove(s);
+    s->disconnect(this);
+    s->abort();
+    s->deleteLater();
+    return;
+  }
+  buffer.remove(0, pos);
+  if (!responses.isEmpty())
+    s->write(responses);
+}
+
+quint8 QueryServer::handleRequest(quint8 opcode, QDataStream& in, QDataStream& out) {
+  switch (opcode) {
+  case Ping:
+    return Ok;
+  case Project:
+    return project(in, out);
+  case Unproject:
+    return unproject(in, out);
+  case ClosestReflection:
+    return closestReflection(in, out);
+  case ReorientSolutions:
+    return reorientSolutions(in, out);
+  case Statistics:
+    writeStatistics(out);
+    return Ok;
+  }
+  return UnknownOpcode;
+}
+
+Mat3D QueryServer::readOrientation(QDataStream& in, Crystal* c) {
+  quint8 flags;
+  in >> flags;
+  if (flags & HasOrientation) {
+    double m[9];
+    for (int i=0; i<9; i++) in >> m[i];
+    return Mat3D(m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8]);
+  }
+  return c->getRotationMatrix();
+}
+
+Vec3D QueryServer::readVector(QDataStream& in) {
+  double x, y, z;
+  in >> x >> y >> z;
+  return Vec3D(x, y, z);
+}
+
+Projector* QueryServer::projectorAt(Crystal* c, int index) {
+  QList<Projector*> projectors = c->getConnectedProjectors();
+  if (index<0 || index>=projectors.size()) return nullptr;
+  return projectors.at(index);
+}
+
+bool QueryServer::toDetector(Projector* p, quint8 coordinates, const QPointF& in, QPointF& det) {
+  QPointF img(in);
+  if (coordinates==DetectorCoordinates) {
+    det = in;
+    return true;
+  } else if (coordinates==PixelCoordinates) {
+    LaueImage* image = p->getLaueImage();
+    if (image==nullptr || !image->data()->hasData(ImageDataStore::PixelSize)) return false;
+    QSizeF s = image->data()->getTransformedSizeData(ImageDataStore::PixelSize);
+    img = QPointF(in.x()/s.width(), in.y()/s.height());
+  } else if (coordinates!=ImageCoordinates) {
+    return false;
+  }
+  // Image coordinates count from the top left corner, like the mouse info
+  img.ry() = 1.0-img.y();
+  det = p->img2det.map(img);
+  return true;
+}
+
+bool QueryServer::fromDetector(Projector* p, quint8 coordinates, const QPointF& det, QPointF& out) {
+  if (coordinates==DetectorCoordinates) {
+    out = det;
+    return true;
+  }
+  QPointF img = p->det2img.map(det);
+  img.ry() = 1.0-img.y();
+  if (coordinates==ImageCoordinates) {
+    out = img;
+    return true;
+  } else if (coordinates==PixelCoordinates) {
+    LaueImage* image = p->getLaueImage();
+    if (image==nullptr || !image->data()->hasData(ImageDataStore::PixelSize)) return false;
+    QSizeF s = image->data()->getTransformedSizeData(ImageDataStore::PixelSize);
+    out = QPointF(img.x()*s.width(), img.y()*s.height());
+    return true;
+  }
+  return false;
+}
+
+// flags, [orientation], qint32 projector, quint8 coordinates, qint32 h, k, l
+//   -> double x, y, double Q, quint8 diffracting
+quint8 QueryServer::project(QDataStream& in, QDataStream& out) {
+  Crystal* c = getCrystal();
+  if (c==nullptr) return NoCrystal;
+  Mat3D R = readOrientation(in, c);
+  qint32 index, h, k, l;
+  quint8 coordinates;
+  in >> index >> coordinates >> h >> k >> l;
+  if (in.status()!=QDataStream::Ok || (h==0 && k==0 && l==0)) return Malformed;
+  Projector* p = projectorAt(c, index);
+  if (p==nullptr) return NoProjector;
+
+  Reflection r = c->makeReflection(TVec3D<int>(h, k, l));
+  Vec3D normal = R*r.normalLocal;
+  bool ok = false;
+  QPointF det = p->normal2det(normal, ok);
+  if (!ok) return NoSolution;
+  QPointF pos;
+  if (!fromDetector(p, coordinates, det, pos)) return NoImage;
+
+  // Same condition as in Crystal::UpdateRef, but for the Q range of this projector
+  bool diffracting = false;
+  if (normal.x()>0.0) {
+    double Qscatter = r.Q/normal.x();
+    foreach (int o, r.orders)
+      if (o*Qscatter>=2.0*p->Qmin() && o*Qscatter<=2.0*p->Qmax()) diffracting = true;
+  }
+  out << pos.x() << pos.y() << r.Q << static_cast<quint8>(diffracting);
+  return Ok;
+}
+
+// flags, [orientation], qint32 projector, quint8 coordinates, double x, y
+//   -> double normal x, y, z (lab system), double h, k, l (largest is +-1)
+quint8 QueryServer::unproject(QDataStream& in, QDataStream& out) {
+  Crystal* c = getCrystal();
+  if (c==nullptr) return NoCrystal;
+  Mat3D R = readOrientation(in, c);
+  qint32 index;
+  quint8 coordinates;
+  double x, y;
+  in >> index >> coordinates >> x >> y;
+  if (in.status()!=QDataStream::Ok) return Malformed;
+  Projector* p = projectorAt(c, index);
+  if (p==nullptr) return NoProjector;
+
+  QPointF det;
+  if (!toDetector(p, coordinates, QPointF(x, y), det)) return NoImage;
+  bool ok = false;
+  Vec3D normal = p->det2normal(det, ok);
+  if (!ok) return NoSolution;
+
+  Vec3D hkl = c->getReziprocalOrientationMatrix().inverse()*(R.transposed()*normal);
+  double m = std::max(std::fabs(hkl.x()), std::max(std::fabs(hkl.y()), std::fabs(hkl.z())));
+  if (m>0.0) hkl *= 1.0/m;
+  out << normal.x() << normal.y() << normal.z() << hkl.x() << hkl.y() << hkl.z();
+  return Ok;
+}
+
+// flags, [orientation], qint32 projector, quint8 coordinates, double x, y
+//   -> qint32 h, k, l, double Q, d, double distance (deg), double x, y of the reflection
+quint8 QueryServer::closestReflection(QDataStream& in, QDataStream& out) {
+  Crystal* c = getCrystal();
+  if (c==nullptr) return NoCrystal;
+  Mat3D R = readOrientation(in, c);
+  qint32 index;
+  quint8 coordinates;
+  double x, y;
+  in >> index >> coordinates >> x >> y;
+  if (in.status()!=QDataStream::Ok) return Malformed;
+  Projector* p = projectorAt(c, index);
+  if (p==nullptr) return NoProjector;
+
+  QPointF det;
+  if (!toDetector(p, coordinates, QPointF(x, y), det)) return NoImage;
+  bool ok = false;
+  Vec3D normal = p->det2normal(det, ok);
+  if (!ok) return NoSolution;
+
+  // Compare in the crystal system, so the reflection list of the crystal is
+  // valid for any orientation. Like Crystal::getClosestReflection otherwise.
+  Vec3D local = R.transposed()*normal;
+  QVector<Reflection> refs = c->getReflectionList();
+  int minIdx = -1;
+  double minDist = 0;
+  for (int n=refs.size(); n--; ) {
+    double dist = (refs[n].normalLocal-local).norm_sq();
+    if (dist<minDist || minIdx<0) {
+      minDist = dist;
+      minIdx = n;
+    }
+  }
+  if (minIdx<0) return NoSolution;
+
+  const Reflection& r = refs.at(minIdx);
+  Vec3D refNormal = R*r.normalLocal;
+  QPointF pos(qQNaN(), qQNaN());
+  QPointF refDet = p->normal2det(refNormal, ok);
+  if (ok) fromDetector(p, coordinates, refDet, pos);
+  double distance = 180.0*M_1_PI*std::acos(std::min(1.0, std::max(-1.0, refNormal*normal)));
+  out << static_cast<qint32>(r.h) << static_cast<qint32>(r.k) << static_cast<qint32>(r.l);
+  out << r.Q << r.d << distance << pos.x() << pos.y();
+  return Ok;
+}
+
+// flags, [orientation], quint8 from type, double from[3], quint8 to type, double to[3],
+// double axis1[3], double axis2[3]
+//   -> quint8 n, n*(double angle1, angle2) in deg, smallest rotation first
+// Types: 0 lab system, 1 reciprocal (hkl), 2 direct (uvw)
+quint8 QueryServer::reorientSolutions(QDataStream& in, QDataStream& out) {
+  Crystal* c = getCrystal();
+  if (c==nullptr) return NoCrystal;
+  Mat3D R = readOrientation(in, c);
+  quint8 fromType, toType;
+  Vec3D from, to, axis1, axis2;
+  in >> fromType;
+  from = readVector(in);
+  in >> toType;
+  to = readVector(in);
+  axis1 = readVector(in);
+  axis2 = readVector(in);
+  if (in.status()!=QDataStream::Ok || fromType>2 || toType>2) return Malformed;
+  if (from.isNull() || to.isNull() || axis1.isNull() || axis2.isNull()) return Malformed;
+
+  Mat3D toLab[3] = { Mat3D(), R*c->getReziprocalOrientationMatrix(), R*c->getRealOrientationMatrix() };
+  Vec3D nfrom = (toLab[fromType]*from).normalized();
+  Vec3D nto = (toLab[toType]*to).normalized();
+
+  typedef QPair<double, double> AnglePair;
+  QList<AnglePair> solutions = Reorient::calcRotationSolutions(axis1.normalized(), axis2.normalized(), nfrom, nto);
+  if (solutions.isEmpty()) return NoSolution;
+  std::sort(solutions.begin(), solutions.end(), [](const AnglePair& a, const AnglePair& b) {
+    return a.first*a.first+a.second*a.second < b.first*b.first+b.second*b.second;
+  });
+
+  out << static_cast<quint8>(solutions.size());
+  foreach (AnglePair a, solutions)
+    out << 180.0*M_1_PI*a.first << 180.0*M_1_PI*a.second;
+  return Ok;
+}
+
+// -> quint8 n, n*(quint8 opcode, quint64 count, double p50, p99 in us)
+void QueryServer::writeStatistics(QDataStream& out) const {
+  out << static_cast<quint8>(OpcodeCount);
+  for (int n=0; n<OpcodeCount; n++) {
+    out << static_cast<quint8>(n) << static_cast<quint64>(requestCount(n));
+    out << latencyPercentile(n, 0.5) << latencyPercentile(n, 0.99);
+  }
+}
+
+void QueryServer::recordLatency(quint8 opcode, qint64 nsecs) {
+  if (opcode>=OpcodeCount) return;
+  Latencies& l = latencies[opcode];
+  if (l.samples.size()<LatencySamples) {
+    l.samples << nsecs;
+  } else {
+    l.samples[l.next] = nsecs;
+  }
+  l.next = (l.next+1)%LatencySamples;
+  l.count++;
+}
+
+double QueryServer::latencyPercentile(int opcode, double p) const {
+  if (opcode<0 || opcode>=OpcodeCount) return 0.0;
+  QVector<qint64> s = latencies.at(opcode).samples;
+  if (s.isEmpty()) return 0.0;
+  int n = std::min(s.size()-1, std::max(0, static_cast<int>(std::ceil(p*s.size()))-1));
+  std::nth_element(s.begin(), s.begin()+n, s.end());
+  return 1e-3*s.at(n);
+}
+
+qint64 QueryServer::requestCount(int opcode) const {
+  if (opcode<0 || opcode>=OpcodeCount) return 0;
+  return latencies.at(opcode).count;
+}
+
+QString QueryServer::statistics() const {
+  static const char* names[OpcodeCount] = { "Ping", "Project", "Unproject", "ClosestReflection", "ReorientSolutions", "Statistics" };
+  QString s("Query server latencies (us, last %1 requests):");
+  s = s.arg(LatencySamples);
+  for (int n=0; n<OpcodeCount; n++) {
+    if (requestCount(n)==0) continue;
+    s += QString("\n  %1: %2 requests, p50 %3, p99 %4").arg(names[n]).arg(requestCount(n)).arg(latencyPercentile(n, 0.5), 0, 'f', 1).arg(latencyPercentile(n, 0.99), 0, 'f', 1);
+  }
+  return s;
+}
@@ -0,0 +1,145 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef QUERYSERVER_H
+#define QUERYSERVER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+#include <QPointF>
+#include <QString>
+
+#include "tools/vec3D.h"
+#include "tools/mat3D.h"
+
+class QLocalServer;
+class QLocalSocket;
+class QDataStream;
+class Crystal;
+class Projector;
+
+// Answers projection queries of other programs on a local socket.
+//
+// Requests and responses are frames that start with the quint32 length of
+// the rest of the frame. Integers are little endian, doubles IEEE binary64.
+//   request:  length, quint32 id, quint8 opcode, arguments
+//   response: length, quint32 id, quint8 status, results (only if Ok)
+// Clients may send further requests before the responses arrive, these are
+// answered in order. The arguments of the opcodes are listed in README.md.
+class QueryServer: public QObject {
+  Q_OBJECT
+public:
+  enum Opcode {
+    Ping,
+    Project,
+    Unproject,
+    ClosestReflection,
+    ReorientSolutions,
+    Statistics,
+    OpcodeCount
+  };
+
+  enum Status {
+    Ok,
+    UnknownOpcode,
+    Malformed,
+    NoCrystal,
+    NoProjector,
+    NoImage,
+    NoSolution
+  };
+
+  // Coordinates of positions on a projector
+  enum Coordinates {
+    DetectorCoordinates,
+    ImageCoordinates,
+    PixelCoordinates
+  };
+
+  // Request flags
+  enum Flags {
+    // The request carries a rotation matrix that replaces the crystal orientation
+    HasOrientation = 1
+  };
+
+  static const char DefaultName[];
+  static const quint32 MaxFrameSize = 1024;
+  static const int LatencySamples = 4096;
+
+  explicit QueryServer(QObject* _parent=nullptr);
+  virtual ~QueryServer();
+
+  bool listen(const QString& name=DefaultName);
+  void close();
+  bool isListening() const;
+  QString serverName() const;
+
+  // Queries are answered for this crystal, projectors are addressed by their
+  // index in its connected projectors. Without a crystal set, the most recent
+  // crystal of the main window is taken at the first query.
+  void setCrystal(Crystal*);
+  Crystal* getCrystal();
+
+  // Processing time of the requests, in microseconds
+  double latencyPercentile(int opcode, double p) const;
+  qint64 requestCount(int opcode) const;
+  QString statistics() const;
+private slots:
+  void newConnection();
+  void readRequests();
+  void connectionClosed();
+private:
+  QueryServer(const QueryServer&);
+  QueryServer& operator=(const QueryServer&);
+
+  quint8 handleRequest(quint8 opcode, QDataStream& in, QDataStream& out);
+  quint8 project(QDataStream& in, QDataStream& out);
+  quint8 unproject(QDataStream& in, QDataStream& out);
+  quint8 closestReflection(QDataStream& in, QDataStream& out);
+  quint8 reorientSolutions(QDataStream& in, QDataStream& out);
+  void writeStatistics(QDataStream& out) const;
+
+  // Reads the flags and the optional orientation common to all queries
+  Mat3D readOrientation(QDataStream& in, Crystal* c);
+  Vec3D readVector(QDataStream& in);
+  Projector* projectorAt(Crystal* c, int index);
+  bool toDetector(Projector* p, quint8 coordinates, const QPointF& in, QPointF& det);
+  bool fromDetector(Projector* p, quint8 coordinates, const QPointF& det, QPointF& out);
+  void recordLatency(quint8 opcode, qint64 nsecs);
+
+  struct Latencies {
+    Latencies(): samples(), next(0), count(0) {}
+    QVector<qint64> samples;
+    int next;
+    qint64 count;
+  };
+
+  QLocalServer* server;
+  QHash<QLocalSocket*, QByteArray> buffers;
+  QPointer<Crystal> crystal;
+  QVector<Latencies> latencies;
+};
+
+#endif // QUERYSERVER_H
@@ -22,9 +22,9 @@
 
 #include "abstractmarkeritem.h"
 
-#include "tools/tools.h"
-#include "core/projector.h"
-#include "core/crystal.h"
+#include <algorithm>
+#include <cmath>
+#include <QtGlobal>
 
 AbstractMarkerItem::AbstractMarkerItem(MarkerType t):
   markerType(t)
@@ -108,73 +108,3 @@ void AbstractMarkerItem::invalidateCache() {
   angularDeviation = -1.0;
   detectorPositionDeviation = -1.0;
 }
-
-
-
-
-
-// #################################################
-
-AbstractProjectorMarkerItem::AbstractProjectorMarkerItem(Projector *p, MarkerType t):
-  AbstractMarkerItem(t),
-  projector(p)
-{
-}
-
-AbstractProjectorMarkerItem::~AbstractProjectorMarkerItem() = default;
-
-Vec3D AbstractProjectorMarkerItem::normalToIndex(const Vec3D &v) {
-  Vec3D n = projector->getCrystal()->getRotationMatrix().transposed() * v;
-  if (markerType==SpotMarker) {
-    // v = Rot * MRezi * hkl  => hkl = MRezi.inv * Rot.trans * v
-    return projector->getCrystal()->getRealOrientationMatrix().transposed() * n;
-  } else {
-    return projector->getCrystal()->getReziprocalOrientationMatrix().transposed() * n;
-  }
-}
-
-void AbstractProjectorMarkerItem::calcDetectorDeviation() {
-  if (markerType==SpotMarker) {
-    bool ok1, ok2;
-    QPointF p = projector->normal2det(getMarkerNormal(), ok1);
-    p -= projector->normal2det(projector->getCrystal()->hkl2Reziprocal(getIntegerIndex().toType<double>()).normalized(), ok2);
-    if (ok1 && ok2) {
-      detectorPositionDeviation = fasthypot(p.x(), p.y());
-    }
-  } else {
-    double score = 0.0;
-    int N = 0;
-    Vec3D n = getMarkerNormal();
-    QRectF plane(0, 0, 1, 1);
-    foreach (Reflection r, projector->getProjectedReflectionsNormalToZone(getIntegerIndex())) {
-      bool ok;
-      QPointF pSpot = projector->normal2det(r.normal, ok);
-      if (!ok || !plane.contains(projector->det2img.map(pSpot)))
-        continue;
-      Vec3D v = r.normal - n*(n*r.normal);
-      v.normalize();
-      QPointF pZone = projector->normal2det(v, ok);
-      if (ok) {
-        QPointF dp = pSpot - pZone;
-        score += fasthypot(dp.x(), dp.y());
-        N++;
-      }
-    }
-    if (N>0) {
-      detectorPositionDeviation = score/N;
-    } else {
-      detectorPositionDeviation = 0.0;
-    }
-  }
-}
-
-void AbstractProjectorMarkerItem::calcAngularDeviation() {
-  Vec3D n;
-  if (markerType==SpotMarker) {
-    n = projector->getCrystal()->hkl2Reziprocal(getIntegerIndex().toType<double>());
-  } else {
-    n = projector->getCrystal()->uvw2Real(getIntegerIndex().toType<double>());
-  }
-  angularDeviation = 180.0*M_1_PI*acos(n.normalized()*getMarkerNormal());
-}
-
@@ -0,0 +1,94 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "tools/abstractmarkeritem.h"
+
+#include <QRectF>
+
+#include "tools/tools.h"
+#include "core/projector.h"
+#include "core/crystal.h"
+#include "core/reflection.h"
+
+AbstractProjectorMarkerItem::AbstractProjectorMarkerItem(Projector *p, MarkerType t):
+  AbstractMarkerItem(t),
+  projector(p)
+{
+}
+
+AbstractProjectorMarkerItem::~AbstractProjectorMarkerItem() = default;
+
+Vec3D AbstractProjectorMarkerItem::normalToIndex(const Vec3D &v) {
+  Vec3D n = projector->getCrystal()->getRotationMatrix().transposed() * v;
+  if (markerType==SpotMarker) {
+    // v = Rot * MRezi * hkl  => hkl = MRezi.inv * Rot.trans * v
+    return projector->getCrystal()->getRealOrientationMatrix().transposed() * n;
+  } else {
+    return projector->getCrystal()->getReziprocalOrientationMatrix().transposed() * n;
+  }
+}
+
+void AbstractProjectorMarkerItem::calcDetectorDeviation() {
+  if (markerType==SpotMarker) {
+    bool ok1, ok2;
+    QPointF p = projector->normal2det(getMarkerNormal(), ok1);
+    p -= projector->normal2det(projector->getCrystal()->hkl2Reziprocal(getIntegerIndex().toType<double>()).normalized(), ok2);
+    if (ok1 && ok2) {
+      detectorPositionDeviation = fasthypot(p.x(), p.y());
+    }
+  } else {
+    double score = 0.0;
+    int N = 0;
+    Vec3D n = getMarkerNormal();
+    QRectF plane(0, 0, 1, 1);
+    foreach (Reflection r, projector->getProjectedReflectionsNormalToZone(getIntegerIndex())) {
+      bool ok;
+      QPointF pSpot = projector->normal2det(r.normal, ok);
+      if (!ok || !plane.contains(projector->det2img.map(pSpot)))
+        continue;
+      Vec3D v = r.normal - n*(n*r.normal);
+      v.normalize();
+      QPointF pZone = projector->normal2det(v, ok);
+      if (ok) {
+        QPointF dp = pSpot - pZone;
+        score += fasthypot(dp.x(), dp.y());
+        N++;
+      }
+    }
+    if (N>0) {
+      detectorPositionDeviation = score/N;
+    } else {
+      detectorPositionDeviation = 0.0;
+    }
+  }
+}
+
+void AbstractProjectorMarkerItem::calcAngularDeviation() {
+  Vec3D n;
+  if (markerType==SpotMarker) {
+    n = projector->getCrystal()->hkl2Reziprocal(getIntegerIndex().toType<double>());
+  } else {
+    n = projector->getCrystal()->uvw2Real(getIntegerIndex().toType<double>());
+  }
+  angularDeviation = 180.0*M_1_PI*acos(n.normalized()*getMarkerNormal());
+}
+
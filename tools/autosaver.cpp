@@ -0,0 +1,273 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "tools/autosaver.h"
+
+#include <QCoreApplication>
+#include <QMdiArea>
+#include <QMdiSubWindow>
+#include <QEvent>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QGraphicsView>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+#include "core/crystal.h"
+#include "core/projector.h"
+#include "core/spacegroup.h"
+#include "image/laueimage.h"
+#include "ui/crystaldisplay.h"
+#include "ui/projectionplane.h"
+#include "config/configstore.h"
+#include "tools/workspacefile.h"
+#include "tools/itemstore.h"
+#include "tools/trace.h"
+
+const char XML_AutoSaver_ConnectedCrystal[] = "ConnectedCrystal";
+const char XML_AutoSaver_ConnectedProjectors[] = "ConnectedProjectors";
+
+
+AutoSaver::AutoSaver(QMdiArea* area, QObject* _parent):
+    QObject(_parent),
+    mdiArea(area),
+    lock(lockFile(autosaveFile())),
+    timer(),
+    writer(),
+    watched(),
+    sections(),
+    lastLayout()
+{
+  // Held as long as the instance runs, so its age does not make it stale
+  QDir().mkpath(QFileInfo(autosaveFile()).absolutePath());
+  lock.setStaleLockTime(0);
+  lock.tryLock(0);
+  connect(&timer, SIGNAL(timeout()), this, SLOT(snapshot()));
+  connect(&writer, SIGNAL(finished()), this, SLOT(writeFinished()));
+  connect(ConfigStore::getInstance(), SIGNAL(autosaveIntervalChanged(int)), this, SLOT(setInterval(int)));
+  setInterval(ConfigStore::getInstance()->autosaveInterval());
+}
+
+AutoSaver::~AutoSaver() {
+  // Only reached on a regular exit, so there is nothing to recover
+  writer.waitForFinished();
+  discardAutosave(autosaveFile());
+}
+
+QString AutoSaver::autosaveFile() {
+  return QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath(QString("autosave-%1.%2").arg(QCoreApplication::applicationPid()).arg(WorkspaceFile::Suffix_Binary));
+}
+
+QString AutoSaver::lockFile(const QString& autosave) {
+  return autosave+".lock";
+}
+
+QStringList AutoSaver::staleAutosaves() {
+  QDir dir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+  QStringList stale;
+  foreach (QFileInfo f, dir.entryInfoList(QStringList() << QString("autosave-*.%1").arg(WorkspaceFile::Suffix_Binary), QDir::Files, QDir::Time)) {
+    // The lock of a running instance is held, the one of a crashed instance is stale
+    QLockFile l(lockFile(f.filePath()));
+    l.setStaleLockTime(0);
+    if (l.tryLock(0)) {
+      stale << f.filePath();
+      l.unlock();
+    }
+  }
+  return stale;
+}
+
+void AutoSaver::discardAutosave(const QString& autosave) {
+  QFile::remove(autosave);
+}
+
+void AutoSaver::setInterval(int minutes) {
+  if (minutes>0) {
+    timer.start(minutes*60000);
+  } else {
+    timer.stop();
+  }
+}
+
+void AutoSaver::snapshot() {
+  // Windows changed while the last file is written are picked up next time
+  if (writer.isRunning()) return;
+  CLIP_TRACE("AutoSaver::snapshot");
+
+  Snapshot s;
+  QList<QObject*> layout;
+  bool changed = false;
+  foreach (QMdiSubWindow* mdi, mdiArea->subWindowList()) {
+    if (CrystalDisplay* cd = dynamic_cast<CrystalDisplay*>(mdi->widget())) {
+      Connection c;
+      c.crystal = takeSection(cd, changed);
+      layout << nullptr << cd;
+      foreach (Projector* p, cd->getCrystal()->getConnectedProjectors()) {
+        if (ProjectionPlane* pp = dynamic_cast<ProjectionPlane*>(p->parent())) {
+          c.projectors << takeSection(pp, changed);
+          layout << pp;
+        }
+      }
+      s.connections << c;
+    }
+  }
+  if (!changed && layout==lastLayout) return;
+  lastLayout = layout;
+  writer.setFuture(QtConcurrent::run(&AutoSaver::writeSnapshot, autosaveFile(), s));
+}
+
+AutoSaver::Section AutoSaver::takeSection(QWidget* owner, bool& changed) {
+  watchWindow(owner);
+  CachedSection& cached = sections[owner];
+
+  Section s;
+  s.owner = owner;
+  if (cached.dirty || cached.compressed.isEmpty()) {
+    // Saved into a document of its own, which is handed over to the worker
+    if (CrystalDisplay* cd = dynamic_cast<CrystalDisplay*>(owner)) {
+      s.element = s.doc.appendChild(s.doc.createElement(XML_AutoSaver_ConnectedCrystal)).toElement();
+      cd->saveToXML(s.element);
+    } else if (ProjectionPlane* pp = dynamic_cast<ProjectionPlane*>(owner)) {
+      QDomElement base = s.doc.appendChild(s.doc.createElement(XML_AutoSaver_ConnectedProjectors)).toElement();
+      pp->saveToXML(base);
+      s.element = base.firstChildElement();
+    }
+    cached.dirty = false;
+    changed = true;
+  } else {
+    s.compressed = cached.compressed;
+  }
+  return s;
+}
+
+void AutoSaver::watchWindow(QWidget* owner) {
+  if (!sections.contains(owner)) {
+    sections.insert(owner, CachedSection());
+    // Geometry and zoom are saved, but do not emit signals
+    watchEvents(owner, owner);
+    watchEvents(owner->parentWidget(), owner);
+    // Zooming and rotating by mouse happen in the viewports
+    foreach (QGraphicsView* view, owner->findChildren<QGraphicsView*>())
+      watchEvents(view->viewport(), owner);
+  }
+  if (CrystalDisplay* cd = dynamic_cast<CrystalDisplay*>(owner)) {
+    Crystal* c = cd->getCrystal();
+    watch(c, owner, QList<const char*>() << SIGNAL(cellChanged()) << SIGNAL(orientationChanged()) << SIGNAL(rotationAxisChanged())
+                                         << SIGNAL(projectorAdded(Projector*)) << SIGNAL(projectorRemoved(Projector*)));
+    watch(c->getSpacegroup(), owner, QList<const char*>() << SIGNAL(groupChanged()));
+  } else if (ProjectionPlane* pp = dynamic_cast<ProjectionPlane*>(owner)) {
+    Projector* p = pp->getProjector();
+    watch(p, owner, QList<const char*>() << SIGNAL(wavevectorsUpdated()) << SIGNAL(projectionParamsChanged())
+                                         << SIGNAL(projectionRectPosChanged()) << SIGNAL(projectionRectSizeChanged())
+                                         << SIGNAL(imgTransformUpdated()) << SIGNAL(imageLoaded(LaueImage*)) << SIGNAL(imageClosed())
+                                         << SIGNAL(spotSizeChanged(double)) << SIGNAL(textSizeChanged(double))
+                                         << SIGNAL(markerAdded(AbstractMarkerItem*)) << SIGNAL(markerChanged(AbstractMarkerItem*))
+                                         << SIGNAL(markerRemoved(AbstractMarkerItem*)));
+    watch(&p->rulers(), owner, QList<const char*>() << SIGNAL(itemAdded(int)) << SIGNAL(itemChanged(int))
+                                                    << SIGNAL(itemRemoved(int)) << SIGNAL(itemsCleared()));
+    // The image is replaced on every load, so it is looked up again each time
+    watch(p->getLaueImage(), owner, QList<const char*>() << SIGNAL(imageContentsChanged()) << SIGNAL(frameChanged(LaueImage*)));
+  }
+}
+
+void AutoSaver::watch(QObject* o, QObject* owner, const QList<const char*>& signalList) {
+  if (o==nullptr || watched.contains(o)) return;
+  watched.insert(o, owner);
+  foreach (const char* signal, signalList)
+    connect(o, signal, this, SLOT(markDirty()));
+  connect(o, SIGNAL(destroyed(QObject*)), this, SLOT(objectDestroyed(QObject*)));
+}
+
+void AutoSaver::watchEvents(QObject* o, QObject* owner) {
+  if (o==nullptr || watched.contains(o)) return;
+  watched.insert(o, owner);
+  o->installEventFilter(this);
+  connect(o, SIGNAL(destroyed(QObject*)), this, SLOT(objectDestroyed(QObject*)));
+}
+
+bool AutoSaver::eventFilter(QObject* o, QEvent* e) {
+  if (e->type()==QEvent::Move || e->type()==QEvent::Resize || e->type()==QEvent::MouseButtonRelease)
+    setDirty(o);
+  return false;
+}
+
+void AutoSaver::markDirty() {
+  setDirty(sender());
+}
+
+void AutoSaver::setDirty(QObject* o) {
+  QHash<QObject*, QObject*>::const_iterator it = watched.constFind(o);
+  if (it==watched.constEnd()) return;
+  QHash<QObject*, CachedSection>::iterator section = sections.find(it.value());
+  if (section!=sections.end())
+    section.value().dirty = true;
+}
+
+void AutoSaver::objectDestroyed(QObject* o) {
+  watched.remove(o);
+  sections.remove(o);
+}
+
+AutoSaver::Snapshot AutoSaver::writeSnapshot(QString filename, Snapshot snapshot) {
+  CLIP_TRACE("AutoSaver::writeSnapshot");
+  QList<WorkspaceFile::CompressedConnection> connections;
+  for (int i=0; i<snapshot.connections.size(); i++) {
+    Connection& c = snapshot.connections[i];
+    WorkspaceFile::CompressedConnection compressed;
+    QList<Section*> sectionList;
+    sectionList << &c.crystal;
+    for (int j=0; j<c.projectors.size(); j++)
+      sectionList << &c.projectors[j];
+    foreach (Section* s, sectionList) {
+      if (!s->element.isNull()) {
+        s->compressed = WorkspaceFile::compressSection(s->element);
+        // The DOM trees are released here, not in the GUI thread
+        s->element = QDomElement();
+        s->doc = QDomDocument();
+      }
+    }
+    compressed.crystal = c.crystal.compressed;
+    foreach (const Section& s, c.projectors)
+      compressed.projectors << s.compressed;
+    connections << compressed;
+  }
+  QDir().mkpath(QFileInfo(filename).absolutePath());
+  snapshot.written = WorkspaceFile::writeBinary(filename, connections);
+  return snapshot;
+}
+
+void AutoSaver::writeFinished() {
+  Snapshot s = writer.result();
+  // A failed write is retried with the next snapshot, even if nothing changed
+  if (!s.written)
+    lastLayout.clear();
+  QList<Section> sectionList;
+  foreach (const Connection& c, s.connections)
+    sectionList << c.crystal << c.projectors;
+  foreach (const Section& section, sectionList) {
+    // Windows closed meanwhile have lost their entry already
+    QHash<QObject*, CachedSection>::iterator it = sections.find(section.owner);
+    if (it!=sections.end())
+      it.value().compressed = section.compressed;
+  }
+}
@@ -0,0 +1,114 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef AUTOSAVER_H
+#define AUTOSAVER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QHash>
+#include <QList>
+#include <QDomDocument>
+#include <QDomElement>
+#include <QFutureWatcher>
+#include <QLockFile>
+#include <QStringList>
+
+class QMdiArea;
+
+// Periodically saves the workspace of a QMdiArea into a binary workspace
+// file, from which it is restored after a crash. Only the windows that
+// changed since the last save are serialized again on the GUI thread, the
+// others reuse their compressed sections. Compressing and writing are done
+// by a worker, the file is replaced atomically. Every instance saves into a
+// file of its own, guarded by a lock file while the instance runs.
+class AutoSaver: public QObject {
+  Q_OBJECT
+public:
+  explicit AutoSaver(QMdiArea* area, QObject* _parent=nullptr);
+  virtual ~AutoSaver();
+
+  // Autosave of this instance
+  static QString autosaveFile();
+  static QString lockFile(const QString& autosave);
+  // Autosaves left by instances that did not exit properly, newest first
+  static QStringList staleAutosaves();
+  static void discardAutosave(const QString& autosave);
+
+  virtual bool eventFilter(QObject* o, QEvent* e);
+public slots:
+  // Interval in minutes, 0 stops autosaving
+  void setInterval(int minutes);
+  void snapshot();
+private slots:
+  void markDirty();
+  void objectDestroyed(QObject*);
+  void writeFinished();
+private:
+  AutoSaver(const AutoSaver&);
+  AutoSaver& operator=(const AutoSaver&);
+
+  // Either a freshly saved DOM tree or the compressed bytes of a clean window
+  struct Section {
+    Section(): owner(nullptr), doc(), element(), compressed() {}
+    QObject* owner;
+    QDomDocument doc;
+    QDomElement element;
+    QByteArray compressed;
+  };
+  struct Connection {
+    Section crystal;
+    QList<Section> projectors;
+  };
+  struct Snapshot {
+    Snapshot(): connections(), written(false) {}
+    QList<Connection> connections;
+    bool written;
+  };
+
+  struct CachedSection {
+    CachedSection(): compressed(), dirty(true) {}
+    QByteArray compressed;
+    bool dirty;
+  };
+
+  Section takeSection(QWidget* owner, bool& changed);
+  void watchWindow(QWidget* owner);
+  void watch(QObject* o, QObject* owner, const QList<const char*>& signalList);
+  void watchEvents(QObject* o, QObject* owner);
+  void setDirty(QObject* o);
+
+  static Snapshot writeSnapshot(QString filename, Snapshot snapshot);
+
+  QMdiArea* mdiArea;
+  QLockFile lock;
+  QTimer timer;
+  QFutureWatcher<Snapshot> writer;
+
+  // Maps the watched models and windows to the window owning their section
+  QHash<QObject*, QObject*> watched;
+  QHash<QObject*, CachedSection> sections;
+  // Order of the windows in the last written file, nullptr separates connections
+  QList<QObject*> lastLayout;
+};
+
+#endif // AUTOSAVER_H
@@ -144,8 +144,13 @@ void CropMarker::setCursors() {
 
 QPolygonF CropMarker::getRect() {
   QPolygonF rect;
-
-  return rect;
+  double w = size.width()/2;
+  double h = size.height()/2;
+  rect << QPointF(-w,-h);
+  rect << QPointF( w,-h);
+  rect << QPointF( w, h);
+  rect << QPointF(-w, h);
+  return mapToParent(rect);
 }
 
 void CropMarker::paint(QPainter *painter, const QStyleOptionGraphicsItem* /*option*/, QWidget* /*widget*/) {
@@ -240,6 +245,7 @@ void CropMarker::mousePressEvent(QGraphicsSceneMouseEvent *e) {
     }
   } else if (e->buttons()==Qt::RightButton) {
     //emit cancelCrop();
+    emit cropChanged(QPolygonF());
     QTimer::singleShot(0, this, SLOT(deleteLater()));
   }
   QGraphicsObject::mousePressEvent(e);
@@ -257,14 +263,7 @@ void CropMarker::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *e) {
 }
 
 void CropMarker::doPublishCrop() {
-  QPolygonF rect;
-  double w = size.width()/2;
-  double h = size.height()/2;
-  rect << QPointF(-w,-h);
-  rect << QPointF( w,-h);
-  rect << QPointF( w, h);
-  rect << QPointF(-w, h);
-  emit publishCrop(mapToParent(rect));
+  emit publishCrop(getRect());
 }
 
 void CropMarker::mouseMoveEvent(QGraphicsSceneMouseEvent *e) {
@@ -310,4 +309,5 @@ void CropMarker::mouseMoveEvent(QGraphicsSceneMouseEvent *e) {
   } else {
     QGraphicsObject::mouseMoveEvent(e);
   }
+  emit cropChanged(getRect());
 }
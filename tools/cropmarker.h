@@ -41,6 +41,7 @@ public:
 signals:
   void cancelCrop();
   void publishCrop(QPolygonF);
+  void cropChanged(QPolygonF);
 public slots:
   void promoteToRectangle() {};
   void setHandleSize(double);
@@ -0,0 +1,282 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "tools/hkllabelitem.h"
+
+#include <QFontMetricsF>
+#include <QStyleOptionGraphicsItem>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <algorithm>
+#include <cmath>
+
+#include "config/configstore.h"
+#include "tools/trace.h"
+
+
+HKLLabelItem::HKLLabelItem():
+    QGraphicsObject(),
+    color(Qt::black),
+    font(),
+    textSize(1.0),
+    cachedPainting(true),
+    maxLabelWidth(0.0)
+{
+  setCacheMode(NoCache);
+  font.setPixelSize(24);
+  buildAtlas();
+  ConfigStore::getInstance()->ensureColor(ConfigStore::HKLIndicator, this, SLOT(setColor(QColor)));
+}
+
+HKLLabelItem::~HKLLabelItem() {
+}
+
+void HKLLabelItem::setColor(QColor c) {
+  color = c;
+  buildAtlas();
+  update();
+}
+
+void HKLLabelItem::setTextSize(double s) {
+  textSize = s;
+  labelsUpdated();
+}
+
+void HKLLabelItem::buildAtlas() {
+  QFontMetricsF fm(font);
+  double pad = 2.0;
+  overlineY = pad;
+  double top = 2.0*pad+1.0;
+  lineHeight = top+fm.ascent()+fm.descent()+pad;
+  spaceAdvance = fm.width(QChar(' '));
+
+  glyphRects.clear();
+  glyphAdvance.clear();
+  double x = 0.0;
+  for (int n=0; n<10; n++) {
+    QChar c('0'+n);
+    double w = fm.width(c);
+    glyphRects << QRectF(x, top, w, fm.ascent()+fm.descent());
+    glyphAdvance << w;
+    x += std::ceil(w)+pad;
+  }
+  // 1x1 pixel bar, stretched over the digits of negative indices
+  glyphRects << QRectF(x+1.0, 1.0, 1.0, 1.0);
+  glyphAdvance << 0.0;
+  x += 3.0;
+
+  QImage img(static_cast<int>(std::ceil(x)), static_cast<int>(std::ceil(lineHeight)), QImage::Format_ARGB32_Premultiplied);
+  img.fill(0);
+  QPainter p(&img);
+  p.setRenderHint(QPainter::TextAntialiasing);
+  p.setFont(font);
+  p.setPen(color);
+  for (int n=0; n<10; n++)
+    p.drawText(QPointF(glyphRects[n].x(), top+fm.ascent()), QString(QChar('0'+n)));
+  p.fillRect(QRectF(glyphRects[10].x()-1.0, 0.0, 3.0, 3.0), color);
+  p.end();
+  atlasImage = img;
+  atlas = QPixmap();
+}
+
+int HKLLabelItem::layoutIndex(const HKL& hkl) {
+  int h = hkl.h;
+  int k = hkl.k;
+  int l = hkl.l;
+  qint64 key = (qint64(h&0xFFFFF)<<40) | (qint64(k&0xFFFFF)<<20) | qint64(l&0xFFFFF);
+  QHash<qint64, int>::const_iterator it = layoutForHKL.constFind(key);
+  if (it!=layoutForHKL.constEnd()) return it.value();
+
+  // Same text as Reflection::hkl2text
+  Layout layout;
+  bool separate = (abs(h)>=10 || abs(k)>=10 || abs(l)>=10);
+  double x = 0.0;
+  int idx[3] = { h, k, l };
+  for (int i=0; i<3; i++) {
+    if (separate && i>0) x += spaceAdvance;
+    double start = x;
+    foreach (QChar c, QString::number(abs(idx[i]))) {
+      int g = c.digitValue();
+      QRectF r = glyphRects[g];
+      layout.fragments << QPainter::PixmapFragment::create(QPointF(x+0.5*r.width(), r.center().y()), r);
+      layout.chars << c;
+      x += glyphAdvance[g];
+    }
+    if (idx[i]<0) {
+      QRectF r = glyphRects[10];
+      layout.fragments << QPainter::PixmapFragment::create(QPointF(0.5*(start+x), overlineY+0.5), r, x-start, 1.0);
+      layout.chars << QChar(0);
+    }
+  }
+  layout.width = x;
+  maxLabelWidth = std::max(maxLabelWidth, x);
+  layouts << layout;
+  layoutForHKL.insert(key, layouts.size()-1);
+  return layouts.size()-1;
+}
+
+void HKLLabelItem::clear() {
+  labelPos.clear();
+  labelHKL.clear();
+}
+
+void HKLLabelItem::addLabel(const QPointF& p, int h, int k, int l) {
+  HKL hkl = { h, k, l, h*h+k*k+l*l };
+  labelPos << p;
+  labelHKL << hkl;
+}
+
+void HKLLabelItem::cullLabels() {
+  CLIP_TRACE("HKLLabelItem::cullLabels");
+  shownLabels.clear();
+  shownLayout.clear();
+  if (labelPos.isEmpty() || textSize<=0.0) return;
+
+  double x0 = labelPos[0].x(), x1 = x0, y0 = labelPos[0].y(), y1 = y0;
+  foreach (QPointF p, labelPos) {
+    x0 = std::min(x0, p.x());
+    x1 = std::max(x1, p.x());
+    y0 = std::min(y0, p.y());
+    y1 = std::max(y1, p.y());
+  }
+
+  // Grid of square cells with the label height, at most about 2^20 cells
+  double cell = textSize;
+  while (((x1-x0)/cell+2.0)*((y1-y0)/cell+2.0) > (1<<20)) cell *= 2.0;
+  int nx = static_cast<int>((x1-x0)/cell)+2;
+  int ny = static_cast<int>((y1-y0)/cell)+2;
+
+  // Keep only the most important label starting in each cell, so the rest
+  // of the work is bounded by the number of cells
+  QVector<int> best(nx*ny, -1);
+  for (int i=0; i<labelPos.size(); i++) {
+    int c = static_cast<int>((labelPos[i].x()-x0)/cell) + nx*static_cast<int>((labelPos[i].y()-y0)/cell);
+    if (best[c]<0 || labelHKL[i].sqSum<labelHKL[best[c]].sqSum) best[c] = i;
+  }
+  QVector<QPair<int, int> > candidates;
+  foreach (int i, best)
+    if (i>=0) candidates << qMakePair(labelHKL[i].sqSum, i);
+  std::sort(candidates.begin(), candidates.end());
+
+  // On screen the labels extend downwards, which is -y in a flipped scene
+  bool flipped = true;
+  if (scene() && !scene()->views().isEmpty())
+    flipped = scene()->views().first()->transform().m22()<0.0;
+
+  QVector<bool> occupied(nx*ny, false);
+  for (int n=0; n<candidates.size(); n++) {
+    int i = candidates[n].second;
+    int layout = layoutIndex(labelHKL[i]);
+    QPointF p = labelPos[i]-QPointF(x0, y0);
+    double w = textSize*layouts[layout].width/lineHeight;
+    int cx0 = static_cast<int>(p.x()/cell);
+    int cx1 = std::min(static_cast<int>((p.x()+w)/cell), nx-1);
+    int cy0 = static_cast<int>(std::max(0.0, flipped ? p.y()-textSize : p.y())/cell);
+    int cy1 = std::min(static_cast<int>((flipped ? p.y() : p.y()+textSize)/cell), ny-1);
+    bool free = true;
+    for (int y=cy0; free && y<=cy1; y++)
+      for (int x=cx0; free && x<=cx1; x++)
+        free = !occupied[x+nx*y];
+    if (!free) continue;
+    for (int y=cy0; y<=cy1; y++)
+      for (int x=cx0; x<=cx1; x++)
+        occupied[x+nx*y] = true;
+    shownLabels << i;
+    shownLayout << layout;
+  }
+}
+
+void HKLLabelItem::labelsUpdated() {
+  prepareGeometryChange();
+  cullLabels();
+  labelBounds = QRectF();
+  if (!shownLabels.isEmpty()) {
+    QPointF first = labelPos[shownLabels[0]];
+    double x0 = first.x(), x1 = x0, y0 = first.y(), y1 = y0;
+    foreach (int i, shownLabels) {
+      QPointF p = labelPos[i];
+      x0 = std::min(x0, p.x());
+      x1 = std::max(x1, p.x());
+      y0 = std::min(y0, p.y());
+      y1 = std::max(y1, p.y());
+    }
+    // Labels extend to the right and downwards on screen, the scene y axis may be flipped
+    double w = textSize*maxLabelWidth/lineHeight;
+    labelBounds = QRectF(x0, y0-textSize, x1-x0+w, y1-y0+2.0*textSize);
+  }
+  update();
+}
+
+QRectF HKLLabelItem::boundingRect() const {
+  return labelBounds;
+}
+
+void HKLLabelItem::paint(QPainter *p, const QStyleOptionGraphicsItem* option, QWidget* /*widget*/) {
+  if (shownLabels.isEmpty()) return;
+
+  QTransform t = p->worldTransform();
+  // atlas pixels to device pixels
+  double s = textSize*std::sqrt(std::fabs(t.determinant()))/lineHeight;
+  QRectF visible = t.mapRect(option->exposedRect.isEmpty() ? labelBounds : option->exposedRect);
+  visible.adjust(-s*maxLabelWidth, -s*lineHeight, 0, 0);
+
+  p->save();
+  p->resetTransform();
+  if (cachedPainting) {
+    batch.clear();
+    for (int n=0; n<shownLabels.size(); n++) {
+      QPointF d = t.map(labelPos[shownLabels[n]]);
+      if (!visible.contains(d)) continue;
+      foreach (QPainter::PixmapFragment f, layouts[shownLayout[n]].fragments) {
+        f.x = d.x()+s*f.x;
+        f.y = d.y()+s*f.y;
+        f.scaleX *= s;
+        f.scaleY *= s;
+        batch << f;
+      }
+    }
+    if (atlas.isNull()) atlas = QPixmap::fromImage(atlasImage);
+    p->drawPixmapFragments(batch.constData(), batch.size(), atlas);
+  } else {
+    p->setFont(font);
+    p->setPen(color);
+    QFontMetricsF fm(font);
+    for (int n=0; n<shownLabels.size(); n++) {
+      QPointF d = t.map(labelPos[shownLabels[n]]);
+      if (!visible.contains(d)) continue;
+      p->save();
+      p->translate(d);
+      p->scale(s, s);
+      const Layout& layout = layouts[shownLayout[n]];
+      for (int n=0; n<layout.fragments.size(); n++) {
+        const QPainter::PixmapFragment& f = layout.fragments[n];
+        if (layout.chars[n].isNull()) {
+          p->fillRect(QRectF(f.x-0.5*f.scaleX, f.y-0.5, f.scaleX, 1.0), color);
+        } else {
+          p->drawText(QPointF(f.x-0.5*f.width, f.y-0.5*f.height+fm.ascent()), QString(layout.chars[n]));
+        }
+      }
+      p->restore();
+    }
+  }
+  p->restore();
+}
@@ -0,0 +1,116 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef HKLLABELITEM_H
+#define HKLLABELITEM_H
+
+#include <QGraphicsObject>
+#include <QPainter>
+#include <QPixmap>
+#include <QImage>
+#include <QFont>
+#include <QHash>
+#include <QVector>
+
+// Draws all hkl labels of a projection in one batch. The digits are rendered
+// once into a glyph atlas, the layout of each distinct hkl is cached and
+// reused by later projections. Overlapping labels are culled, labels with a
+// low h^2+k^2+l^2 win.
+class HKLLabelItem: public QGraphicsObject {
+  Q_OBJECT
+public:
+  HKLLabelItem();
+  virtual ~HKLLabelItem();
+
+  virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+  virtual QRectF boundingRect() const;
+
+  // Removes all labels, the layout cache is kept
+  void clear();
+  // Label with its top left corner at p
+  void addLabel(const QPointF& p, int h, int k, int l);
+  // Culls overlapping labels and schedules a repaint
+  void labelsUpdated();
+  int labelCount() const { return labelPos.size(); }
+  int shownLabelCount() const { return shownLabels.size(); }
+
+  // Height of a label in scene coordinates
+  void setTextSize(double s);
+  // Glyphs are drawn as text instead of atlas pixmaps, e.g. for printing
+  void setCachedPainting(bool b=true) { cachedPainting = b; }
+public slots:
+  void setColor(QColor);
+private:
+  HKLLabelItem(const HKLLabelItem&);
+  HKLLabelItem& operator=(const HKLLabelItem&);
+
+  struct Layout {
+    // fragments in atlas pixels, relative to the top left corner of the label
+    QVector<QPainter::PixmapFragment> fragments;
+    // character of each fragment, 0 for an overline
+    QVector<QChar> chars;
+    double width;
+  };
+
+  struct HKL {
+    int h;
+    int k;
+    int l;
+    int sqSum;
+  };
+
+  void buildAtlas();
+  int layoutIndex(const HKL&);
+  void cullLabels();
+
+  QColor color;
+  QFont font;
+  double textSize;
+  bool cachedPainting;
+
+  // Digits 0-9 followed by a bar for overlines
+  // Built as image, projectors may live in worker threads where pixmaps
+  // must not be created. Converted on the first paint.
+  QImage atlasImage;
+  QPixmap atlas;
+  QVector<QRectF> glyphRects;
+  QVector<double> glyphAdvance;
+  double spaceAdvance;
+  double overlineY;
+  double lineHeight;
+
+  QVector<Layout> layouts;
+  QHash<qint64, int> layoutForHKL;
+  double maxLabelWidth;
+
+  QVector<QPointF> labelPos;
+  QVector<HKL> labelHKL;
+  // Labels that survived culling and their layouts
+  QVector<int> shownLabels;
+  QVector<int> shownLayout;
+  QRectF labelBounds;
+
+  // reused between paint calls
+  QVector<QPainter::PixmapFragment> batch;
+};
+
+#endif // HKLLABELITEM_H
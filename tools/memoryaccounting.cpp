@@ -0,0 +1,265 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "tools/memoryaccounting.h"
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QMutexLocker>
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <chrono>
+
+MemoryAccounting* MemoryAccounting::instance = nullptr;
+
+// Accounts are also created in worker threads
+static QMutex instanceMutex;
+
+MemoryAccounting* MemoryAccounting::getInstance() {
+  QMutexLocker lock(&instanceMutex);
+  if (instance==nullptr)
+    instance = new MemoryAccounting();
+  return instance;
+}
+
+void MemoryAccounting::clearInstance() {
+  QMutexLocker lock(&instanceMutex);
+  delete instance;
+  instance = nullptr;
+}
+
+MemoryAccounting::MemoryAccounting(QObject* _parent):
+    QObject(_parent),
+    accounts(),
+    overallBudget(0),
+    enforcementPending(false)
+{
+  for (int s=0; s<SubsystemCount; s++) {
+    used[s] = 0;
+    budgets[s] = 0;
+  }
+  // Budgets are enforced in the event loop of the application
+  if (QCoreApplication::instance())
+    moveToThread(QCoreApplication::instance()->thread());
+}
+
+QString MemoryAccounting::subsystemName(int s) {
+  switch (s) {
+  case Reflections: return "Reflection lists";
+  case ImageData: return "Image data";
+  case ValueIndex: return "Value index";
+  case ImagePyramid: return "Image pyramid";
+  case ScalerCache: return "Scaled images";
+  case SpotIndicators: return "Spot indicators";
+  }
+  return QString();
+}
+
+QString MemoryAccounting::subsystemKey(int s) {
+  switch (s) {
+  case Reflections: return "Reflections";
+  case ImageData: return "ImageData";
+  case ValueIndex: return "ValueIndex";
+  case ImagePyramid: return "ImagePyramid";
+  case ScalerCache: return "ScalerCache";
+  case SpotIndicators: return "SpotIndicators";
+  }
+  return QString();
+}
+
+qint64 MemoryAccounting::now() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+qint64 MemoryAccounting::usage(int s) const {
+  QMutexLocker lock(&mutex);
+  return (s>=0 && s<SubsystemCount) ? used[s] : 0;
+}
+
+qint64 MemoryAccounting::totalUsage() const {
+  QMutexLocker lock(&mutex);
+  qint64 sum = 0;
+  for (int s=0; s<SubsystemCount; s++) sum += used[s];
+  return sum;
+}
+
+QList<MemoryAccounting::Entry> MemoryAccounting::entries() const {
+  QMutexLocker lock(&mutex);
+  QList<Entry> l;
+  foreach (MemoryAccount* a, accounts) {
+    Entry e;
+    e.subsystem = a->subsystem;
+    e.name = a->name;
+    e.bytes = a->size;
+    e.releasable = (a->releaseSlot!=nullptr);
+    l << e;
+  }
+  return l;
+}
+
+qint64 MemoryAccounting::budget(int s) const {
+  QMutexLocker lock(&mutex);
+  return (s>=0 && s<SubsystemCount) ? budgets[s] : 0;
+}
+
+qint64 MemoryAccounting::totalBudget() const {
+  QMutexLocker lock(&mutex);
+  return overallBudget;
+}
+
+void MemoryAccounting::setBudget(int s, qint64 bytes) {
+  if (s<0 || s>=SubsystemCount) return;
+  {
+    QMutexLocker lock(&mutex);
+    budgets[s] = std::max(bytes, qint64(0));
+  }
+  enforceBudgets();
+}
+
+void MemoryAccounting::setTotalBudget(qint64 bytes) {
+  {
+    QMutexLocker lock(&mutex);
+    overallBudget = std::max(bytes, qint64(0));
+  }
+  enforceBudgets();
+}
+
+void MemoryAccounting::addAccount(MemoryAccount* a) {
+  QMutexLocker lock(&mutex);
+  accounts << a;
+}
+
+void MemoryAccounting::removeAccount(MemoryAccount* a) {
+  QMutexLocker lock(&mutex);
+  accounts.removeOne(a);
+  used[a->subsystem] -= a->size;
+}
+
+void MemoryAccounting::accountChanged(MemoryAccount* a, qint64 bytes) {
+  QMutexLocker lock(&mutex);
+  used[a->subsystem] += bytes-a->size;
+  a->size = bytes;
+  if (!enforcementPending && exceedsBudget()) {
+    enforcementPending = true;
+    QMetaObject::invokeMethod(this, "enforceBudgets", Qt::QueuedConnection);
+  }
+}
+
+bool MemoryAccounting::exceedsBudget() const {
+  qint64 sum = 0;
+  for (int s=0; s<SubsystemCount; s++) {
+    if (budgets[s]>0 && used[s]>budgets[s]) return true;
+    sum += used[s];
+  }
+  return overallBudget>0 && sum>overallBudget;
+}
+
+void MemoryAccounting::enforceBudgets() {
+  QMutexLocker lock(&mutex);
+  enforcementPending = false;
+  QSet<MemoryAccount*> requested;
+  qint64 sum = 0;
+  qint64 released = 0;
+  for (int s=0; s<SubsystemCount; s++) {
+    sum += used[s];
+    if (budgets[s]>0 && used[s]>budgets[s])
+      released += releaseLeastRecentlyUsed(s, used[s]-budgets[s], requested);
+  }
+  if (overallBudget>0 && sum-released>overallBudget)
+    releaseLeastRecentlyUsed(-1, sum-released-overallBudget, requested);
+}
+
+qint64 MemoryAccounting::releaseLeastRecentlyUsed(int s, qint64 excess, QSet<MemoryAccount*>& requested) {
+  qint64 protectedSince = now()-ProtectionTime;
+  QList<MemoryAccount*> candidates;
+  foreach (MemoryAccount* a, accounts) {
+    if ((s<0 || a->subsystem==s) && a->releaseSlot && a->size>0 && !requested.contains(a) && a->lastUse.load(std::memory_order_relaxed)<protectedSince)
+      candidates << a;
+  }
+  std::sort(candidates.begin(), candidates.end(), [](MemoryAccount* a, MemoryAccount* b) {
+    return a->lastUse.load(std::memory_order_relaxed)<b->lastUse.load(std::memory_order_relaxed);
+  });
+  qint64 released = 0;
+  for (int i=0; i<candidates.size() && released<excess; i++) {
+    MemoryAccount* a = candidates.at(i);
+    QMetaObject::invokeMethod(a->owner, a->releaseSlot, Qt::QueuedConnection);
+    requested << a;
+    released += a->size;
+  }
+  return released;
+}
+
+static QString csvField(const QString& s) {
+  QString r = s;
+  r.replace('"', "\"\"");
+  return QString("\"%1\"").arg(r);
+}
+
+bool MemoryAccounting::writeReport(const QString& filename) const {
+  QFile f(filename);
+  if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) return false;
+  QTextStream out(&f);
+  out << "subsystem,object,bytes,budget,releasable\n";
+  QList<Entry> l = entries();
+  for (int s=0; s<SubsystemCount; s++) {
+    out << subsystemKey(s) << "," << csvField("Total") << "," << usage(s) << "," << budget(s) << ",\n";
+    foreach (const Entry& e, l) {
+      if (e.subsystem==s)
+        out << subsystemKey(s) << "," << csvField(e.name) << "," << e.bytes << ",," << (e.releasable ? 1 : 0) << "\n";
+    }
+  }
+  out << "Total," << csvField("Total") << "," << totalUsage() << "," << totalBudget() << ",\n";
+  out.flush();
+  return f.error()==QFile::NoError;
+}
+
+MemoryAccount::MemoryAccount(MemoryAccounting::Subsystem _subsystem, QObject* _owner, const char* _releaseSlot):
+    subsystem(_subsystem),
+    owner(_owner),
+    releaseSlot(_releaseSlot),
+    name(),
+    size(0),
+    lastUse(MemoryAccounting::now())
+{
+  if (owner)
+    name = owner->metaObject()->className();
+  MemoryAccounting::getInstance()->addAccount(this);
+}
+
+MemoryAccount::~MemoryAccount() {
+  MemoryAccounting::getInstance()->removeAccount(this);
+}
+
+void MemoryAccount::setName(const QString& _name) {
+  QMutexLocker lock(&MemoryAccounting::getInstance()->mutex);
+  name = _name;
+}
+
+void MemoryAccount::setBytes(qint64 bytes) {
+  touch();
+  MemoryAccounting::getInstance()->accountChanged(this, bytes);
+}
+
+qint64 MemoryAccount::bytes() const {
+  return size;
+}
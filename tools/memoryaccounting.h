@@ -0,0 +1,134 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#include <QObject>
+#include <QMutex>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <atomic>
+
+class MemoryAccount;
+
+// Bookkeeping of the memory held by the large data structures, grouped by
+// subsystem. Owners keep a MemoryAccount next to their data and update it
+// whenever the data changes size. Each subsystem and the total may get a soft
+// budget. If one is exceeded, the least recently used releasable accounts are
+// asked to free their memory, accounts used within the last ProtectionTime
+// are kept as they are probably rebuilt right away.
+class MemoryAccounting: public QObject {
+  Q_OBJECT
+public:
+  enum Subsystem {
+    Reflections,
+    ImageData,
+    ValueIndex,
+    ImagePyramid,
+    ScalerCache,
+    SpotIndicators,
+    SubsystemCount
+  };
+
+  struct Entry {
+    Subsystem subsystem;
+    QString name;
+    qint64 bytes;
+    bool releasable;
+  };
+
+  static const int ProtectionTime = 2000;
+
+  static MemoryAccounting* getInstance();
+  static void clearInstance();
+
+  static QString subsystemName(int s);
+  // Name for settings and reports
+  static QString subsystemKey(int s);
+
+  qint64 usage(int s) const;
+  qint64 totalUsage() const;
+  QList<Entry> entries() const;
+
+  // Soft budgets in bytes, 0 for none
+  qint64 budget(int s) const;
+  qint64 totalBudget() const;
+  void setBudget(int s, qint64 bytes);
+  void setTotalBudget(qint64 bytes);
+
+  // Writes all accounts and the subsystem totals as CSV
+  bool writeReport(const QString& filename) const;
+public slots:
+  void enforceBudgets();
+private:
+  friend class MemoryAccount;
+  explicit MemoryAccounting(QObject* _parent=nullptr);
+  MemoryAccounting(const MemoryAccounting&);
+  MemoryAccounting& operator=(const MemoryAccounting&);
+
+  static qint64 now();
+  void addAccount(MemoryAccount*);
+  void removeAccount(MemoryAccount*);
+  void accountChanged(MemoryAccount*, qint64 bytes);
+  bool exceedsBudget() const;
+  // Releases accounts of subsystem s, or of all subsystems if s<0. Returns the bytes they hold
+  qint64 releaseLeastRecentlyUsed(int s, qint64 excess, QSet<MemoryAccount*>& requested);
+
+  mutable QMutex mutex;
+  QList<MemoryAccount*> accounts;
+  qint64 used[SubsystemCount];
+  qint64 budgets[SubsystemCount];
+  qint64 overallBudget;
+  bool enforcementPending;
+
+  static MemoryAccounting* instance;
+};
+
+// Memory held by one object for one subsystem. If releaseSlot names a slot of
+// owner, it is invoked in the thread of owner to free the memory when a budget
+// is exceeded. The owner has to report the new size afterwards.
+class MemoryAccount {
+public:
+  MemoryAccount(MemoryAccounting::Subsystem _subsystem, QObject* _owner, const char* _releaseSlot=nullptr);
+  ~MemoryAccount();
+
+  void setName(const QString& name);
+  void setBytes(qint64 bytes);
+  qint64 bytes() const;
+  // Marks the memory as in use, which delays its release
+  void touch() { lastUse.store(MemoryAccounting::now(), std::memory_order_relaxed); }
+private:
+  friend class MemoryAccounting;
+  MemoryAccount(const MemoryAccount&);
+  MemoryAccount& operator=(const MemoryAccount&);
+
+  MemoryAccounting::Subsystem subsystem;
+  QObject* owner;
+  const char* releaseSlot;
+  QString name;
+  qint64 size;
+  std::atomic<qint64> lastUse;
+};
+
+#endif // MEMORYACCOUNTING_H
@@ -24,11 +24,14 @@
 
 #include <QPainter>
 #include <QGraphicsView>
+#include <QHash>
+#include <algorithm>
 #include <cmath>
 #include <QDebug>
 
 #include "config/configstore.h"
 #include "threadrunner.h"
+#include "tools/trace.h"
 
 
 
@@ -36,57 +39,126 @@
 
 SpotIndicatorGraphicsItem::SpotIndicatorGraphicsItem():
     QGraphicsObject(),
+    tilesAcross(0),
+    tilesDown(0),
     tWorker(this),
-    threadRunner(new ThreadRunner(tWorker))
+    threadRunner(new ThreadRunner(tWorker)),
+    cacheMemory(MemoryAccounting::SpotIndicators, this, "releaseCache")
 {
   ConfigStore::getInstance()->ensureColor(ConfigStore::SpotIndicators, this, SLOT(setColor(QColor)));
   setCacheMode(NoCache);
   cacheNeedsUpdate = true;
+  fullRedraw = true;
   setCachedPainting();
-  cache = nullptr;
 };
 
 SpotIndicatorGraphicsItem::~SpotIndicatorGraphicsItem() {
   delete threadRunner;
-  delete cache;
 }
 
 void SpotIndicatorGraphicsItem::setColor(QColor c) {
   spotColor = c;
   cacheNeedsUpdate = true;
+  fullRedraw = true;
   update();
 }
 
+void SpotIndicatorGraphicsItem::resizeCache(const QSize& s) {
+  cacheSize = s;
+  tilesAcross = (s.width()+TileSize-1)/TileSize;
+  tilesDown = (s.height()+TileSize-1)/TileSize;
+  int n = tilesAcross*tilesDown;
+  tileCache = QVector<QImage>(n);
+  tileSignature = QVector<uint>(n);
+  tileDirty = QVector<bool>(n);
+  tileSpots = QVector<QVector<int> >(n);
+  cacheNeedsUpdate = true;
+  fullRedraw = true;
+}
+
+QRect SpotIndicatorGraphicsItem::tileRect(int n) const {
+  QRect r((n%tilesAcross)*TileSize, (n/tilesAcross)*TileSize, TileSize, TileSize);
+  return r.intersected(QRect(QPoint(0, 0), cacheSize));
+}
 
 void SpotIndicatorGraphicsItem::updateCache() {
+  CLIP_TRACE("SpotIndicatorGraphicsItem::updateCache");
   if (cacheNeedsUpdate) {
+    double rx = transform.m11()*spotSize;
+    double ry = transform.m22()*spotSize;
+    double dx = std::fabs(rx)+1.0;
+    double dy = std::fabs(ry)+1.0;
+
+    // Bin the spots into all tiles their outline may touch
+    for (int t=0; t<tileSpots.size(); t++) tileSpots[t].clear();
+    devicePoints.resize(coordinates.size());
+    for (int i=0; i<coordinates.size(); i++) {
+      QPointF p = transform.map(coordinates.at(i));
+      devicePoints[i] = p;
+      int x0 = std::max(static_cast<int>(std::floor((p.x()-dx)/TileSize)), 0);
+      int x1 = std::min(static_cast<int>(std::floor((p.x()+dx)/TileSize)), tilesAcross-1);
+      int y0 = std::max(static_cast<int>(std::floor((p.y()-dy)/TileSize)), 0);
+      int y1 = std::min(static_cast<int>(std::floor((p.y()+dy)/TileSize)), tilesDown-1);
+      for (int y=y0; y<=y1; y++)
+        for (int x=x0; x<=x1; x++)
+          tileSpots[x+y*tilesAcross] << i;
+    }
+
+    // Only tiles whose spots moved are rasterized again
+    for (int t=0; t<tileSpots.size(); t++) {
+      uint sig = tileSpots[t].size();
+      foreach (int i, tileSpots[t]) {
+        sig = 31*sig + qHash(qRound(8.0*devicePoints[i].x()));
+        sig = 31*sig + qHash(qRound(8.0*devicePoints[i].y()));
+      }
+      tileDirty[t] = fullRedraw || (sig!=tileSignature[t]);
+      tileSignature[t] = sig;
+    }
+
+    QList<QGraphicsView*> l = scene() ? scene()->views() : QList<QGraphicsView*>();
+    renderHints = l.size() ? l.at(0)->renderHints() : QPainter::RenderHints();
 
     threadRunner->start();
-    cache->fill(QColor(0,0,0,0));
     threadRunner->join();
 
     cacheNeedsUpdate=false;
+    fullRedraw=false;
+
+    qint64 bytes = sizeof(QPointF)*(qint64(coordinates.capacity())+devicePoints.capacity());
+    for (int t=0; t<tileCache.size(); t++)
+      bytes += qint64(tileCache[t].bytesPerLine())*tileCache[t].height()+sizeof(int)*tileSpots[t].capacity();
+    cacheMemory.setBytes(bytes);
+  } else {
+    cacheMemory.touch();
   }
 }
 
+void SpotIndicatorGraphicsItem::releaseCache() {
+  resizeCache(QSize());
+  devicePoints = QVector<QPointF>();
+  cacheMemory.setBytes(sizeof(QPointF)*qint64(coordinates.capacity()));
+}
+
 void SpotIndicatorGraphicsItem::paint(QPainter *p, const QStyleOptionGraphicsItem* /*option*/, QWidget* /*widget*/) {
   if (cachedPainting) {
-    if (!cache || (cache->size()!=p->viewport().size())) {
-      if (cache) delete cache;
-      cache = new QPixmap(p->viewport().size());
-      cacheNeedsUpdate = true;
+    if (cacheSize!=p->viewport().size()) {
+      resizeCache(p->viewport().size());
     }
 
     if (transform!=p->worldTransform()) {
       transform = p->worldTransform();
       cacheNeedsUpdate = true;
+      fullRedraw = true;
     }
 
     updateCache();
 
     p->save();
     p->resetTransform();
-    p->drawPixmap(QPoint(0,0), *cache);
+    for (int t=0; t<tileCache.size(); t++) {
+      if (!tileCache[t].isNull())
+        p->drawImage(tileRect(t).topLeft(), tileCache[t]);
+    }
     p->restore();
   } else {
     //PDF-Export via QPrinter::setOutputFormat(PdfFormat) has a Bug concerning
@@ -143,64 +215,35 @@ SpotIndicatorGraphicsItem::TWorker::TWorker(SpotIndicatorGraphicsItem *s):
     spotIndicator(s)
   {}
 
-SpotIndicatorGraphicsItem::TWorker::~TWorker() {
-  init(0);
-}
-
-void SpotIndicatorGraphicsItem::TWorker::init(int numberOfThreads) {
-  if (threadCaches.size()!=static_cast<unsigned int>(numberOfThreads)) {
-    foreach (CacheType* c, threadCaches)
-      delete c;
-    threadCaches.clear();
-    for (int n=0; n<numberOfThreads; n++)
-      threadCaches.push_back(nullptr);
-  }
-
+void SpotIndicatorGraphicsItem::TWorker::init() {
   wp = 0;
 }
 
-void SpotIndicatorGraphicsItem::TWorker::operator ()(int id) {
-  CacheType* localCache = threadCaches[id];
-  if (localCache==nullptr || localCache->size()!=spotIndicator->cache->size()) {
-    if (localCache!=nullptr) delete localCache;
-    localCache = new CacheType(spotIndicator->cache->size(), QImage::Format_ARGB32_Premultiplied);
-    threadCaches[id] = localCache;
-  }
-
-  double rx = spotIndicator->transform.m11()*spotIndicator->spotSize;
-  double ry = spotIndicator->transform.m22()*spotIndicator->spotSize;
-  localCache->fill(QColor(0,0,0,0).rgba());
-  //localCache->fill(QColor(0,0,0,0));
-
-  QPainter painter(localCache);
-  QList<QGraphicsView*> l = spotIndicator->scene()->views();
-  if (l.size())
-    painter.setRenderHints(l.at(0)->renderHints());
-  painter.setPen(spotIndicator->spotColor);
-
-  int size = spotIndicator->coordinates.size();
-  int chunkSize = std::max(size/static_cast<int>(threadCaches.size()), 1);
-  QTransform t = spotIndicator->transform;
-
-  int n=id;
-  //while ((n=wp.fetchAndAddOrdered(1))*chunkSize<size) {
-    QPointF const* p = spotIndicator->coordinates.constData()+n*chunkSize;
-    int count = std::min(size, chunkSize*(n+1))-chunkSize*n;
-    for (int i=0; i<count; i++) {
-      painter.drawEllipse(t.map(*(p++)), rx, ry);
+void SpotIndicatorGraphicsItem::TWorker::operator()() {
+  SpotIndicatorGraphicsItem* s = spotIndicator;
+  double rx = s->transform.m11()*s->spotSize;
+  double ry = s->transform.m22()*s->spotSize;
+
+  int t;
+  while ((t=wp.fetchAndAddOrdered(1))<s->tileCache.size()) {
+    if (!s->tileDirty[t]) continue;
+    const QVector<int>& spots = s->tileSpots[t];
+    if (spots.isEmpty()) {
+      s->tileCache[t] = QImage();
+      continue;
     }
-  //}
-
-  painter.end();
-
-}
-
-void SpotIndicatorGraphicsItem::TWorker::done() {
-  QPainter painter(spotIndicator->cache);
-  foreach (CacheType* c, threadCaches) {
-    painter.drawImage(QPoint(0, 0), *c);
-    //painter.drawPixmap(0, 0, *c);
+    QRect r = s->tileRect(t);
+    QImage& img = s->tileCache[t];
+    if (img.size()!=r.size())
+      img = QImage(r.size(), QImage::Format_ARGB32_Premultiplied);
+    img.fill(0);
+
+    QPainter painter(&img);
+    painter.setRenderHints(s->renderHints);
+    painter.setPen(s->spotColor);
+    painter.translate(-r.topLeft());
+    foreach (int i, spots)
+      painter.drawEllipse(s->devicePoints[i], rx, ry);
+    painter.end();
   }
-  painter.end();
 }
-
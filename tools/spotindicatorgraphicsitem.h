@@ -24,8 +24,12 @@
 #define SPOTINDICATORGRAPHICSITEM_H
 
 #include <QGraphicsObject>
+#include <QPainter>
+#include <QImage>
 #include <cmath>
 
+#include "tools/memoryaccounting.h"
+
 class ThreadRunner;
 
 class SpotIndicatorGraphicsItem: public QGraphicsObject {
@@ -38,43 +42,59 @@ private:
   SpotIndicatorGraphicsItem& operator=(const SpotIndicatorGraphicsItem&);
 public slots:
   void setColor(QColor);
+  // Frees the rendered tiles, they are drawn again on the next paint
+  void releaseCache();
 public:
   virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
   virtual QRectF boundingRect() const;
 
-  void setSpotsize(double s) { spotSize = s; cacheNeedsUpdate=true; }
+  void setSpotsize(double s) { spotSize = s; cacheNeedsUpdate=true; fullRedraw=true; }
   void setCachedPainting(bool b=true) { cachedPainting = b; }
   void pointsUpdated();
   QVector<QPointF> coordinates;
 protected:
   bool cacheNeedsUpdate;
   bool cachedPainting;
+  // All tiles have to be redrawn, not only those whose spots moved
+  bool fullRedraw;
   void updateCache();
+  void resizeCache(const QSize&);
+  QRect tileRect(int n) const;
 
   QColor spotColor;
 
-  QPixmap* cache;
   double spotSize;
   QTransform transform;
+  QPainter::RenderHints renderHints;
+
+  // The viewport is split into square tiles, each rasterized by one worker
+  static const int TileSize = 128;
+  QSize cacheSize;
+  int tilesAcross;
+  int tilesDown;
+  // Rendered tiles, null if no spot touches the tile
+  QVector<QImage> tileCache;
+  // Hash of the spot positions in each tile, to detect unchanged tiles
+  QVector<uint> tileSignature;
+  QVector<bool> tileDirty;
+  // Indexes into devicePoints of the spots overlapping each tile
+  QVector<QVector<int> > tileSpots;
+  QVector<QPointF> devicePoints;
 
   class TWorker {
   public:
-    typedef QImage CacheType;
     TWorker(SpotIndicatorGraphicsItem* s);
-    ~TWorker();
-    void operator()(int id);
-    void init(int numberOfThreads);
-    void done();
+    void operator()();
+    void init();
 
-    //std::atomic<int> wp;
     QAtomicInt wp;
 
     SpotIndicatorGraphicsItem* spotIndicator;
-    std::vector<CacheType*> threadCaches;
   };
 
   TWorker tWorker;
   ThreadRunner* threadRunner;
+  MemoryAccount cacheMemory;
 };
 
 
@@ -0,0 +1,64 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "tools/startuptiming.h"
+
+#include <cstring>
+
+#include "tools/trace.h"
+
+// As close to the program start as static initialization gets
+const qint64 StartupTiming_programStart = Trace::now();
+
+bool StartupTiming::enabled = false;
+QMutex StartupTiming::mutex;
+QList<QPair<const char*, qint64> > StartupTiming::marks;
+
+
+void StartupTiming::init(int argc, char* argv[]) {
+  if (!qEnvironmentVariableIsEmpty("CLIP_STARTUP_TIMING"))
+    enabled = true;
+  for (int i=1; i<argc; i++) {
+    if (std::strcmp(argv[i], "--startup-timing")==0)
+      enabled = true;
+  }
+}
+
+bool StartupTiming::isEnabled() {
+  return enabled;
+}
+
+void StartupTiming::mark(const char* phase) {
+  qint64 t = Trace::now();
+  QMutexLocker lock(&mutex);
+  qint64 start = StartupTiming_programStart;
+  for (int i=0; i<marks.size(); i++) {
+    if (std::strcmp(marks.at(i).first, phase)==0)
+      return;
+    start = marks.at(i).second;
+  }
+  marks << qMakePair(phase, t);
+  if (Trace::isEnabled())
+    Trace::record(phase, start, t-start);
+  if (enabled)
+    qInfo("Startup: %-28s %8.1f ms (total %8.1f ms)", phase, 1e-6*(t-start), 1e-6*(t-StartupTiming_programStart));
+}
@@ -0,0 +1,51 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef STARTUPTIMING_H
+#define STARTUPTIMING_H
+
+#include <QList>
+#include <QPair>
+#include <QMutex>
+
+// Durations of the startup phases, e.g. until the main window is shown or the
+// first image is displayed. Each phase ends with a call to mark() and starts
+// at the previous mark, the first one at program start. With --startup-timing
+// or CLIP_STARTUP_TIMING set, every phase is printed when it ends. Phases are
+// recorded as trace events as well, so their names have to be string literals.
+class StartupTiming {
+public:
+  // Enables the report if requested on the command line or the environment
+  static void init(int argc, char* argv[]);
+  static bool isEnabled();
+
+  // Only the first mark of a name counts
+  static void mark(const char* phase);
+private:
+  StartupTiming();
+
+  static bool enabled;
+  static QMutex mutex;
+  static QList<QPair<const char*, qint64> > marks;
+};
+
+#endif // STARTUPTIMING_H
@@ -22,9 +22,16 @@
 
 
 #include "threadrunner.h"
+#include "tools/trace.h"
 
 #include <iostream>
 
+std::atomic<int> ThreadRunner::maxThreadCount(0);
+
+void ThreadRunner::setMaxThreadCount(int n) {
+  maxThreadCount.store(n);
+}
+
 ThreadRunner::ThreadRunner():
 #if USE_SEMAPHORE_SYNC
     workerPermission(0),
@@ -35,6 +42,7 @@ ThreadRunner::ThreadRunner():
 #endif
     shouldStop(false),
     workerInitPending(false),
+    traceName(nullptr),
     f(nullptr) {
   initThreads();
 }
@@ -46,6 +54,8 @@ void ThreadRunner::initThreads() {
 #else
   int N = std::max(boost::thread::hardware_concurrency(), 1u);
 #endif
+  int limit = maxThreadCount.load();
+  if (limit>0) N = std::min(N, limit);
   for (int n=0; n<N; n++) {
 #if USE_QTHREADS
     QThread* t = new WorkerThread(this, n);
@@ -118,7 +128,10 @@ void ThreadRunner::workFunction(int id) {
 #endif
 
     // Call Worker here
-    if (f) f->run(id);
+    if (f) {
+      TraceScope scope(traceName ? traceName : "ThreadRunner");
+      f->run(id);
+    }
 
 #if USE_SEMAPHORE_SYNC
     workerSync.release();
@@ -137,6 +150,7 @@ void ThreadRunner::start() {
     f->init(threads.size());
     workerInitPending = true;
   }
+  traceName = Trace::currentScope();
 #if USE_SEMAPHORE_SYNC
   workerPermission.release(threads.size());
 #else
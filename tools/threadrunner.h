@@ -24,6 +24,8 @@
 #define THREADRUNNER_H
 
 #include <vector>
+#include <utility>
+#include <atomic>
 
 #include "config.h"
 
@@ -53,7 +55,8 @@ public:
 #endif
       shouldStop(false),
       workerInitPending(false),
-      f(makeFunctor(w)) {
+      traceName(nullptr),
+      f(makeFunctor(std::forward<WORKER>(w))) {
     initThreads();
   }
   ThreadRunner();
@@ -61,13 +64,19 @@ public:
 
   template <class WORKER> void start(WORKER&& w) {
     if (f) delete f;
-    f = makeFunctor(w);
+    f = makeFunctor(std::forward<WORKER>(w));
     start();
   }
   void start();
   void join();
 
+  // Upper limit for the threads of runners created afterwards, 0 for the
+  // ideal thread count. Used when several runners work concurrently.
+  static void setMaxThreadCount(int n);
+
 private:
+  static std::atomic<int> maxThreadCount;
+
   void initThreads();
   void workFunction(int id);
 
@@ -89,6 +98,8 @@ private:
 
   bool shouldStop;
   int workerInitPending;
+  // Trace scope that started the work, the workers are traced under its name
+  const char* traceName;
 
   class BaseThreadFunctor {
   public:
@@ -167,8 +178,10 @@ private:
   };
 #endif
 
+  // Workers passed as lvalues are referenced and have to outlive the work,
+  // temporaries are moved into the functor and live until the next start()
   template <typename WORKER> static ThreadRunner::BaseThreadFunctor* makeFunctor(WORKER&& w) {
-    return new ThreadRunner::ThreadFunctor< WORKER >(w);
+    return new ThreadRunner::ThreadFunctor< WORKER >(std::forward<WORKER>(w));
   }
 
   static ThreadRunner::BaseThreadFunctor* makeFunctor(void (*f)());
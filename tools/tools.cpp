@@ -22,33 +22,6 @@
 
 #include "tools.h"
 
-#include <QWidget>
-#include <QPalette>
-
-
-void setPaletteForStatus(QWidget *widget, bool ok) {
-  QPalette p = widget->palette();
-  if (ok) {
-    p.setColor(QPalette::Base, Qt::white);
-  } else {
-    p.setColor(QPalette::Base, QColor(255, 200, 200));
-  }
-  widget->setPalette(p);
-}
-
-QSizeF transformSize(const QSizeF& s, const QTransform& t) {
-  // Map center and unit vectors
-  QPointF c = t.map(QPointF(0,0));
-  QPointF ex = t.map(QPointF(1,0));
-  QPointF ey = t.map(QPointF(0,1));
-
-  // Calculate new width and height
-  double w = fasthypot((ex.x()-c.x())*s.width(), (ex.y()-c.y())*s.height());
-  double h = fasthypot((ey.x()-c.x())*s.width(), (ey.y()-c.y())*s.height());
-
-  return QSizeF(w, h);
-}
-
 Mean::Mean(): N(0), M1(0), M2(0) {};
 void Mean::add(double value) { N++; double oldM1 = M1; M1 += (value-M1)/N; M2 += (value-M1)*(value-oldM1); }
 double Mean::mean() { return M1; }
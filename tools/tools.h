@@ -23,10 +23,6 @@
 #ifndef TOOLS_H
 #define TOOLS_H
 
-class QWidget;
-class QSizeF;
-
-#include <QTransform>
 #include <cmath>
 
 static inline int ggt(int a, int b) {
@@ -74,9 +70,4 @@ struct Mean {
   double M2;
 };
 
-void setPaletteForStatus(QWidget* widget, bool ok);
-
-QSizeF transformSize(const QSizeF& s, const QTransform& t);
-
-
 #endif // TOOLS_H
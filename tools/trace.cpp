@@ -0,0 +1,231 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "tools/trace.h"
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QList>
+#include <QVector>
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+  struct TraceEvent {
+    const char* name;
+    qint64 start;
+    qint64 duration;
+  };
+
+  // Written only by its thread. Readers copy the events and drop those that
+  // the writer may have overwritten meanwhile. Clearing only moves the first
+  // valid event, so it does not race with the writer.
+  class TraceBuffer {
+  public:
+    static const int Size = 1<<14;
+
+    TraceBuffer(int _id, const QString& _name): head(0), cleared(0), events(Size), id(_id), name(_name) {}
+
+    void add(const char* n, qint64 start, qint64 duration) {
+      quint64 h = head.load(std::memory_order_relaxed);
+      TraceEvent& e = events[h & (Size-1)];
+      e.name = n;
+      e.start = start;
+      e.duration = duration;
+      head.store(h+1, std::memory_order_release);
+    }
+
+    QVector<TraceEvent> snapshot() const {
+      QVector<TraceEvent> r;
+      const quint64 size = Size;
+      quint64 h = head.load(std::memory_order_acquire);
+      quint64 first = std::max((h>size) ? h-size : 0, cleared.load(std::memory_order_acquire));
+      for (quint64 i=first; i<h; i++)
+        r << events[i & (Size-1)];
+      quint64 h2 = head.load(std::memory_order_acquire);
+      quint64 valid = (h2>=size) ? h2-size+1 : 0;
+      if (valid>first)
+        r.remove(0, std::min<int>(r.size(), static_cast<int>(valid-first)));
+      return r;
+    }
+
+    void clear() {
+      cleared.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    std::atomic<quint64> head;
+    std::atomic<quint64> cleared;
+    QVector<TraceEvent> events;
+    int id;
+    QString name;
+  };
+
+  QMutex& registryMutex() {
+    static QMutex m;
+    return m;
+  }
+
+  // Buffers are never deleted, so the events of finished threads are kept
+  QList<TraceBuffer*>& registry() {
+    static QList<TraceBuffer*> l;
+    return l;
+  }
+
+  // Buffers of finished threads, reused by new threads. Thus the registry
+  // only grows with the number of concurrent threads, not with the number of
+  // threads a QThreadPool started over time.
+  QList<TraceBuffer*>& freeBuffers() {
+    static QList<TraceBuffer*> l;
+    return l;
+  }
+
+  // Returns the buffer of its thread to freeBuffers() when the thread exits
+  class LocalBuffer {
+  public:
+    LocalBuffer(): buffer(nullptr) {}
+    ~LocalBuffer() {
+      if (buffer==nullptr) return;
+      QMutexLocker lock(&registryMutex());
+      freeBuffers() << buffer;
+    }
+    TraceBuffer* buffer;
+  };
+
+  thread_local LocalBuffer localBuffer;
+  thread_local const char* localScope = nullptr;
+
+  TraceBuffer* threadBuffer() {
+    if (localBuffer.buffer==nullptr) {
+      QMutexLocker lock(&registryMutex());
+      if (!freeBuffers().isEmpty()) {
+        // Keeps id and name, the events continue on the same track
+        localBuffer.buffer = freeBuffers().takeLast();
+      } else {
+        int id = registry().size()+1;
+        QThread* t = QThread::currentThread();
+        QString name = t ? t->objectName() : QString();
+        if (QCoreApplication::instance() && t==QCoreApplication::instance()->thread())
+          name = "Main";
+        if (name.isEmpty())
+          name = QString("Thread %1").arg(id);
+        localBuffer.buffer = new TraceBuffer(id, name);
+        registry() << localBuffer.buffer;
+      }
+    }
+    return localBuffer.buffer;
+  }
+
+  QString escape(const char* s) {
+    QString r = QString::fromLatin1(s);
+    r.replace('\\', "\\\\");
+    r.replace('"', "\\\"");
+    return r;
+  }
+
+}
+
+std::atomic<bool> Trace::enabled(false);
+
+void Trace::setEnabled(bool b) {
+  enabled.store(b);
+}
+
+void Trace::clear() {
+  QMutexLocker lock(&registryMutex());
+  foreach (TraceBuffer* b, registry())
+    b->clear();
+}
+
+qint64 Trace::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::record(const char* name, qint64 start, qint64 duration) {
+  threadBuffer()->add(name, start, duration);
+}
+
+const char* Trace::currentScope() {
+  return localScope;
+}
+
+void TraceScope::begin() {
+  parent = localScope;
+  localScope = name;
+  start = Trace::now();
+}
+
+void TraceScope::end() {
+  Trace::record(name, start, Trace::now()-start);
+  localScope = parent;
+}
+
+bool Trace::writeChromeTrace(const QString& filename) {
+  QFile f(filename);
+  if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+  QList<QPair<TraceBuffer*, QVector<TraceEvent> > > threads;
+  qint64 origin = -1;
+  {
+    QMutexLocker lock(&registryMutex());
+    foreach (TraceBuffer* b, registry()) {
+      QVector<TraceEvent> events = b->snapshot();
+      foreach (const TraceEvent& e, events)
+        if (origin<0 || e.start<origin) origin = e.start;
+      threads << qMakePair(b, events);
+    }
+  }
+
+  QTextStream out(&f);
+  qint64 pid = QCoreApplication::applicationPid();
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  out << QString("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%1,\"tid\":0,\"args\":{\"name\":\"Clip\"}}").arg(pid);
+  for (int n=0; n<threads.size(); n++) {
+    TraceBuffer* b = threads.at(n).first;
+    out << QString(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%1,\"tid\":%2,\"args\":{\"name\":\"%3\"}}").arg(pid).arg(b->id).arg(b->name);
+    foreach (const TraceEvent& e, threads.at(n).second) {
+      out << QString(",\n{\"name\":\"%1\",\"cat\":\"clip\",\"ph\":\"X\",\"pid\":%2,\"tid\":%3,\"ts\":%4,\"dur\":%5}")
+             .arg(escape(e.name)).arg(pid).arg(b->id)
+             .arg(1e-3*(e.start-origin), 0, 'f', 3).arg(1e-3*e.duration, 0, 'f', 3);
+    }
+  }
+  out << "\n]}\n";
+  out.flush();
+  return f.error()==QFile::NoError;
+}
+
+void Trace::startFromEnvironment() {
+  if (!qEnvironmentVariableIsEmpty("CLIP_TRACE"))
+    setEnabled(true);
+}
+
+void Trace::finishFromEnvironment() {
+  if (qEnvironmentVariableIsEmpty("CLIP_TRACE")) return;
+  setEnabled(false);
+  QString filename = QString::fromLocal8Bit(qgetenv("CLIP_TRACE"));
+  if (!writeChromeTrace(filename))
+    qWarning("Could not write trace %s", qPrintable(filename));
+}
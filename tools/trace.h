@@ -0,0 +1,88 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <atomic>
+
+// Low overhead tracing of scoped sections, e.g.
+//   void Crystal::applyRotation() {
+//     CLIP_TRACE("Crystal::applyRotation");
+// Every thread records into its own ring buffer without locking, so only the
+// latest events of each thread are kept. The names have to be string
+// literals. Tracing is off by default, a disabled trace point costs one
+// relaxed atomic load.
+class Trace {
+public:
+  static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+  static void setEnabled(bool b);
+  // Drops all recorded events
+  static void clear();
+
+  // Writes the events in the Chrome trace event format, that can be loaded
+  // in chrome://tracing or Perfetto
+  static bool writeChromeTrace(const QString& filename);
+
+  // Tracing from startup to exit into the file given by CLIP_TRACE
+  static void startFromEnvironment();
+  static void finishFromEnvironment();
+
+  // Name of the innermost trace scope of the calling thread, or nullptr
+  static const char* currentScope();
+
+  static qint64 now();
+  static void record(const char* name, qint64 start, qint64 duration);
+private:
+  static std::atomic<bool> enabled;
+};
+
+class TraceScope {
+public:
+  explicit TraceScope(const char* _name):
+      name(_name),
+      start(-1),
+      parent(nullptr)
+  {
+    if (Trace::isEnabled()) begin();
+  }
+  ~TraceScope() {
+    if (start>=0) end();
+  }
+private:
+  TraceScope(const TraceScope&);
+  TraceScope& operator=(const TraceScope&);
+
+  void begin();
+  void end();
+
+  const char* name;
+  qint64 start;
+  const char* parent;
+};
+
+#define CLIP_TRACE_CONCAT2(a, b) a##b
+#define CLIP_TRACE_CONCAT(a, b) CLIP_TRACE_CONCAT2(a, b)
+#define CLIP_TRACE(name) TraceScope CLIP_TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#endif // TRACE_H
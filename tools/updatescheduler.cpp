@@ -0,0 +1,119 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "tools/updatescheduler.h"
+#include "tools/trace.h"
+
+#include <QThread>
+#include <QMutexLocker>
+#include <QtDebug>
+#include <algorithm>
+
+UpdateScheduler* UpdateScheduler::instance = nullptr;
+
+UpdateScheduler* UpdateScheduler::getInstance() {
+  if (instance==nullptr)
+    instance = new UpdateScheduler();
+  return instance;
+}
+
+void UpdateScheduler::clearInstance() {
+  if (instance!=nullptr) {
+    if (!qgetenv("CLIP_UPDATE_STATS").isEmpty())
+      qDebug() << qPrintable(instance->statistics());
+    delete instance;
+    instance = nullptr;
+  }
+}
+
+UpdateScheduler::UpdateScheduler():
+    QObject(),
+    pending(),
+    frameTimer(),
+    lastFrame(),
+    statMutex(),
+    stages()
+{
+  frameTimer.setSingleShot(true);
+  connect(&frameTimer, SIGNAL(timeout()), this, SLOT(runFrame()));
+  lastFrame.start();
+}
+
+UpdateScheduler::~UpdateScheduler() {
+}
+
+void UpdateScheduler::schedule(QObject* o, const char* slot) {
+  if (QThread::currentThread()!=thread() || o->thread()!=thread()) {
+    QMetaObject::invokeMethod(o, slot, Qt::DirectConnection);
+    return;
+  }
+  foreach (const Job& j, pending)
+    if (j.target==o && j.slot==slot) return;
+
+  Job j;
+  j.target = o;
+  j.slot = slot;
+  pending << j;
+  if (!frameTimer.isActive())
+    frameTimer.start(std::max(0, FrameInterval-static_cast<int>(lastFrame.elapsed())));
+}
+
+void UpdateScheduler::runFrame() {
+  CLIP_TRACE("UpdateScheduler::runFrame");
+  lastFrame.restart();
+  // Requests made while running go to the next frame
+  QList<Job> jobs;
+  jobs.swap(pending);
+  foreach (const Job& j, jobs)
+    if (!j.target.isNull())
+      QMetaObject::invokeMethod(j.target.data(), j.slot.constData(), Qt::DirectConnection);
+}
+
+void UpdateScheduler::stageRequested(const QString& stage) {
+  QMutexLocker lock(&statMutex);
+  stages[stage].requests++;
+}
+
+void UpdateScheduler::stageDone(const QString& stage, qint64 nsecs) {
+  QMutexLocker lock(&statMutex);
+  Stage& s = stages[stage];
+  s.runs++;
+  s.nsecs += nsecs;
+  s.maxNsecs = std::max(s.maxNsecs, nsecs);
+}
+
+QString UpdateScheduler::statistics() {
+  QMutexLocker lock(&statMutex);
+  QString s("Stage                 requests   runs  dropped   mean ms    max ms\n");
+  for (QMap<QString, Stage>::const_iterator it=stages.constBegin(); it!=stages.constEnd(); ++it) {
+    const Stage& st = it.value();
+    double mean = (st.runs>0) ? 1e-6*st.nsecs/st.runs : 0.0;
+    s += QString("%1 %2 %3 %4 %5 %6\n")
+         .arg(it.key(), -20)
+         .arg(st.requests, 9)
+         .arg(st.runs, 6)
+         .arg(std::max(Q_INT64_C(0), st.requests-st.runs), 8)
+         .arg(mean, 9, 'f', 3)
+         .arg(1e-6*st.maxNsecs, 9, 'f', 3);
+  }
+  return s;
+}
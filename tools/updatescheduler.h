@@ -0,0 +1,86 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef UPDATESCHEDULER_H
+#define UPDATESCHEDULER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QString>
+
+// Merges update requests and runs them at most once per display frame. A
+// request only names the slot to call, so the slot always works on the
+// latest state of its object.
+class UpdateScheduler: public QObject {
+  Q_OBJECT
+public:
+  static UpdateScheduler* getInstance();
+  static void clearInstance();
+
+  static const int FrameInterval = 16;
+
+  // Calls slot of o in the next frame, repeated requests are merged.
+  // Objects living in other threads are updated immediately.
+  void schedule(QObject* o, const char* slot);
+
+  // Per stage statistics, requests that never ran were dropped as redundant
+  void stageRequested(const QString& stage);
+  void stageDone(const QString& stage, qint64 nsecs);
+  QString statistics();
+private slots:
+  void runFrame();
+private:
+  UpdateScheduler();
+  UpdateScheduler(const UpdateScheduler&);
+  UpdateScheduler& operator=(const UpdateScheduler&);
+  ~UpdateScheduler();
+
+  static UpdateScheduler* instance;
+
+  struct Job {
+    QPointer<QObject> target;
+    QByteArray slot;
+  };
+
+  struct Stage {
+    Stage(): requests(0), runs(0), nsecs(0), maxNsecs(0) {}
+    qint64 requests;
+    qint64 runs;
+    qint64 nsecs;
+    qint64 maxNsecs;
+  };
+
+  QList<Job> pending;
+  QTimer frameTimer;
+  QElapsedTimer lastFrame;
+
+  QMutex statMutex;
+  QMap<QString, Stage> stages;
+};
+
+#endif // UPDATESCHEDULER_H
@@ -0,0 +1,188 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "tools/workspacefile.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QTextStream>
+
+#include "tools/xmllistiterators.h"
+
+const char WorkspaceFile::Suffix_Xml[] = "cws";
+const char WorkspaceFile::Suffix_Binary[] = "cwb";
+const char WorkspaceFile::FileFilter[] = "Clip Workspace Data (*.cws *.cwb)";
+
+const char XML_Workspace_CrystalConnection[] = "CrystalConnection";
+const char XML_Workspace_ConnectedCrystal[] = "ConnectedCrystal";
+const char XML_Workspace_ConnectedProjectors[] = "ConnectedProjectors";
+
+const quint32 Binary_Magic = 0x434C5742; // "CLWB"
+const quint32 Binary_Version = 1;
+
+
+WorkspaceFile::Section::Section():
+    compressed(),
+    doc(),
+    root(),
+    parsed(false)
+{
+}
+
+QDomElement WorkspaceFile::Section::element() {
+  if (!parsed) {
+    parsed = true;
+    if (doc.setContent(qUncompress(compressed)))
+      root = doc.documentElement();
+    compressed.clear();
+  }
+  return root;
+}
+
+WorkspaceFile::Format WorkspaceFile::formatForFile(const QString& filename) {
+  return (QFileInfo(filename).suffix().compare(Suffix_Binary, Qt::CaseInsensitive)==0) ? Binary : Xml;
+}
+
+bool WorkspaceFile::isWorkspaceFile(const QString& filename) {
+  QString suffix = QFileInfo(filename).suffix();
+  return suffix.compare(Suffix_Xml, Qt::CaseInsensitive)==0 || suffix.compare(Suffix_Binary, Qt::CaseInsensitive)==0;
+}
+
+bool WorkspaceFile::read(const QString& filename) {
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+  return read(file.readAll());
+}
+
+bool WorkspaceFile::read(const QByteArray& data) {
+  crystalConnections.clear();
+  QDataStream in(data);
+  quint32 magic = 0;
+  in >> magic;
+  if (magic==Binary_Magic)
+    return readBinary(data);
+  return readXml(data);
+}
+
+bool WorkspaceFile::readXml(const QByteArray& data) {
+  // The sections refer to the elements of the document, which they keep alive
+  QDomDocument doc;
+  if (!doc.setContent(data))
+    return false;
+  // Looked up like the workspace loader always did, so existing files read the same
+  foreach (QDomElement connection, QDNLelements(doc.elementsByTagName(XML_Workspace_CrystalConnection))) {
+    Connection c;
+    c.crystal.doc = doc;
+    c.crystal.root = connection.elementsByTagName(XML_Workspace_ConnectedCrystal).at(0).toElement();
+    c.crystal.parsed = true;
+    QDomElement projectors = connection.elementsByTagName(XML_Workspace_ConnectedProjectors).at(0).toElement();
+    for (QDomElement e=projectors.firstChildElement(); !e.isNull(); e=e.nextSiblingElement()) {
+      Section s;
+      s.doc = doc;
+      s.root = e;
+      s.parsed = true;
+      c.projectors << s;
+    }
+    crystalConnections << c;
+  }
+  return true;
+}
+
+bool WorkspaceFile::readBinary(const QByteArray& data) {
+  QDataStream in(data);
+  in.setVersion(QDataStream::Qt_5_0);
+  quint32 magic, version, connectionCount;
+  in >> magic >> version;
+  if (version>Binary_Version)
+    return false;
+  in >> connectionCount;
+  for (quint32 i=0; i<connectionCount && in.status()==QDataStream::Ok; i++) {
+    Connection c;
+    quint32 projectorCount;
+    in >> c.crystal.compressed >> projectorCount;
+    for (quint32 j=0; j<projectorCount && in.status()==QDataStream::Ok; j++) {
+      Section s;
+      in >> s.compressed;
+      c.projectors << s;
+    }
+    crystalConnections << c;
+  }
+  if (in.status()!=QDataStream::Ok) {
+    crystalConnections.clear();
+    return false;
+  }
+  return true;
+}
+
+QByteArray WorkspaceFile::compressSection(const QDomElement& e) {
+  QString text;
+  QTextStream ts(&text);
+  e.save(ts, 0);
+  ts.flush();
+  return qCompress(text.toUtf8());
+}
+
+bool WorkspaceFile::write(const QString& filename, const QDomDocument& doc, Format format) {
+  if (format==Xml) {
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+      return false;
+    QTextStream ts(&file);
+    doc.save(ts, 2);
+    ts.flush();
+    return file.commit();
+  }
+
+  QList<CompressedConnection> connections;
+  for (QDomElement connection=doc.documentElement().firstChildElement(XML_Workspace_CrystalConnection); !connection.isNull(); connection=connection.nextSiblingElement(XML_Workspace_CrystalConnection)) {
+    CompressedConnection c;
+    c.crystal = compressSection(connection.firstChildElement(XML_Workspace_ConnectedCrystal));
+    QDomElement planes = connection.firstChildElement(XML_Workspace_ConnectedProjectors);
+    for (QDomElement e=planes.firstChildElement(); !e.isNull(); e=e.nextSiblingElement())
+      c.projectors << compressSection(e);
+    connections << c;
+  }
+  return writeBinary(filename, connections);
+}
+
+bool WorkspaceFile::writeBinary(const QString& filename, const QList<CompressedConnection>& connections) {
+  QSaveFile file(filename);
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+
+  QDataStream out(&file);
+  out.setVersion(QDataStream::Qt_5_0);
+  out << Binary_Magic << Binary_Version << quint32(connections.size());
+  foreach (const CompressedConnection& c, connections) {
+    out << c.crystal << quint32(c.projectors.size());
+    foreach (const QByteArray& projector, c.projectors)
+      out << projector;
+  }
+  if (out.status()!=QDataStream::Ok) {
+    file.cancelWriting();
+    return false;
+  }
+  return file.commit();
+}
@@ -0,0 +1,92 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef WORKSPACEFILE_H
+#define WORKSPACEFILE_H
+
+#include <QDomDocument>
+#include <QDomElement>
+#include <QByteArray>
+#include <QString>
+#include <QList>
+
+#include "config.h"
+
+// Workspace files hold crystal connections, each made of a crystal and the
+// projectors connected to it. The XML format (.cws) is parsed in one pass as
+// before. The binary format (.cwb) stores every section compressed, and a
+// section is only parsed into a DOM tree when it is requested.
+class WorkspaceFile {
+public:
+  enum Format {
+    Xml,
+    Binary
+  };
+
+  class Section {
+  public:
+    Section();
+    // Parses the section on the first call, null if it is invalid
+    QDomElement element();
+  private:
+    friend class WorkspaceFile;
+    QByteArray compressed;
+    QDomDocument doc;
+    QDomElement root;
+    bool parsed;
+  };
+
+  struct Connection {
+    Section crystal;
+    QList<Section> projectors;
+  };
+
+  // A connection of sections already compressed with compressSection
+  struct CompressedConnection {
+    QByteArray crystal;
+    QList<QByteArray> projectors;
+  };
+
+  static const char Suffix_Xml[];
+  static const char Suffix_Binary[];
+  static const char FileFilter[];
+
+  static Format formatForFile(const QString& filename);
+  static bool isWorkspaceFile(const QString& filename);
+
+  bool read(const QString& filename);
+  bool read(const QByteArray& data);
+  QList<Connection> connections() const { return crystalConnections; }
+
+  // doc is a workspace as built by Clip, the XML format is written unchanged
+  static bool write(const QString& filename, const QDomDocument& doc, Format format);
+  // Both replace the file atomically, so it is never left half written
+  static bool writeBinary(const QString& filename, const QList<CompressedConnection>& connections);
+  static QByteArray compressSection(const QDomElement& e);
+private:
+  bool readXml(const QByteArray& data);
+  bool readBinary(const QByteArray& data);
+
+  QList<Connection> crystalConnections;
+};
+
+#endif // WORKSPACEFILE_H
@@ -30,6 +30,8 @@
 #include <QSettings>
 #include <QTimer>
 #include <QDesktopServices>
+#include <QStatusBar>
+#include <QDateTime>
 
 #include "defs.h"
 #include "core/projector.h"
@@ -43,15 +45,23 @@
 #include "ui/reorient.h"
 #include "core/crystal.h"
 #include "core/projectorfactory.h"
-#include "tools/xmllistiterators.h"
 #include "ui/clipconfig.h"
+#include "ui/memorydisplay.h"
 #include "config/configstore.h"
+#include "tools/updatescheduler.h"
+#include "server/queryserver.h"
+#include "tools/trace.h"
+#include "tools/autosaver.h"
+#include "tools/startuptiming.h"
 
 Clip::Clip(QWidget *_parent) :
     QMainWindow(_parent),
-    ui(new Ui::Clip)
+    ui(new Ui::Clip),
+    queryServer(nullptr),
+    autoSaver(nullptr)
 {
   ui->setupUi(this);
+  autoSaver = new AutoSaver(ui->mdiArea, this);
 
   windowMapper = new QSignalMapper(this);
   connect(windowMapper, SIGNAL(mapped(QWidget*)),
@@ -68,6 +78,17 @@ Clip::Clip(QWidget *_parent) :
 #endif
   QDesktopServices::setUrlHandler("call", this, "showSEE");
 
+  QAction* queryAction = ui->menuTools->addAction("Query Server");
+  queryAction->setCheckable(true);
+  connect(queryAction, SIGNAL(toggled(bool)), this, SLOT(enableQueryServer(bool)));
+  if (!qEnvironmentVariableIsEmpty("CLIP_QUERY_SERVER"))
+    queryAction->setChecked(true);
+
+  QAction* traceAction = ui->menuTools->addAction("Record Trace");
+  traceAction->setCheckable(true);
+  traceAction->setChecked(Trace::isEnabled());
+  connect(traceAction, SIGNAL(toggled(bool)), this, SLOT(recordTrace(bool)));
+
   QTimer::singleShot(0, this, SLOT(loadInitialWorkspace()));
 }
 
@@ -90,6 +111,7 @@ Clip* Clip::getInstance() {
 
 void Clip::clearInstance() {
   ConfigStore::clearInstance();
+  UpdateScheduler::clearInstance();
   if (instance!=nullptr) {
     delete instance;
     instance = nullptr;
@@ -295,6 +317,41 @@ void Clip::on_actionReorientation_triggered() {
   raiseOrCreateToolWindow<Reorient>();
 }
 
+void Clip::enableQueryServer(bool b) {
+  if (!b) {
+    delete queryServer;
+    queryServer = nullptr;
+    return;
+  }
+  if (queryServer==nullptr)
+    queryServer = new QueryServer(this);
+  QString name = QString::fromLocal8Bit(qgetenv("CLIP_QUERY_SERVER"));
+  if (name.isEmpty())
+    name = QueryServer::DefaultName;
+  if (queryServer->listen(name)) {
+    statusBar()->showMessage(QString("Query server listening on %1").arg(queryServer->serverName()), 5000);
+  } else {
+    QMessageBox::warning(this, "Query Server", QString("Could not listen on %1").arg(name));
+    if (QAction* a = qobject_cast<QAction*>(sender()))
+      a->setChecked(false);
+  }
+}
+
+void Clip::recordTrace(bool b) {
+  if (b) {
+    Trace::clear();
+    Trace::setEnabled(true);
+    statusBar()->showMessage("Recording trace", 5000);
+    return;
+  }
+  Trace::setEnabled(false);
+  QString filename = QFileDialog::getSaveFileName(this, "Save Trace", QString(), "Chrome Trace (*.json)");
+  if (filename.isEmpty())
+    return;
+  if (!Trace::writeChromeTrace(filename))
+    QMessageBox::warning(this, "Save Trace", QString("Could not write %1").arg(filename));
+}
+
 template <class T> T* Clip::raiseOrCreateToolWindow() {
   foreach (QMdiSubWindow* mdi, ui->mdiArea->subWindowList()) {
     if (dynamic_cast<T*>(mdi->widget())) {
@@ -312,13 +369,26 @@ template <class T> T* Clip::raiseOrCreateToolWindow() {
 void Clip::on_actionOpen_Workspace_triggered() {
   QSettings settings;
   QString filename = QFileDialog::getOpenFileName(this, "Load Workspace", settings.value("LastDirectory").toString(),
-                                                  "Clip Workspace Data (*.cws);;All Files (*)");
+                                                  QString("%1;;All Files (*)").arg(WorkspaceFile::FileFilter));
   if (loadWorkspaceFile(filename))
     settings.setValue("LastDirectory", QFileInfo(filename).canonicalFilePath());
 }
 
 void Clip::loadInitialWorkspace() {
   // Needs to be a slot, because the windows are not placed correctly otherwise
+  StartupTiming::mark("Event loop started");
+  foreach (QString file, AutoSaver::staleAutosaves()) {
+    // Held while asking, so another instance starting now does not offer it as well
+    QLockFile lock(AutoSaver::lockFile(file));
+    lock.setStaleLockTime(0);
+    if (!lock.tryLock(0)) continue;
+    QFileInfo autosave(file);
+    QString question = QString("Clip was not closed properly. Restore the workspace autosaved at %1?").arg(autosave.lastModified().toString(Qt::SystemLocaleShortDate));
+    bool restored = QMessageBox::question(this, "Restore Workspace", question, QMessageBox::Yes | QMessageBox::No)==QMessageBox::Yes && loadWorkspaceFile(file);
+    // Restored workspaces are autosaved by this instance from now on
+    AutoSaver::discardAutosave(file);
+    if (restored) return;
+  }
   QString filename = ConfigStore::getInstance()->initialWorkspaceFile();
   QFileInfo fInfo(filename);
   if (!fInfo.isReadable())
@@ -333,19 +403,14 @@ const char XML_Clip_ConnectedCrystal[] = "ConnectedCrystal";
 const char XML_Clip_ConnectedProjectors[] = "ConnectedProjectors";
 
 bool Clip::loadWorkspaceFile(QString filename) {
-  QDomDocument doc("ClipWorkspace");
-  QFile file(filename);
-  if (!file.open(QIODevice::ReadOnly))
+  WorkspaceFile workspace;
+  if (!workspace.read(filename))
     return false;
-  if (!doc.setContent(&file)) {
-    file.close();
-    return false;
-  }
+  StartupTiming::mark("Workspace file read");
 
-  file.close();
-
-  foreach (QDomElement crystalConnection, QDNLelements(doc.elementsByTagName(XML_Clip_CrystalConnection))) {
-    QDomElement e = crystalConnection.elementsByTagName(XML_Clip_ConnectedCrystal).at(0).toElement();
+  // The crystals are shown first, the projectors with their images follow
+  foreach (WorkspaceFile::Connection connection, workspace.connections()) {
+    QDomElement e = connection.crystal.element();
     if (e.isNull()) continue;
     CrystalDisplay* crystalDisplay = new CrystalDisplay();
     addMdiWindow(crystalDisplay)->systemMenu()->addAction("Save as Default", crystalDisplay->getCrystal(), SLOT(saveParametersAsDefault()));
@@ -356,21 +421,45 @@ bool Clip::loadWorkspaceFile(QString filename) {
     }
 #endif
     crystalDisplay->loadFromXML(e);
-    e = crystalConnection.elementsByTagName(XML_Clip_ConnectedProjectors).at(0).toElement();
-    for (e=e.firstChildElement(); !e.isNull(); e=e.nextSiblingElement()) {
-      ProjectionPlane* pp = addProjector(ProjectorFactory::getInstance().getProjector(e.attribute("projectortype")));
-      if (pp) {
-        pp->loadFromXML(e);
-        pp->getProjector()->connectToCrystal(crystalDisplay->getCrystal());
-      }
-    }
+    foreach (WorkspaceFile::Section projector, connection.projectors)
+      pendingProjectors << qMakePair(QPointer<CrystalDisplay>(crystalDisplay), projector);
+  }
+  if (!pendingProjectors.isEmpty()) {
+    QTimer::singleShot(0, this, SLOT(loadPendingProjector()));
+  } else {
+    StartupTiming::mark("Initial workspace shown");
+    emit workspaceLoaded();
   }
   return true;
 }
 
+void Clip::loadPendingProjector() {
+  if (pendingProjectors.isEmpty()) return;
+  QPair<QPointer<CrystalDisplay>, WorkspaceFile::Section> p = pendingProjectors.takeFirst();
+  QDomElement e = p.second.element();
+  // The crystal window may have been closed meanwhile
+  if (p.first && !e.isNull()) {
+    ProjectionPlane* pp = addProjector(ProjectorFactory::getInstance().getProjector(e.attribute("projectortype")));
+    if (pp) {
+      pp->loadFromXML(e);
+      pp->getProjector()->connectToCrystal(p.first->getCrystal());
+    }
+  }
+  if (!pendingProjectors.isEmpty()) {
+    QTimer::singleShot(0, this, SLOT(loadPendingProjector()));
+  } else {
+    StartupTiming::mark("Initial workspace shown");
+    emit workspaceLoaded();
+  }
+}
+
 
 
 void Clip::on_actionSave_Workspace_triggered() {
+  // Projectors of a workspace that is still being opened belong into the file
+  while (!pendingProjectors.isEmpty())
+    loadPendingProjector();
+
   QDomDocument doc(XML_Clip_Workspace);
   QDomElement docElement = doc.appendChild(doc.createElement(XML_Clip_Workspace)).toElement();
   foreach (QMdiSubWindow* mdi, ui->mdiArea->subWindowList()) {
@@ -388,17 +477,16 @@ void Clip::on_actionSave_Workspace_triggered() {
   }
 
   QSettings settings;
+  QString selectedFilter;
   QString filename = QFileDialog::getSaveFileName(this, "Save Workspace", settings.value("LastDirectory").toString(),
-                                                  "Clip Workspace Data (*.cws);;All Files (*)");
-
-  QFile file(filename);
-  if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-    QTextStream ts(&file);
-    doc.save(ts, 2);
-    file.close();
+                                                  "Clip Workspace Data (*.cws);;Clip Binary Workspace (*.cwb);;All Files (*)",
+                                                  &selectedFilter);
+  if (filename.isEmpty()) return;
+  if (selectedFilter.contains("*.cwb") && QFileInfo(filename).suffix().isEmpty())
+    filename += ".cwb";
 
+  if (WorkspaceFile::write(filename, doc, WorkspaceFile::formatForFile(filename)))
     settings.setValue("LastDirectory", QFileInfo(filename).canonicalFilePath());
-  }
 }
 
 void Clip::on_actionToggleSpotsEnabled_triggered() {
@@ -417,6 +505,10 @@ void Clip::on_actionConfiguration_triggered() {
   addMdiWindow(new ClipConfig(this));
 }
 
+void Clip::on_actionMemory_Usage_triggered() {
+  addMdiWindow(new MemoryDisplay(this));
+}
+
 #include "ui/sadeasteregg.h"
 void Clip::showSEE(QUrl) {
   SadEasterEgg see;
@@ -26,14 +26,20 @@
 #include <QMainWindow>
 #include <QSignalMapper>
 #include <QUrl>
+#include <QPointer>
+#include <QPair>
 
 #include "tools/mousepositioninfo.h"
+#include "tools/workspacefile.h"
 
 class Projector;
 class ProjectionPlane;
 class Crystal;
+class CrystalDisplay;
 class MousePositionInfo;
 class QMdiSubWindow;
+class QueryServer;
+class AutoSaver;
 
 namespace Ui {
   class Clip;
@@ -58,6 +64,8 @@ signals:
   void windowChanged();
   void mousePositionInfo(MousePositionInfo);
   void highlightMarker(Vec3D);
+  // All windows of a loaded workspace are shown
+  void workspaceLoaded();
 public slots:
   // Menu Slots
   void on_newCrystal_triggered();
@@ -94,6 +102,12 @@ private:
   QAction *separatorAct;
   QSignalMapper *windowMapper;
 
+  QueryServer* queryServer;
+  AutoSaver* autoSaver;
+
+  // Projectors of a loaded workspace, created one per event loop iteration
+  QList<QPair<QPointer<CrystalDisplay>, WorkspaceFile::Section> > pendingProjectors;
+
 private slots:
     void on_actionConfiguration_triggered();
     void on_actionToggleMarkerEnabled_triggered();
@@ -103,6 +117,10 @@ private slots:
     void on_actionReorientation_triggered();
     void on_actionRotation_triggered();
     void on_actionReflection_Info_triggered();
+    void on_actionMemory_Usage_triggered();
+    void enableQueryServer(bool);
+    void loadPendingProjector();
+    void recordTrace(bool);
     void showSEE(QUrl);
 };
 
@@ -70,6 +70,20 @@ ClipConfig::ClipConfig(QWidget* _parent) :
 
   ui->initailCWSFile->setText(config->initialWorkspaceFile());
   connect(ui->initailCWSFile, SIGNAL(textChanged(QString)), config, SLOT(setInitialWorkspaceFile(QString)));
+
+  ui->imageMemoryBudget->setValue(config->imageMemoryBudget());
+  connect(ui->imageMemoryBudget, SIGNAL(valueChanged(int)), config, SLOT(setImageMemoryBudget(int)));
+
+  ui->scratchDirectory->setText(config->scratchDirectory());
+  connect(ui->scratchDirectory, SIGNAL(textChanged(QString)), config, SLOT(setScratchDirectory(QString)));
+
+  ui->frameCacheEnabled->setChecked(config->frameCacheEnabled());
+  connect(ui->frameCacheEnabled, SIGNAL(toggled(bool)), config, SLOT(setFrameCacheEnabled(bool)));
+  ui->frameCacheSize->setValue(config->frameCacheSize());
+  connect(ui->frameCacheSize, SIGNAL(valueChanged(int)), config, SLOT(setFrameCacheSize(int)));
+
+  ui->autosaveInterval->setValue(config->autosaveInterval());
+  connect(ui->autosaveInterval, SIGNAL(valueChanged(int)), config, SLOT(setAutosaveInterval(int)));
 }
 
 ClipConfig::~ClipConfig()
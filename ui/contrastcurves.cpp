@@ -174,16 +174,13 @@ void ContrastCurves::makeVScale() {
   int h = vScalePix.height();
   if (laueImage.isNull()) return;
   QList<BezierCurve*> bezierCurves = laueImage->getTransferCurves();
-  QList<float> V = bezierCurves[0]->range(0.0, 1.0/(h-1), h);
-  QList<float> R = bezierCurves[1]->map(V);
-  QList<float> G = bezierCurves[2]->map(V);
-  QList<float> B = bezierCurves[3]->map(V);
 
   for (int y=0; y<h; y++) {
-    int v = int(255.0*V[y]);
-    int r = int(255.0*R[y]);
-    int g = int(255.0*G[y]);
-    int b = int(255.0*B[y]);
+    float V = bezierCurves[0]->lookup(1.0f*y/(h-1));
+    int v = int(255.0*V);
+    int r = int(255.0*bezierCurves[1]->lookup(V));
+    int g = int(255.0*bezierCurves[2]->lookup(V));
+    int b = int(255.0*bezierCurves[3]->lookup(V));
     p.setPen(QColor(r,g,b));
     p.drawLine(0, h-y-1, w/2, h-y-1);
 
@@ -39,7 +39,7 @@
 #include "core/spacegroup.h"
 #include "ui/hkltool.h"
 #include "ui/clip.h"
-#include "tools/tools.h"
+#include "tools/guitools.h"
 #include "tools/xmltools.h"
 
 CrystalDisplay::CrystalDisplay(QWidget* _parent) :
@@ -0,0 +1,111 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#include "memorydisplay.h"
+#include "ui_memorydisplay.h"
+
+#include <QSpinBox>
+#include <QTimer>
+#include <QFileDialog>
+#include <QMessageBox>
+
+#include "config/configstore.h"
+#include "tools/memoryaccounting.h"
+
+
+static QString formatBytes(qint64 bytes) {
+  if (bytes<(1<<10)) return QString("%1 B").arg(bytes);
+  if (bytes<(1<<20)) return QString("%1 KB").arg(bytes/1024.0, 0, 'f', 1);
+  if (bytes<(1<<30)) return QString("%1 MB").arg(bytes/1048576.0, 0, 'f', 1);
+  return QString("%1 GB").arg(bytes/1073741824.0, 0, 'f', 2);
+}
+
+MemoryDisplay::MemoryDisplay(QWidget* _parent) :
+    QMainWindow(_parent),
+    ui(new Ui::MemoryDisplay)
+{
+  ui->setupUi(this);
+
+  ConfigStore* config = ConfigStore::getInstance();
+  for (int s=0; s<=MemoryAccounting::SubsystemCount; s++) {
+    bool total = (s==MemoryAccounting::SubsystemCount);
+    QTreeWidgetItem* item = new QTreeWidgetItem(ui->accountTree);
+    item->setText(0, total ? QString("Total") : MemoryAccounting::subsystemName(s));
+    subsystemItems << item;
+
+    QSpinBox* budget = new QSpinBox(ui->accountTree);
+    budget->setRange(0, 1<<20);
+    budget->setSuffix(" MB");
+    budget->setSpecialValueText("None");
+    budget->setValue(total ? config->totalMemoryBudget() : config->subsystemMemoryBudget(s));
+    connect(budget, SIGNAL(valueChanged(int)), this, SLOT(budgetChanged()));
+    ui->accountTree->setItemWidget(item, 2, budget);
+    budgetEdits << budget;
+  }
+
+  updateDisplay();
+  ui->accountTree->resizeColumnToContents(0);
+
+  QTimer* timer = new QTimer(this);
+  connect(timer, SIGNAL(timeout()), this, SLOT(updateDisplay()));
+  timer->start(1000);
+}
+
+MemoryDisplay::~MemoryDisplay() {
+  delete ui;
+}
+
+void MemoryDisplay::updateDisplay() {
+  MemoryAccounting* accounting = MemoryAccounting::getInstance();
+  QList<MemoryAccounting::Entry> entries = accounting->entries();
+  for (int s=0; s<MemoryAccounting::SubsystemCount; s++) {
+    QTreeWidgetItem* item = subsystemItems.at(s);
+    item->setText(1, formatBytes(accounting->usage(s)));
+    QList<MemoryAccounting::Entry> objects;
+    foreach (const MemoryAccounting::Entry& e, entries) {
+      if (e.subsystem==s && e.bytes>0) objects << e;
+    }
+    while (item->childCount()>objects.size())
+      delete item->takeChild(item->childCount()-1);
+    while (item->childCount()<objects.size())
+      new QTreeWidgetItem(item);
+    for (int n=0; n<objects.size(); n++) {
+      item->child(n)->setText(0, objects.at(n).name);
+      item->child(n)->setText(1, formatBytes(objects.at(n).bytes));
+    }
+  }
+  subsystemItems.last()->setText(1, formatBytes(accounting->totalUsage()));
+}
+
+void MemoryDisplay::budgetChanged() {
+  ConfigStore* config = ConfigStore::getInstance();
+  for (int s=0; s<MemoryAccounting::SubsystemCount; s++)
+    config->setSubsystemMemoryBudget(s, budgetEdits.at(s)->value());
+  config->setTotalMemoryBudget(budgetEdits.last()->value());
+}
+
+void MemoryDisplay::on_exportButton_clicked() {
+  QString filename = QFileDialog::getSaveFileName(this, "Export Memory Usage", QString(), "CSV (*.csv)");
+  if (filename.isEmpty()) return;
+  if (!MemoryAccounting::getInstance()->writeReport(filename))
+    QMessageBox::warning(this, "Export Memory Usage", QString("Could not write %1").arg(filename));
+}
@@ -0,0 +1,62 @@
+/**********************************************************************
+  Copyright (C) 2008-2011 Olaf J. Schumann
+
+  This file is part of the Cologne Laue Indexation Program.
+  For more information, see <http://clip4.sf.net>
+
+  Clip is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Clip is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see http://www.gnu.org/licenses/
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA 02110-1301, USA.
+ **********************************************************************/
+
+#ifndef MEMORYDISPLAY_H
+#define MEMORYDISPLAY_H
+
+#include <QMainWindow>
+#include <QList>
+
+#include "config.h"
+
+namespace Ui {
+  class MemoryDisplay;
+}
+
+class QSpinBox;
+class QTreeWidgetItem;
+
+// Shows the memory accounted per subsystem and object, and edits the soft
+// budgets of the subsystems
+class MemoryDisplay : public QMainWindow
+{
+  Q_OBJECT
+
+public:
+  explicit MemoryDisplay(QWidget* _parent = nullptr);
+  virtual ~MemoryDisplay();
+
+protected slots:
+  void updateDisplay();
+  void budgetChanged();
+
+private:
+  Ui::MemoryDisplay *ui;
+  // One item per subsystem, the last for the total
+  QList<QTreeWidgetItem*> subsystemItems;
+  QList<QSpinBox*> budgetEdits;
+
+private slots:
+  void on_exportButton_clicked();
+};
+
+#endif // MEMORYDISPLAY_H
@@ -23,16 +23,18 @@
 #include "monoscalercfg.h"
 #include "ui_monoscalercfg.h"
 
-MonoScalerCfg::MonoScalerCfg(bool histEq, bool logMap, QWidget *parent):
+MonoScalerCfg::MonoScalerCfg(bool histEq, bool logMap, int downsampling, QWidget *parent):
     QWidget(parent),
     ui(new Ui::MonoScalerCfg)
 {
     ui->setupUi(this);
     ui->histEq->setChecked(histEq);
     ui->logMap->setChecked(logMap);
+    ui->downsampling->setCurrentIndex(downsampling);
 
     connect(ui->histEq, SIGNAL(toggled(bool)), this, SIGNAL(histogramEq(bool)));
     connect(ui->logMap, SIGNAL(toggled(bool)), this, SIGNAL(logMapping(bool)));
+    connect(ui->downsampling, SIGNAL(currentIndexChanged(int)), this, SIGNAL(downsamplingMode(int)));
 }
 
 MonoScalerCfg::~MonoScalerCfg()
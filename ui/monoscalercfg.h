@@ -34,11 +34,12 @@ class MonoScalerCfg : public QWidget
   Q_OBJECT
 
 public:
-  explicit MonoScalerCfg(bool histEq, bool logMap, QWidget *parent = 0);
+  explicit MonoScalerCfg(bool histEq, bool logMap, int downsampling, QWidget *parent = 0);
   ~MonoScalerCfg();
 signals:
   void histogramEq(bool);
   void logMapping(bool);
+  void downsamplingMode(int);
 private:
   Ui::MonoScalerCfg *ui;
 };
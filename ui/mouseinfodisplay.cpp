@@ -33,7 +33,7 @@
 //#include "core/crystal.h"
 //#include "core/projector.h"
 #include "tools/indexparser.h"
-#include "tools/tools.h"
+#include "tools/guitools.h"
 
 
 
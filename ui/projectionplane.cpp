@@ -53,6 +53,7 @@
 #include "tools/xmltools.h"
 #include "image/laueimage.h"
 #include "image/dataproviderfactory.h"
+#include "image/watcheddirectoryprovider.h"
 
 #include "tools/tools.h"
 #include "tools/spotitem.h"
@@ -343,6 +344,18 @@ void ProjectionPlane::on_openImgAction_triggered() {
 
 }
 
+void ProjectionPlane::on_watchDirAction_triggered() {
+  QString dirName = QFileDialog::getExistingDirectory(this,
+                                                      "Watch Directory for new Laue patterns",
+                                                      QSettings().value("LastDirectory").toString());
+  QFileInfo fInfo(dirName);
+
+  if (fInfo.isDir()) {
+    QSettings().setValue("LastDirectory", fInfo.canonicalFilePath());
+    projector->loadImage(dirName);
+  }
+}
+
 void ProjectionPlane::generateMousePositionInfoFromView(QPointF p) {
   if (!inMousePress)
     generateMousePositionInfo(p);
@@ -449,10 +462,16 @@ void ProjectionPlane::on_actionCrop_triggered() {
 
 void ProjectionPlane::imageLoaded(LaueImage *img) {
   setWindowTitle(projector->displayName()+": "+img->name());
+  connect(img, SIGNAL(frameChanged(LaueImage*)), this, SLOT(imageFrameChanged(LaueImage*)));
   ui->imgToolBar->setVisible(true);
   resizeView();
 }
 
+void ProjectionPlane::imageFrameChanged(LaueImage *img) {
+  QString latency = img->getInfo(WatchedDirectoryProvider::Info_IngestLatency).toString();
+  setWindowTitle(projector->displayName()+": "+img->name()+(latency.isEmpty() ? "" : " ("+latency+")"));
+}
+
 void ProjectionPlane::imageClosed() {
   setWindowTitle(projector->displayName());
   ui->imgToolBar->setVisible(false);
@@ -86,6 +86,7 @@ protected slots:
   void slotContextClearRulers();
   void slotContextClearAll();
   void imageLoaded(LaueImage*);
+  void imageFrameChanged(LaueImage*);
   void imageClosed();
   void saveParametersAsProjectorDefault();
 protected:
@@ -119,6 +120,7 @@ private slots:
   void on_rotCWAction_triggered();
   void on_configAction_triggered();
   void on_openImgAction_triggered();
+  void on_watchDirAction_triggered();
   void on_closeImgAction_triggered();
 };
 
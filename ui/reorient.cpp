@@ -28,7 +28,7 @@
 #include "tools/indexparser.h"
 #include "core/crystal.h"
 #include "ui/clip.h"
-#include "tools/tools.h"
+#include "tools/guitools.h"
 
 
 Reorient::Reorient(QWidget* _parent) :
@@ -113,45 +113,51 @@ bool Reorient::calcRotationAngles(double &angle1, double &angle2) {
   Vec3D nto = toNormal();
   if (nto.isNull()) return false;
 
+  double score = -1;
+  typedef QPair<double, double> AnglePair;
+  foreach (AnglePair a, calcRotationSolutions(gonioAxis.at(0), gonioAxis.at(1), nfrom, nto)) {
+    if ((score<0) || (score > (a.first*a.first+a.second*a.second))) {
+      angle1 = a.first;
+      angle2 = a.second;
+      score = (a.first*a.first+a.second*a.second);
+    }
+  }
+  if (score<0) return false;
+  return true;
+}
+
+QList<QPair<double, double> > Reorient::calcRotationSolutions(const Vec3D& axis1, const Vec3D& axis2, const Vec3D& nfrom, const Vec3D& nto) {
+  QList<QPair<double, double> > r;
   // Calculates a line u1+lambda*u2 in 3d-space, that is the intersection of the
   // two planes with normal Vector
-  // gonioAxis[0] and gonioAxis[1] and that contain nFrom and nTo, respectively
+  // axis1 and axis2 and that contain nFrom and nTo, respectively
   Vec3D u1, u2;
-  if (!calcLine(nfrom, nto, u1, u2)) return false;
+  if (!calcLine(axis1, axis2, nfrom, nto, u1, u2)) return r;
 
-
-  double score = -1;
   // check the up to two points of intersection of the line with the unit sphere
   foreach (Vec3D v, calcPossibleIntermediatePositions(u1, u2)) {
-    double aChi=calcRotationAngle(nfrom, v, gonioAxis.at(0));
-    double aPhi=calcRotationAngle(v, nto, gonioAxis.at(1));
-    if ((score<0) || (score > (aChi*aChi+aPhi*aPhi))) {
-      angle1 = aChi;
-      angle2 = aPhi;
-      score = (aChi*aChi+aPhi*aPhi);
-    }
+    r << qMakePair(calcRotationAngle(nfrom, v, axis1), calcRotationAngle(v, nto, axis2));
   }
-  if (score<0) return false;
-  return true;
+  return r;
 }
 
 
-bool Reorient::calcLine(const Vec3D& nfrom, const Vec3D& nto, Vec3D& u1, Vec3D& u2) {
-  u2 = gonioAxis.at(0) % gonioAxis.at(1);
+bool Reorient::calcLine(const Vec3D& axis1, const Vec3D& axis2, const Vec3D& nfrom, const Vec3D& nto, Vec3D& u1, Vec3D& u2) {
+  u2 = axis1 % axis2;
   if (u2.norm()<1e-6) return false;
   u2.normalize();
 
-  double pc = gonioAxis.at(0) * gonioAxis.at(1);
+  double pc = axis1 * axis2;
   double denom = 1.0-pc*pc;
   if (denom<1e-6) return false;
 
-  double t1 = nfrom * gonioAxis.at(0);
-  double t2 = nto   * gonioAxis.at(1);
+  double t1 = nfrom * axis1;
+  double t2 = nto   * axis2;
 
   double lambda = (t2-pc*t1)/denom;
   double mu     = (t1-pc*t2)/denom;
 
-  u1 = gonioAxis.at(1)*lambda + gonioAxis.at(0)*mu;
+  u1 = axis2*lambda + axis1*mu;
 
   return true;
 }
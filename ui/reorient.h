@@ -43,6 +43,10 @@ public:
   explicit Reorient(QWidget* _parent = nullptr);
   virtual ~Reorient();
   virtual QSize sizeHint() const;
+
+  // All pairs of angles (in rad) that bring nfrom onto nto by a rotation about
+  // axis1 followed by a rotation about axis2
+  static QList<QPair<double, double> > calcRotationSolutions(const Vec3D& axis1, const Vec3D& axis2, const Vec3D& nfrom, const Vec3D& nto);
 public slots:
   void updateDisplay();
 
@@ -53,9 +57,9 @@ private:
   Vec3D toNormal();
 
   bool calcRotationAngles(double& angle1, double& angle2);
-  bool calcLine(const Vec3D& nfrom, const Vec3D& nto, Vec3D& r1, Vec3D& r2);
-  QList<Vec3D> calcPossibleIntermediatePositions(const Vec3D& u1, const Vec3D& u2);
-  double calcRotationAngle(const Vec3D& from, const Vec3D& to, const Vec3D& axis);
+  static bool calcLine(const Vec3D& axis1, const Vec3D& axis2, const Vec3D& nfrom, const Vec3D& nto, Vec3D& r1, Vec3D& r2);
+  static QList<Vec3D> calcPossibleIntermediatePositions(const Vec3D& u1, const Vec3D& u2);
+  static double calcRotationAngle(const Vec3D& from, const Vec3D& to, const Vec3D& axis);
   Ui::Reorient *ui;
 
   Vec3D fromIndex;
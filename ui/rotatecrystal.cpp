@@ -26,7 +26,7 @@
 #include "core/crystal.h"
 #include "ui/clip.h"
 #include "tools/indexparser.h"
-#include "tools/tools.h"
+#include "tools/guitools.h"
 
 RotateCrystal::RotateCrystal(QWidget* _parent) :
     QWidget(_parent),
@@ -29,8 +29,10 @@
 #include <ctime>
 
 
-#include "../tools/mat3d.h"
-#include "../tools/vec3d.h"
+#include <QRandomGenerator>
+
+#include "tools/mat3D.h"
+#include "tools/vec3D.h"
 class ClipUnitTestTest : public QObject
 {
     Q_OBJECT
@@ -97,7 +99,7 @@ void ClipUnitTestTest::testMatrixSVDRandomCombine() {
       for (int j=0; j<3; j++) {
         M1(i,j) = 2.0*(1.0*QRandomGenerator::global()->generate()/RAND_MAX-0.5);
       }
-    }`
+    }
 
     Mat3D M2(M1);
     Mat3D Q1;
@@ -176,6 +178,9 @@ void ClipUnitTestTest::benchmarkMatrixSVD() {
 
 
 }
+
+// Convergence study of svd() against fastsvd(), runs instead of the tests
+#ifdef CLIP_SVD_STUDY
 #include <Windows.h>
 #include <Winbase.h>
 
@@ -240,7 +245,8 @@ int main () {
   OutputDebugStringA(qPrintable(s));
 }
 
-
-//QTEST_APPLESS_MAIN(ClipUnitTestTest);
+#else
+QTEST_APPLESS_MAIN(ClipUnitTestTest)
+#endif
 
 #include "tst_clipunittesttest.moc"
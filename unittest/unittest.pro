@@ -16,7 +16,8 @@ TEMPLATE = app
 
 
 SOURCES += tst_clipunittesttest.cpp \
-           ../tools/mat3d.cpp
+           ../tools/mat3D.cpp \
+           ../tools/vec3D.cpp
 
 QMAKE_CXXFLAGS += -I.. -I../..
 QMAKE_CXXFLAGS += -std=gnu++0x